@@ -6,6 +6,8 @@ python3 tools/font2raw.py res/font_default.png 8 8 a obj/assets/font_default.bin
 wf-bin2s -a 1 --address-space __wf_rom --section ".farrodata.a.font_default" obj/assets/ obj/assets/font_default.bin
 echo "[ Generating strings ]"
 python3 tools/gen_strings.py lang obj/assets/lang.c obj/assets/lang.h
+echo "[ Generating title database ]"
+python3 tools/gen_titledb.py obj/assets/titledb_data.c obj/assets/titledb_data.h res/titledb/*.dat
 echo "[ Generating binary blobs ]"
 echo "- wsmonitor"
 wf-zx0-salvador thirdparty/wsmonitor.bin obj/assets/wsmonitor.zx0
@@ -15,5 +17,5 @@ cd thirdparty/athenaos
 rm -r dist || true
 make CONFIG=config/config.flashmasta.mk bios
 cd ../..
-wf-zx0-salvador thirdparty/athenaos/dist/AthenaBIOS-*-flashmasta.raw obj/assets/athenabios.zx0
-wf-bin2s -a 1 --address-space __wf_rom --section ".farrodata.a.athenabios" --hide-size-in-header obj/assets/ obj/assets/athenabios.zx0
+python3 tools/zx0pack.py --independent thirdparty/athenaos/dist/AthenaBIOS-*-flashmasta.raw obj/assets/athenabios.cfz
+wf-bin2s -a 1 --address-space __wf_rom --section ".farrodata.a.athenabios" --hide-size-in-header obj/assets/ obj/assets/athenabios.cfz
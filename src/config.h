@@ -30,4 +30,9 @@
 #define SRAM_SLOTS 15
 #endif
 
+// Must be a power of two.
+#define SERIAL_RXBUF_SIZE 512
+// Must be a power of two, up to 256.
+#define SERIAL_TXBUF_SIZE 256
+
 // #define USE_LOW_BATTERY_WARNING
@@ -0,0 +1,312 @@
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ws.h>
+#include "config.h"
+#include "deploy.h"
+#include "driver.h"
+#include "lang.h"
+#include "progress.h"
+#include "serial.h"
+#include "settings.h"
+#include "titledb.h"
+#include "ui.h"
+#include "util.h"
+#include "xmodem.h"
+
+#ifdef USE_SLOT_SYSTEM
+
+// Protocol (all values little-endian):
+// host:   "CFDD", u32 image size (a multiple of 64 KB)
+// device: "CFDS", u16 sector count, u32 CRC32 per sector, CRC16 of the
+//         previous two fields (big-endian, as in XMODEM)
+// host:   YMODEM batch of the changed sectors; each file is named after
+//         the sector's index within the image and holds its data
+// Like received ROMs, the image ends at the last bank of the (sub)slot,
+// so the first sector is only 64 KB long for an odd number of banks.
+//
+// Resuming an interrupted transfer (tools/cf_send.py):
+// host:   "CFRQ"
+// device: "CFRO", u32 offset to resume from, CRC16 of the offset
+// host:   YMODEM file with the full size in its header, but only the data
+//         from the offset on
+
+#define DEPLOY_TIMEOUT 75
+#define DEPLOY_MAX_SECTORS 64
+
+static const char __far deploy_request_magic[] = "CFDD";
+static const char __far deploy_reply_magic[] = "CFDS";
+static const char __far deploy_resume_request_magic[] = "CFRQ";
+static const char __far deploy_resume_reply_magic[] = "CFRO";
+
+uint16_t deploy_slot_capacity_banks(uint8_t entry_id) {
+    uint8_t bank_last = 0xFF - (entry_id & 0xF0);
+    uint8_t slot_type = settings_local.slot_type[entry_id & 0x0F];
+
+    // (sub)slots are aligned to their size
+    uint16_t capacity_banks = bank_last - 0x7F;
+    if (slot_type == SLOT_TYPE_8M_2M   && capacity_banks > 64) capacity_banks = 64;
+    if (slot_type == SLOT_TYPE_8M_512K && capacity_banks > 16) capacity_banks = 16;
+    return capacity_banks;
+}
+
+bool deploy_write_chunk(const uint8_t *data, uint8_t slot, uint32_t pos, uint16_t len) {
+    // one call per bank; every call switches the cartridge slot twice
+    uint16_t bank = pos >> 16;
+    uint16_t offset = pos;
+    uint16_t len_first = len;
+    if (offset != 0 && ((uint16_t) (0 - offset)) < len) {
+        len_first = 0 - offset;
+    }
+    if (!driver_write_slot_verify(data, slot, bank, offset, len_first)) {
+        return false;
+    }
+    return len_first == len || driver_write_slot_verify(data + len_first, slot, bank + 1, 0, len - len_first);
+}
+
+static bool deploy_wait_magic(const char __far *magic) {
+    uint8_t matched = 0;
+    while (matched < 4) {
+        if (xmodem_poll_exit()) return false;
+        int16_t r = serial_getc_buffered_nonblock();
+        if (r < 0) {
+            cpu_halt();
+        } else if (r == magic[matched]) {
+            matched++;
+        } else {
+            matched = (r == magic[0]) ? 1 : 0;
+        }
+    }
+    return true;
+}
+
+static void deploy_putc(uint16_t *crc, uint8_t value) {
+    ws_serial_putc(value);
+    *crc = crc16_xmodem_update(*crc, value);
+}
+
+static void deploy_put_magic(const char __far *magic) {
+    for (uint8_t i = 0; i < 4; i++) {
+        ws_serial_putc(magic[i]);
+    }
+}
+
+static void deploy_put_crc(uint16_t crc) {
+    ws_serial_putc(crc >> 8);
+    ws_serial_putc(crc);
+}
+
+static bool deploy_wait_request(uint32_t *size) {
+    if (!deploy_wait_magic(deploy_request_magic)) return false;
+
+    *size = 0;
+    for (uint8_t i = 0; i < 32; i += 8) {
+        int16_t r = serial_getc_buffered_timeout(DEPLOY_TIMEOUT);
+        if (r < 0) return false;
+        *size |= ((uint32_t) r) << i;
+    }
+    return true;
+}
+
+bool deploy_send_resume_offset(uint32_t offset) {
+    uint16_t crc = 0;
+
+    if (!deploy_wait_magic(deploy_resume_request_magic)) return false;
+    deploy_put_magic(deploy_resume_reply_magic);
+    for (uint8_t i = 0; i < 32; i += 8) {
+        deploy_putc(&crc, offset >> i);
+    }
+    deploy_put_crc(crc);
+    return true;
+}
+
+typedef struct {
+    uint32_t *crcs;
+    uint8_t sectors;
+    uint8_t slot;
+    uint16_t bank;
+} deploy_crc_job_t;
+
+static bool deploy_crc_sectors_run(const uint32_t *table, void *userdata) {
+    deploy_crc_job_t *job = (deploy_crc_job_t*) userdata;
+    uint16_t bank = job->bank;
+
+    driver_unlock();
+    for (uint8_t i = 0; i < job->sectors; i++) {
+        // the slot stays pinned for a whole sector; a partial first sector
+        // only has its upper bank
+        uint16_t count = (bank & 1) ? 1 : 2;
+        job->crcs[i] = CRC32_INIT;
+        driver_crc32_sectors(job->crcs + i, job->slot, bank, table, count);
+        job->crcs[i] = ~job->crcs[i];
+        bank += count;
+        progress_add(((uint32_t) count) << 16);
+    }
+    driver_lock();
+    return true;
+}
+
+static void deploy_crc_sectors(uint32_t *crcs, uint8_t sectors, uint8_t slot, uint16_t bank) {
+    deploy_crc_job_t job = {
+        .crcs = crcs,
+        .sectors = sectors,
+        .slot = slot,
+        .bank = bank
+    };
+    crc32_with_table(deploy_crc_sectors_run, &job);
+}
+
+static void deploy_send_crcs(const uint32_t *crcs, uint8_t sectors) {
+    uint16_t crc = 0;
+
+    deploy_put_magic(deploy_reply_magic);
+    deploy_putc(&crc, sectors);
+    deploy_putc(&crc, 0);
+    const uint8_t *data = (const uint8_t*) crcs;
+    for (uint16_t i = 0; i < sectors * 4; i++) {
+        deploy_putc(&crc, data[i]);
+    }
+    deploy_put_crc(crc);
+}
+
+static uint8_t deploy_parse_index(const char *s) {
+    uint16_t v = 0;
+    if (*s == 0) return 0xFF;
+    while (*s != 0) {
+        if (*s < '0' || *s > '9' || v >= 0x100) return 0xFF;
+        v = (v * 10) + (*(s++) - '0');
+    }
+    return v > 0xFF ? 0xFF : v;
+}
+
+// Receives the file in xmodem_file into one sector, starting at pos.
+static uint16_t deploy_recv_sector(uint8_t *buffer, uint8_t slot, uint32_t pos) {
+    uint32_t size = xmodem_file.size;
+    uint32_t received = 0;
+
+    driver_erase_bank(0, slot, (pos >> 16) & 0xFFFE);
+    while (true) {
+        uint16_t len = XMODEM_BLOCK_SIZE_1K;
+        uint8_t result = xmodem_recv_block(buffer, &len);
+        if (result == XMODEM_COMPLETE) {
+            return received == size ? 0 : LK_UI_XMODEM_ERROR;
+        } else if (result == XMODEM_ERROR) {
+            return LK_UI_XMODEM_ERROR;
+        } else if (result != XMODEM_OK) {
+            return LK_UI_XMODEM_CANCEL;
+        }
+
+        // drop the sender's padding
+        if (len > size - received) len = size - received;
+        if (len > 0 && !deploy_write_chunk(buffer, slot, pos + received, len)) {
+            xmodem_recv_cancel();
+            return LK_UI_ROM_RECEIVE_VERIFY_FAILED;
+        }
+        received += len;
+        progress_add(len);
+    }
+}
+
+bool deploy_ui_delta(uint8_t entry_id) {
+    uint8_t buffer[XMODEM_BLOCK_SIZE_1K];
+    uint32_t crcs[DEPLOY_MAX_SECTORS];
+    uint8_t slot = entry_id & 0x0F;
+    uint8_t bank_last = 0xFF - (entry_id & 0xF0);
+    uint16_t lk_result = LK_UI_XMODEM_CANCEL;
+    uint32_t size;
+
+    if (slot == driver_get_launch_slot())
+        return false;
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_RECEIVE]);
+    ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
+    ui_puts_centered(false, 5, 0, lang_keys[LK_UI_DEPLOY_WAITING]);
+
+    xmodem_open_default();
+    if (!deploy_wait_request(&size)) {
+        goto deploy_end;
+    }
+    if (size == 0 || (size & 0xFFFF) != 0 || size > (((uint32_t) deploy_slot_capacity_banks(entry_id)) << 16)) {
+        ui_tool_xmodem_ui_message(LK_UI_XMODEM_INVALID_FILE);
+        goto deploy_end;
+    }
+
+    uint32_t pos_first = (((uint32_t) bank_last + 1) << 16) - size;
+    uint16_t bank_first = pos_first >> 16;
+    uint8_t sector_first = bank_first >> 1;
+    uint8_t sectors = (bank_last >> 1) + 1 - sector_first;
+
+    ui_tool_xmodem_ui_message(LK_UI_DEPLOY_CHECKING);
+    progress_start(14, size);
+    deploy_crc_sectors(crcs, sectors, slot, bank_first);
+    progress_finish();
+    deploy_send_crcs(crcs, sectors);
+
+    titledb_invalidate_bank(slot, bank_first);
+
+    // the serial interrupt keeps filling the RX buffer with the next block
+    // while the previous one is being written
+    ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
+    progress_start(14, size);
+    driver_irq_passthrough = HWINT_SERIAL_RX;
+    driver_unlock();
+    uint8_t result = xmodem_recv_start();
+    if (result == XMODEM_OK) result = xmodem_recv_header();
+    lk_result = 0;
+    while (result == XMODEM_OK) {
+        uint8_t sector = deploy_parse_index(xmodem_file.name);
+        if (sector >= sectors) {
+            xmodem_recv_cancel();
+            lk_result = LK_UI_XMODEM_INVALID_FILE;
+            break;
+        }
+        uint32_t pos = ((uint32_t) (sector_first + sector)) * DEPLOY_SECTOR_SIZE;
+        if (pos < pos_first) pos = pos_first;
+        if (xmodem_file.size != ((uint32_t) (sector_first + sector + 1)) * DEPLOY_SECTOR_SIZE - pos) {
+            xmodem_recv_cancel();
+            lk_result = LK_UI_XMODEM_INVALID_FILE;
+            break;
+        }
+        lk_result = deploy_recv_sector(buffer, slot, pos);
+        if (lk_result != 0) break;
+        result = xmodem_recv_next_file();
+    }
+    if (lk_result == 0) {
+        lk_result = result == XMODEM_COMPLETE ? LK_UI_XMODEM_COMPLETE
+            : (result == XMODEM_ERROR ? LK_UI_XMODEM_ERROR : LK_UI_XMODEM_CANCEL);
+    }
+    driver_lock();
+    driver_irq_passthrough = 0;
+    progress_finish();
+
+    if (lk_result == LK_UI_XMODEM_COMPLETE) {
+        xmodem_close();
+        return true;
+    }
+    ui_tool_xmodem_ui_message(lk_result);
+
+deploy_end:
+    xmodem_close();
+    while (!xmodem_poll_exit()) cpu_halt();
+    return false;
+}
+
+#endif
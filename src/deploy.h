@@ -0,0 +1,34 @@
+#pragma once
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEPLOY_SECTOR_SIZE 0x20000
+
+// Size of a ROM (sub)slot, in 64 KB banks.
+uint16_t deploy_slot_capacity_banks(uint8_t entry_id);
+// Writes a chunk of a ROM image at pos (bank << 16 | offset), checking it
+// with driver_write_slot_verify(). The driver must be unlocked.
+bool deploy_write_chunk(const uint8_t *data, uint8_t slot, uint32_t pos, uint16_t len);
+// Waits for a host tool to ask where to resume a transfer, and answers
+// with offset. Returns false if cancelled.
+bool deploy_send_resume_offset(uint32_t offset);
+// Re-flashes only the 128 KB sectors of a ROM image which differ from the
+// host's copy, as sent by tools/delta_deploy.py.
+bool deploy_ui_delta(uint8_t entry_id);
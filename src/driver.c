@@ -65,6 +65,28 @@ void launch_slot(uint16_t slot, uint16_t bank) {
     driver_launch_slot(0, slot, bank);
 }
 
+void driver_stats_reset(void) {
+    memset(&driver_stats, 0, sizeof(driver_stats));
+}
+
+bool driver_erase_bank(uint16_t unused, uint16_t slot, uint16_t bank) __far {
+    bool result = driver_erase_sector(unused, slot, bank);
+    if (!(bank & 1) && slot == driver_get_launch_slot() && bank >= ERASE_COUNT_BANK_FIRST
+        && bank < ERASE_COUNT_BANK_FIRST + ERASE_COUNT_SECTORS * 2) {
+        uint8_t i = (bank - ERASE_COUNT_BANK_FIRST) >> 1;
+        if (settings_local.erase_counts[i] < 0xFFFF) settings_local.erase_counts[i]++;
+        // the counts are saved along with other settings changes; only
+        // force a save of their own every 16 erases of a sector
+        if ((settings_local.erase_counts[i] & 0x0F) == 0) settings_mark_changed();
+    }
+    return result;
+}
+
+bool driver_sector_erased(const uint32_t *table, uint16_t slot, uint16_t bank) {
+    uint32_t crc = CRC32_INIT;
+    return driver_crc32_sectors(&crc, slot, bank, table, 2) && (~crc) == CRC32_ERASED_SECTOR;
+}
+
 extern void launch_ram_asm(const void __far *ptr);
 
 void launch_ram(const void __far *ptr) {
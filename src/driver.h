@@ -27,14 +27,53 @@
 #include <stdint.h>
 #include <wonderful.h>
 
+// Hardware interrupts (HWINT_*) left enabled during driver calls, while
+// the cartridge ROM is switched away; their handlers must be in RAM.
+extern uint8_t driver_irq_passthrough;
+
+// Counters of what the driver has done since the last driver_stats_reset(),
+// kept in IRAM. The offsets are also used by fm_driver_io*.s.
+typedef struct {
+    uint16_t slot_switches; // 0
+    uint16_t avr_wakes; // 2
+    uint16_t avr_sleeps; // 4
+    uint16_t buffered_writes; // 6
+    uint16_t byte_writes; // 8, writes done with per-byte programs
+    uint16_t erases; // 10
+    uint32_t bytes_read; // 12, including CRC32 calculations
+    uint32_t bytes_programmed; // 16
+    uint32_t busy_polls; // 20, iterations of the program/erase status loops
+} driver_stats_t;
+
+extern driver_stats_t driver_stats;
+void driver_stats_reset(void);
+
 void driver_init(void);
 void driver_lock(void);
 void driver_unlock(void);
 bool driver_read_slot(void *ptr, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) __far;
+// table: 256-entry CRC32 table, see crc32_with_table(); len = 0 -> 64 KB
+bool driver_crc32_slot(uint32_t *crc, uint16_t slot, uint16_t bank, const uint32_t *table, uint16_t len) __far;
+// count whole banks from bank on, pinning the slot; crcs holds one CRC per
+// 128 KB sector, with both of its banks updating the same entry
+bool driver_crc32_sectors(uint32_t *crcs, uint16_t slot, uint16_t bank, const uint32_t *table, uint16_t count) __far;
 bool driver_write_slot(const void *data, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) __far;
+// compares the written bytes with data before switching back to the
+// launch slot; returns false if they differ
+bool driver_write_slot_verify(const void *data, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) __far;
+// erases the 128 KB sector starting at an even bank; odd banks are ignored
+// erases of the launcher slot's save and settings sectors are counted in
+// settings_local.erase_counts, which are saved at least every 16 erases
 bool driver_erase_bank(uint16_t unused, uint16_t slot, uint16_t bank) __far;
+bool driver_erase_sector(uint16_t unused, uint16_t slot, uint16_t bank) __far; // not counted
+// whether the 128 KB sector starting at an even bank is erased, going by
+// its CRC32; table as for driver_crc32_slot()
+bool driver_sector_erased(const uint32_t *table, uint16_t slot, uint16_t bank);
 void driver_launch_slot(uint16_t unused, uint16_t slot, uint16_t bank) __far; // unlock first, lock in function 
 uint8_t driver_get_launch_slot(void);
+#ifdef TARGET_flash_masta
+bool driver_fm_is_rev5(void);
+#endif
 
 void launch_slot(uint16_t slot, uint16_t bank); // unlocks automatically
 void launch_ram(const void __far* ptr);
@@ -24,6 +24,7 @@
 #define ERROR_CODE_UNLOCK_OVERFLOW 0x0003
 #define ERROR_CODE_LOCK_UNDERFLOW 0x0004
 #define ERROR_CODE_SRAM_ODD_SIZE_UNHANDLED 0x0005
+#define ERROR_CODE_SRAM_VERIFY_FAILED 0x0006
 
 #define ERROR_CODE_WW_UNPACK_FAILED 0x0101
 #define ERROR_CODE_WW_FLASH_FAILED 0x0102
@@ -25,6 +25,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <wonderful.h>
+#include <ws.h>
 #include "../driver.h"
 
 extern uint8_t fm_initial_slot;
@@ -33,3 +34,9 @@ uint8_t driver_get_launch_slot(void) {
     // return (_CS < 0x2000) ? 0xFF : fm_initial_slot;
     return 0; // TODO
 }
+
+// Revision 5 boards have a read/write register at port 0xCE.
+bool driver_fm_is_rev5(void) {
+    outportb(0xCE, 0xAA);
+    return inportb(0xCE) == 0xAA;
+}
@@ -34,6 +34,11 @@
 	.global fm_initial_slot
 	.global _fm_unlock_refcount
 	.global error_critical
+	.global driver_stats
+
+// driver_stats_t offsets, see driver.h
+	.set DRIVER_STATS_AVR_WAKES, 2
+	.set DRIVER_STATS_AVR_SLEEPS, 4
 
 _rtc_wait_ready:
 	push ax
@@ -73,6 +78,7 @@ _dc_loop2:
 	ret
 
 _avr_sleep:
+	ss inc word ptr [driver_stats + DRIVER_STATS_AVR_SLEEPS]
 	push ax
 	mov al, 0x08
 	out IO_CART_GPO_DATA, al
@@ -83,6 +89,7 @@ _avr_sleep:
 	ret
 
 _avr_wake:
+	ss inc word ptr [driver_stats + DRIVER_STATS_AVR_WAKES]
 	push ax
 	mov al, 0x08
 	out IO_CART_GPO_DATA, al
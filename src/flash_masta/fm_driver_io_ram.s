@@ -29,11 +29,25 @@
 	.code16
 	.intel_syntax noprefix
 	.global driver_read_slot
+	.global driver_crc32_slot
+	.global driver_crc32_sectors
 	.global driver_write_slot
-	.global driver_erase_bank
+	.global driver_write_slot_verify
+	.global driver_erase_sector
 	.global driver_launch_slot
 	.global fm_initial_slot
+	.global driver_irq_passthrough
 	.global _fm_unlock_refcount
+	.global driver_stats
+
+// driver_stats_t offsets, see driver.h
+	.set DRIVER_STATS_SLOT_SWITCHES, 0
+	.set DRIVER_STATS_BUFFERED_WRITES, 6
+	.set DRIVER_STATS_BYTE_WRITES, 8
+	.set DRIVER_STATS_ERASES, 10
+	.set DRIVER_STATS_BYTES_READ, 12
+	.set DRIVER_STATS_BYTES_PROGRAMMED, 16
+	.set DRIVER_STATS_BUSY_POLLS, 20
 
 	.section .text
 	.align 2
@@ -176,6 +190,7 @@ _driver_switch_slot1:
 	cmp al, dl
 	je _driver_switch_slot_equal
 	ss mov [_driver_current_slot], dl
+	ss inc word ptr [driver_stats + DRIVER_STATS_SLOT_SWITCHES]
 
 	// Use RTC protocol to change the current bank.
 	mov al, 0xA0
@@ -218,6 +233,7 @@ _driver_switch_slot_bank1:
 	ss mov [_driver_bank_temp], al
 	mov al, cl
 	out IO_BANK_ROM1, al
+	call _driver_irq_passthrough_begin
 	jmp _driver_switch_slot1
 
 // clobbers AX, DL
@@ -227,7 +243,23 @@ _driver_unswitch_slot_bank1:
 _driver_unswitch_slot:
 	ss mov dl, [fm_initial_slot]
 	call _driver_switch_slot
+	cli
+	ss mov al, [_driver_hwint_temp]
+	out IO_HWINT_ENABLE, al
+	sti
+	ret
+
+// masks all interrupts but the ones in driver_irq_passthrough, which
+// stay enabled while the cartridge is switched away
+// clobbers AL
+_driver_irq_passthrough_begin:
+	in al, IO_HWINT_ENABLE
+	ss mov [_driver_hwint_temp], al
+	ss and al, [driver_irq_passthrough]
+	out IO_HWINT_ENABLE, al
+	jz 1f
 	sti
+1:
 	ret
 
 // preserves AX
@@ -240,6 +272,7 @@ _driver_switch_slot_sram:
 	out IO_CART_FLASH, al
 	mov al, cl
 	out IO_BANK_RAM, al
+	call _driver_irq_passthrough_begin
 	jmp _driver_switch_slot1
 
 // clobbers AX, DL
@@ -280,6 +313,8 @@ driver_read_slot:
 	mov si, [bp + 14]
 _drs_part2:
 	mov	cx, [bp + 16]
+	ss add word ptr [driver_stats + DRIVER_STATS_BYTES_READ], cx
+	ss adc word ptr [driver_stats + DRIVER_STATS_BYTES_READ + 2], 0
 	shr	cx, 1
 	cld
 	rep	movsw
@@ -299,8 +334,153 @@ _drs_part2:
 	call driver_slot_finish_error_check
 	retf 0x4
 
+	.align 2
+// updates the CRC32 at [AX] with LEN bytes of the slot's bank,
+// using the 256-entry (1 KB) table passed in place of an offset
+driver_crc32_slot:
+	push	si
+	push	di
+	push	ds
+	push	es
+	push	bp
+	mov	bp, sp
+	push	ax
+
+	call _driver_switch_slot_bank1
+
+	mov bx, ax
+	mov ax, [bx]
+	mov dx, [bx + 2]
+	mov di, [bp + 14]
+	mov	cx, [bp + 16]
+	ss add word ptr [driver_stats + DRIVER_STATS_BYTES_READ], cx
+	ss adc word ptr [driver_stats + DRIVER_STATS_BYTES_READ + 2], 0
+	cmp cx, 1 // len = 0 -> 64 KB
+	ss adc word ptr [driver_stats + DRIVER_STATS_BYTES_READ + 2], 0
+
+	mov bx, 0x3000
+	mov	ds, bx
+	xor si, si
+
+	.balign 2, 0x90
+1:
+	xor al, byte ptr [si]
+	inc si
+	mov bl, al
+	mov bh, 0
+	shl bx, 2
+	mov al, ah
+	mov ah, dl
+	mov dl, dh
+	mov dh, 0
+	ss xor ax, word ptr [bx + di]
+	ss xor dx, word ptr [bx + di + 2]
+	dec cx
+	jnz 1b
+
+	pop bx
+	ss mov [bx], ax
+	ss mov [bx + 2], dx
+
+	pop	bp
+	pop	es
+	pop	ds
+
+	call _driver_unswitch_slot_bank1
+
+	pop	di
+	pop	si
+
+	call driver_slot_finish_error_check
+	mov al, 1
+	retf 0x4
+
+	.align 2
+// like driver_crc32_slot, but for COUNT whole banks starting at CX, without
+// switching slots in between; both banks of a 128 KB flash sector update
+// the same CRC, so [AX] holds one CRC per sector
+driver_crc32_sectors:
+	push	si
+	push	di
+	push	ds
+	push	es
+	push	bp
+	mov	bp, sp
+	push	ax // [bp - 2]: current CRC
+	push	cx // [bp - 4]: current bank
+
+	call _driver_switch_slot_bank1
+
+	mov di, [bp + 14]
+	mov bx, 0x3000
+	mov	ds, bx
+
+dcs_bank:
+	ss inc word ptr [driver_stats + DRIVER_STATS_BYTES_READ + 2] // 64 KB
+	mov bx, [bp - 2]
+	ss mov ax, [bx]
+	ss mov dx, [bx + 2]
+	xor si, si
+	xor cx, cx // 64 KB
+
+	.balign 2, 0x90
+1:
+	xor al, byte ptr [si]
+	inc si
+	mov bl, al
+	mov bh, 0
+	shl bx, 2
+	mov al, ah
+	mov ah, dl
+	mov dl, dh
+	mov dh, 0
+	ss xor ax, word ptr [bx + di]
+	ss xor dx, word ptr [bx + di + 2]
+	dec cx
+	jnz 1b
+
+	mov bx, [bp - 2]
+	ss mov [bx], ax
+	ss mov [bx + 2], dx
+
+	// next bank; after an odd bank, also the next sector
+	mov ax, [bp - 4]
+	test al, 1
+	jz 2f
+	add word ptr [bp - 2], 4
+2:
+	inc ax
+	mov [bp - 4], ax
+	out IO_BANK_ROM1, al
+	dec word ptr [bp + 16]
+	jnz dcs_bank
+
+	add sp, 4
+	pop	bp
+	pop	es
+	pop	ds
+
+	call _driver_unswitch_slot_bank1
+
+	pop	di
+	pop	si
+
+	call driver_slot_finish_error_check
+	mov al, 1
+	retf 0x4
+
+	.align 2
+// like driver_write_slot, but compares the flash contents with the data
+// right after programming, while the slot is still mapped in; returns
+// false on a mismatch
+driver_write_slot_verify:
+	ss mov byte ptr [_driver_write_verify], 1
+	jmp _dws_start
+
 	.align 2
 driver_write_slot:
+	ss mov byte ptr [_driver_write_verify], 0
+_dws_start:
 	push	si
 	push	di
 	push	ds
@@ -313,6 +493,8 @@ driver_write_slot:
 
 	mov di, [bp + 14]
 	mov	cx, [bp + 16]
+	ss add word ptr [driver_stats + DRIVER_STATS_BYTES_PROGRAMMED], cx
+	ss adc word ptr [driver_stats + DRIVER_STATS_BYTES_PROGRAMMED + 2], 0
 
 	xor bx, bx
 	mov ds, bx
@@ -346,6 +528,7 @@ driver_write_slot:
 	jnz _dws_write_slow
 
 _dws_write_fast:
+	ss inc word ptr [driver_stats + DRIVER_STATS_BUFFERED_WRITES]
 	xor bx, bx // clear BX (block address)
 	dec cx
 
@@ -370,13 +553,15 @@ _dws_write_fast:
 	jmp dws_driver_flash_busyloop_until_done
 
 _dws_write_slow:
+	ss inc word ptr [driver_stats + DRIVER_STATS_BYTE_WRITES]
 	.balign 2, 0x90
 1:
 	mov byte ptr es:[bx], 0xA0
 	movsb
 dws_driver_flash_busyloop_until_done:
-	nop
-	nop
+	// counting the poll also spaces out the reads, as two NOPs did
+	ss add word ptr [driver_stats + DRIVER_STATS_BUSY_POLLS], 1
+	ss adc word ptr [driver_stats + DRIVER_STATS_BUSY_POLLS + 2], 0
 	mov al, byte ptr es:[di]
 	nop
 	nop
@@ -392,6 +577,18 @@ dws_driver_flash_done:
 	// reset
 	call _driver_reset_flash
 
+	// verify: ds:si - len = data, es:di = flash
+	mov bl, 1
+	ss cmp byte ptr [_driver_write_verify], 0
+	je 1f
+	mov cx, [bp + 16]
+	mov di, [bp + 14]
+	sub si, cx
+	repe cmpsb
+	je 1f
+	mov bl, 0
+1:
+
 	pop	bp
 	pop	es
 	pop	ds
@@ -402,17 +599,18 @@ dws_driver_flash_done:
 	pop	si
 
 	call driver_slot_finish_error_check
-	mov al, 1
+	mov al, bl
 	retf 0x4
 
 	.align 2
-driver_erase_bank:
+driver_erase_sector:
 	test cl, 1
-	jnz driver_erase_bank_finish
+	jnz driver_erase_sector_finish
 
 	push ds
 	push si
 
+	ss inc word ptr [driver_stats + DRIVER_STATS_ERASES]
 	call _driver_switch_slot_sram
 
 	// execute erase command
@@ -431,9 +629,9 @@ driver_erase_bank:
 
 	.balign 2, 0x90
 deb_driver_flash_busyloop_until_done:
-	nop
-	nop
-	nop
+	// counting the poll also spaces out the reads, as three NOPs did
+	ss add word ptr [driver_stats + DRIVER_STATS_BUSY_POLLS], 1
+	ss adc word ptr [driver_stats + DRIVER_STATS_BUSY_POLLS + 2], 0
 	mov al, byte ptr [bx]
 	nop
 	nop
@@ -449,7 +647,7 @@ deb_driver_flash_busyloop_until_done:
 	pop ds
 
 	call driver_slot_finish_error_check
-driver_erase_bank_finish:
+driver_erase_sector_finish:
 	mov al, 1
 	retf
 
@@ -534,10 +732,19 @@ _end:
 	jmp 1b
 
 	.section .bss
+	.align 2
+driver_stats:
+	.fill 24, 1, 0
 _driver_bank_temp:
 	.byte 0
+_driver_hwint_temp:
+	.byte 0
+driver_irq_passthrough:
+	.byte 0
 _driver_current_slot:
 	.byte 0
+_driver_write_verify:
+	.byte 0
 _fm_unlock_refcount:
 	.byte 0
 fm_initial_slot:
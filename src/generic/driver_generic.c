@@ -26,6 +26,8 @@
 #include "../driver.h"
 
 uint8_t fm_initial_slot; // TODO: remove
+uint8_t driver_irq_passthrough;
+driver_stats_t driver_stats;
 
 void driver_init(void) {
     
@@ -47,11 +49,23 @@ bool driver_read_slot(void *ptr, uint16_t slot, uint16_t bank, uint16_t offset,
     return false;
 }
 
+bool driver_crc32_slot(uint32_t *crc, uint16_t slot, uint16_t bank, const uint32_t *table, uint16_t len) __far {
+    return false;
+}
+
+bool driver_crc32_sectors(uint32_t *crcs, uint16_t slot, uint16_t bank, const uint32_t *table, uint16_t count) __far {
+    return false;
+}
+
 bool driver_write_slot(const void *data, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) __far {
     return false;
 }
 
-bool driver_erase_bank(uint16_t unused, uint16_t slot, uint16_t bank) __far {
+bool driver_write_slot_verify(const void *data, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) __far {
+    return false;
+}
+
+bool driver_erase_sector(uint16_t unused, uint16_t slot, uint16_t bank) __far {
     return false;
 }
 
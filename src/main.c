@@ -20,6 +20,7 @@
 #include <ws.h>
 #include "driver.h"
 #include "input.h"
+#include "progress.h"
 #include "settings.h"
 #include "sram.h"
 #include "ui.h"
@@ -47,6 +48,7 @@ __attribute__((interrupt))
 void __far vblank_int_handler(void) {
 	vbl_ticks++;
 	vblank_input_update();
+	progress_vblank();
 	ws_hwint_ack(HWINT_VBLANK);
 }
 
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ws.h>
+#include "lang.h"
+#include "progress.h"
+#include "ui.h"
+
+// ~0.5 seconds
+#define PROGRESS_RATE_INTERVAL 38
+
+volatile uint32_t progress_done;
+static uint32_t progress_total;
+static uint32_t progress_ticks;
+static uint8_t progress_shift;
+static uint8_t progress_rate_ticks;
+static volatile bool progress_active;
+static ui_pbar_state_t progress_pbar;
+
+void progress_start(uint8_t y, uint32_t total) {
+    cpu_irq_disable();
+    progress_done = 0;
+    progress_total = total;
+    progress_ticks = 0;
+    progress_rate_ticks = 0;
+
+    // scale the bar so that ui_pbar_draw works on 16-bit values
+    progress_shift = 0;
+    while ((total >> progress_shift) > 0xFFFF) progress_shift++;
+    progress_pbar.x = 0;
+    progress_pbar.y = y;
+    progress_pbar.width = 27;
+    progress_pbar.step_max = total >> progress_shift;
+    if (progress_pbar.step_max == 0) progress_pbar.step_max = 1;
+    ui_pbar_init(&progress_pbar);
+
+    progress_active = true;
+    cpu_irq_enable();
+}
+
+void progress_finish(void) {
+    progress_active = false;
+    if (progress_pbar.y != PROGRESS_NO_BAR) {
+        progress_pbar.step = progress_pbar.step_max;
+        ui_pbar_draw(&progress_pbar);
+    }
+    ui_clear_work_indicator();
+}
+
+// The VBlank handler may interrupt a main loop in the middle of vsnprintf(),
+// so numbers are formatted by hand here.
+static char *progress_format_u16(char *buf, uint16_t value, uint8_t min_digits) {
+    char tmp[5];
+    uint8_t len = 0;
+    do {
+        tmp[len++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0 || len < min_digits);
+    while (len > 0) {
+        *(buf++) = tmp[--len];
+    }
+    return buf;
+}
+
+static char *progress_format_str(char *buf, const char __far* str) {
+    while (*str) {
+        *(buf++) = *(str++);
+    }
+    return buf;
+}
+
+static void progress_draw_rate(uint32_t done) {
+    char buf[29];
+    char *ptr = buf;
+
+    // bytes per second; VBlank runs at ~75.47 Hz
+    uint32_t bps = (done * 151) / (progress_ticks * 2);
+    uint16_t rate = bps / 102; // in 0.1 KB/s units
+    ptr = progress_format_u16(ptr, rate / 10, 1);
+    *(ptr++) = '.';
+    ptr = progress_format_u16(ptr, rate % 10, 1);
+    ptr = progress_format_str(ptr, lang_keys[LK_UI_PROGRESS_KBPS]);
+
+    if (bps > 0 && done < progress_total) {
+        uint32_t eta = (progress_total - done) / bps;
+        if (eta > 5999) eta = 5999;
+        ptr = progress_format_str(ptr, lang_keys[LK_UI_PROGRESS_ETA]);
+        ptr = progress_format_u16(ptr, eta / 60, 1);
+        *(ptr++) = ':';
+        ptr = progress_format_u16(ptr, eta % 60, 2);
+    }
+    *ptr = 0;
+
+    ui_fill_line(progress_pbar.y + 1, 0);
+    ui_puts(false, (27 - (ptr - buf)) >> 1, progress_pbar.y + 1, 0, buf);
+}
+
+void progress_vblank(void) {
+    if (!progress_active) return;
+
+    // progress_done may be torn mid-update; as the upper word is always
+    // updated last, this only ever yields a value lower than the real one
+    uint32_t done = progress_done;
+    progress_ticks++;
+
+    ui_step_work_indicator();
+    if (progress_pbar.y == PROGRESS_NO_BAR) return;
+
+    if (done > progress_total) done = progress_total;
+    progress_pbar.step = done >> progress_shift;
+    ui_pbar_draw(&progress_pbar);
+
+    if (++progress_rate_ticks >= PROGRESS_RATE_INTERVAL) {
+        progress_rate_ticks = 0;
+        progress_draw_rate(done);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Long-running operations only add to progress_done; the progress bar,
+// work indicator and transfer rate are drawn by the VBlank interrupt.
+
+#define PROGRESS_NO_BAR 0xFF
+
+extern volatile uint32_t progress_done;
+
+// y: progress bar row (rate/ETA are shown below it), or PROGRESS_NO_BAR
+// total: in bytes
+void progress_start(uint8_t y, uint32_t total);
+void progress_finish(void);
+void progress_vblank(void);
+
+static inline void progress_add(uint32_t bytes) {
+    progress_done += bytes;
+}
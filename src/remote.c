@@ -0,0 +1,255 @@
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ws.h>
+#include "config.h"
+#include "deploy.h"
+#include "driver.h"
+#include "lang.h"
+#include "remote.h"
+#include "serial.h"
+#include "settings.h"
+#include "titledb.h"
+#include "ui.h"
+#include "util.h"
+#include "xmodem.h"
+
+#ifdef USE_SLOT_SYSTEM
+
+#define REMOTE_TIMEOUT 75
+#define REMOTE_HEADER_SIZE 4
+
+typedef struct {
+    uint8_t seq;
+    uint8_t cmd;
+    uint16_t len;
+    uint8_t data[REMOTE_MAX_PAYLOAD];
+} remote_frame_t;
+
+static inline uint16_t remote_get16(const uint8_t *data) {
+    return data[0] | (data[1] << 8);
+}
+
+static void remote_putc(uint16_t *crc, uint8_t value) {
+    ws_serial_putc(value);
+    *crc = crc16_xmodem_update(*crc, value);
+}
+
+static void remote_send(uint8_t seq, uint8_t cmd, uint8_t status, const uint8_t *data, uint16_t len) {
+    uint16_t crc = 0;
+
+    ws_serial_putc(REMOTE_SYNC);
+    remote_putc(&crc, seq);
+    remote_putc(&crc, cmd);
+    remote_putc(&crc, len + 1);
+    remote_putc(&crc, (len + 1) >> 8);
+    remote_putc(&crc, status);
+    for (uint16_t i = 0; i < len; i++) {
+        remote_putc(&crc, data[i]);
+    }
+    ws_serial_putc(crc >> 8);
+    ws_serial_putc(crc);
+}
+
+// Returns false if the user wants to exit.
+// On return, frame->cmd is REMOTE_CMD_NAK if no valid frame was received.
+static bool remote_recv(remote_frame_t *frame) {
+    uint8_t header[REMOTE_HEADER_SIZE];
+    uint16_t crc = 0;
+    int16_t r;
+
+    frame->cmd = REMOTE_CMD_NAK;
+    while ((r = serial_getc_buffered_nonblock()) != REMOTE_SYNC) {
+        if (r < 0) {
+            if (xmodem_poll_exit()) return false;
+            cpu_halt();
+        }
+    }
+
+    for (uint8_t i = 0; i < REMOTE_HEADER_SIZE; i++) {
+        if ((r = serial_getc_buffered_timeout(REMOTE_TIMEOUT)) < 0) return true;
+        header[i] = r;
+        crc = crc16_xmodem_update(crc, r);
+    }
+    frame->len = remote_get16(header + 2);
+    if (frame->len > REMOTE_MAX_PAYLOAD) {
+        // most likely a stray sync byte; look for the next one
+        return true;
+    }
+    for (uint16_t i = 0; i < frame->len; i++) {
+        if ((r = serial_getc_buffered_timeout(REMOTE_TIMEOUT)) < 0) return true;
+        frame->data[i] = r;
+        crc = crc16_xmodem_update(crc, r);
+    }
+    for (uint8_t i = 0; i < 2; i++) {
+        if ((r = serial_getc_buffered_timeout(REMOTE_TIMEOUT)) < 0) return true;
+        crc ^= ((uint16_t) r) << (i ? 0 : 8);
+    }
+    if (crc == 0) {
+        frame->seq = header[0];
+        frame->cmd = header[1];
+    }
+    return true;
+}
+
+static bool remote_slot_writable(uint8_t slot) {
+    return slot < GAME_SLOTS && slot != driver_get_launch_slot();
+}
+
+// Handles a request, replacing its payload with the response.
+static uint8_t remote_handle(remote_frame_t *frame) {
+    uint8_t *data = frame->data;
+    uint16_t len = frame->len;
+
+    switch (frame->cmd) {
+    case REMOTE_CMD_HELLO:
+        data[0] = REMOTE_VERSION;
+        data[1] = (uint8_t) REMOTE_MAX_PAYLOAD;
+        data[2] = REMOTE_MAX_PAYLOAD >> 8;
+        data[3] = (uint8_t) SERIAL_RXBUF_SIZE;
+        data[4] = SERIAL_RXBUF_SIZE >> 8;
+        data[5] = GAME_SLOTS;
+        data[6] = driver_get_launch_slot();
+        frame->len = 7;
+        return REMOTE_OK;
+    case REMOTE_CMD_SLOT_INFO: {
+        uint8_t slot = data[0];
+        if (len < 1 || slot >= GAME_SLOTS) return REMOTE_ERR_ARGUMENT;
+        data[0] = settings_local.slot_type[slot];
+        memcpy(data + 1, settings_local.slot_name[slot], 24);
+        frame->len = 25;
+        return REMOTE_OK;
+    }
+    case REMOTE_CMD_READ_HEADER:
+        if (len < 2 || data[0] >= GAME_SLOTS) return REMOTE_ERR_ARGUMENT;
+        frame->len = 16;
+        return driver_read_slot(data, data[0], data[1], 0xFFF0, 16) ? REMOTE_OK : REMOTE_ERR_VERIFY;
+    case REMOTE_CMD_READ: {
+        uint8_t slot = data[0];
+        uint8_t bank = data[1];
+        uint16_t offset = remote_get16(data + 2);
+        frame->len = remote_get16(data + 4);
+        if (len < 6 || slot >= GAME_SLOTS || frame->len > REMOTE_MAX_PAYLOAD - 1
+            || ((uint32_t) offset + frame->len) > 0x10000) {
+            frame->len = 0;
+            return REMOTE_ERR_ARGUMENT;
+        }
+        return driver_read_slot(data, slot, bank, offset, frame->len) ? REMOTE_OK : REMOTE_ERR_VERIFY;
+    }
+    case REMOTE_CMD_WRITE: {
+        uint8_t slot = data[0];
+        uint32_t pos = ((uint32_t) data[1] << 16) | remote_get16(data + 2);
+        frame->len = 0;
+        if (len < 4 || ((pos & 0xFFFF) + (len - 4)) > 0x10000) return REMOTE_ERR_ARGUMENT;
+        if (!remote_slot_writable(slot)) return REMOTE_ERR_PROTECTED;
+        titledb_invalidate_bank(slot, pos >> 16);
+        return deploy_write_chunk(data + 4, slot, pos, len - 4) ? REMOTE_OK : REMOTE_ERR_VERIFY;
+    }
+    case REMOTE_CMD_ERASE:
+        frame->len = 0;
+        if (len < 2) return REMOTE_ERR_ARGUMENT;
+        if (!remote_slot_writable(data[0])) return REMOTE_ERR_PROTECTED;
+        titledb_invalidate_bank(data[0], data[1] & 0xFE);
+        driver_erase_bank(0, data[0], data[1] & 0xFE);
+        return REMOTE_OK;
+    case REMOTE_CMD_SRAM_READ:
+    case REMOTE_CMD_SRAM_WRITE: {
+        uint8_t bank = data[0];
+        uint16_t offset = remote_get16(data + 1);
+        uint16_t sram_len = (frame->cmd == REMOTE_CMD_SRAM_READ) ? remote_get16(data + 3) : (len - 3);
+        if (len < 3 || (frame->cmd == REMOTE_CMD_SRAM_READ && (len < 5 || sram_len > REMOTE_MAX_PAYLOAD - 1))
+            || ((uint32_t) offset + sram_len) > 0x10000) {
+            frame->len = 0;
+            return REMOTE_ERR_ARGUMENT;
+        }
+        uint8_t prev_bank = inportb(IO_BANK_RAM);
+        outportb(IO_BANK_RAM, bank);
+        if (frame->cmd == REMOTE_CMD_SRAM_READ) {
+            memcpy(data, MK_FP(0x1000, offset), sram_len);
+            frame->len = sram_len;
+        } else {
+            memcpy(MK_FP(0x1000, offset), data + 3, sram_len);
+            frame->len = 0;
+        }
+        outportb(IO_BANK_RAM, prev_bank);
+        return REMOTE_OK;
+    }
+    case REMOTE_CMD_LAUNCH:
+        frame->len = 0;
+        if (len < 2) return REMOTE_ERR_ARGUMENT;
+        // launching CartFriend's own slot would only restart it
+        if (!remote_slot_writable(data[0])) return REMOTE_ERR_PROTECTED;
+        // only ROMs ending at the last bank of a (sub)slot, as in Browse,
+        // have a save block mapping
+        if ((data[1] & 0x8F) != 0x8F) return REMOTE_ERR_ARGUMENT;
+        return REMOTE_OK;
+    default:
+        frame->len = 0;
+        return REMOTE_ERR_COMMAND;
+    }
+}
+
+void remote_ui_run(void) {
+    remote_frame_t frame;
+    uint8_t seq_expected = 0;
+    bool nak_sent = false;
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_REMOTE_ACTIVE]);
+    ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
+
+    xmodem_open_default();
+    driver_irq_passthrough = HWINT_SERIAL_RX;
+    driver_unlock();
+    while (remote_recv(&frame)) {
+        // HELLO (re)starts a session at any sequence number
+        if (frame.cmd == REMOTE_CMD_NAK || (frame.seq != seq_expected && frame.cmd != REMOTE_CMD_HELLO)) {
+            // the host resends everything from seq_expected on; until then,
+            // the frames still in flight are dropped quietly
+            if (!nak_sent) {
+                remote_send(seq_expected, REMOTE_CMD_NAK | REMOTE_CMD_RESPONSE, REMOTE_ERR_FRAME, &seq_expected, 1);
+                nak_sent = true;
+            }
+            continue;
+        }
+        seq_expected = frame.seq + 1;
+        nak_sent = false;
+
+        uint8_t cmd = frame.cmd;
+        uint8_t slot = frame.data[0];
+        uint8_t bank = frame.data[1];
+        uint8_t status = remote_handle(&frame);
+        remote_send(frame.seq, cmd | REMOTE_CMD_RESPONSE, status, frame.data, frame.len);
+        if (cmd == REMOTE_CMD_LAUNCH && status == REMOTE_OK) {
+            driver_lock();
+            driver_irq_passthrough = 0;
+            xmodem_close();
+            // the first of the game's save blocks, as for WW
+            ui_reset_main_screen();
+            ui_browse_prepare_launch(slot | ((bank ^ 0xFF) & 0xF0), false);
+            launch_slot(slot, bank);
+        }
+    }
+    driver_lock();
+    driver_irq_passthrough = 0;
+    xmodem_close();
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Binary remote control protocol, see tools/cfremote.py.
+//
+// Frames in both directions:
+//   0xA5, u8 sequence, u8 command, u16 payload length, payload,
+//   CRC16 (XMODEM, big-endian) of everything past the 0xA5
+// Responses echo the sequence, set bit 7 of the command and start their
+// payload with a status byte. Requests are answered strictly in order, so
+// the host may keep several in flight, as long as they fit into the
+// RX buffer (reported by REMOTE_CMD_HELLO). If a request arrives damaged
+// or out of sequence, it and everything after it is dropped, and
+// REMOTE_CMD_NAK tells the host which sequence number to resend from.
+// All multi-byte values are little-endian, unless noted otherwise.
+
+#define REMOTE_VERSION 1
+#define REMOTE_SYNC 0xA5
+#define REMOTE_MAX_PAYLOAD 256
+
+#define REMOTE_CMD_HELLO 0x00 // -> u8 version, u16 max payload, u16 RX buffer size, u8 slots, u8 launch slot
+#define REMOTE_CMD_SLOT_INFO 0x01 // u8 slot -> u8 type, u8 name[24]
+#define REMOTE_CMD_READ_HEADER 0x02 // u8 slot, u8 bank -> u8 header[16]
+#define REMOTE_CMD_READ 0x03 // u8 slot, u8 bank, u16 offset, u16 length -> data
+#define REMOTE_CMD_WRITE 0x04 // u8 slot, u8 bank, u16 offset, data; verified
+#define REMOTE_CMD_ERASE 0x05 // u8 slot, u8 bank; erases the 128 KB sector
+#define REMOTE_CMD_SRAM_READ 0x06 // u8 bank, u16 offset, u16 length -> data
+#define REMOTE_CMD_SRAM_WRITE 0x07 // u8 bank, u16 offset, data
+#define REMOTE_CMD_LAUNCH 0x08 // u8 slot, u8 bank (x8F-xFF, the last of a (sub)slot); maps its save block first
+#define REMOTE_CMD_NAK 0x7F // (response only) u8 expected sequence
+#define REMOTE_CMD_RESPONSE 0x80
+
+#define REMOTE_OK 0
+#define REMOTE_ERR_COMMAND 1
+#define REMOTE_ERR_ARGUMENT 2
+#define REMOTE_ERR_PROTECTED 3
+#define REMOTE_ERR_VERIFY 4
+#define REMOTE_ERR_FRAME 5
+
+void remote_ui_run(void);
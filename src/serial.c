@@ -1,24 +1,17 @@
 #include <stdint.h>
 #include <ws.h>
+#include "config.h"
 #include "serial.h"
 
-#define SERIAL_TXBUF_SIZE 128
-
-uint8_t serial_txbuf[SERIAL_TXBUF_SIZE];
-uint8_t serial_txbuf_pos = 0, serial_txbuf_len = 0;
-
-__attribute__((interrupt))
-static void serial_txbuf_int_handler(void) __far {
-    if (serial_txbuf_pos != serial_txbuf_len) {
-        ws_serial_putc(serial_txbuf[serial_txbuf_pos]);
-        serial_txbuf_pos = (serial_txbuf_pos + 1) & (SERIAL_TXBUF_SIZE - 1);
-    }
-    if (serial_txbuf_pos == serial_txbuf_len) {
-        ws_hwint_disable(HWINT_SERIAL_TX);
-    }
-}
+// The TX ring buffer is drained by serial_txbuf_int_handler (serial_asm.s).
+extern uint8_t serial_txbuf[SERIAL_TXBUF_SIZE];
+extern volatile uint8_t serial_txbuf_pos, serial_txbuf_len;
+extern void serial_txbuf_int_handler(void) __far;
 
 void serial_init_buffered(void) {
+    ws_hwint_disable(HWINT_SERIAL_TX);
+    serial_txbuf_pos = 0;
+    serial_txbuf_len = 0;
     ws_hwint_set_handler(HWINT_IDX_SERIAL_TX, serial_txbuf_int_handler);
 }
 
@@ -37,3 +30,53 @@ void serial_putc_buffered(uint8_t value) {
     serial_txbuf_len = next_len;
     ws_hwint_enable(HWINT_SERIAL_TX);
 }
+
+// The RX ring buffer is filled by serial_rxbuf_int_handler (serial_asm.s),
+// which lives in RAM. Driver calls still run with interrupts disabled,
+// unless HWINT_SERIAL_RX is set in driver_irq_passthrough.
+extern uint8_t serial_rxbuf[SERIAL_RXBUF_SIZE];
+extern volatile uint16_t serial_rxbuf_head, serial_rxbuf_tail;
+extern void serial_rxbuf_int_handler(void) __far;
+extern volatile uint16_t vbl_ticks;
+
+void serial_init_rx_buffered(void) {
+    ws_hwint_disable(HWINT_SERIAL_RX);
+    serial_rxbuf_head = 0;
+    serial_rxbuf_tail = 0;
+    serial_rx_overruns = 0;
+    ws_hwint_set_handler(HWINT_IDX_SERIAL_RX, serial_rxbuf_int_handler);
+    ws_hwint_enable(HWINT_SERIAL_RX);
+}
+
+void serial_close_rx_buffered(void) {
+    ws_hwint_disable(HWINT_SERIAL_RX);
+}
+
+uint16_t serial_rx_buffered_count(void) {
+    return (serial_rxbuf_head - serial_rxbuf_tail) & (SERIAL_RXBUF_SIZE - 1);
+}
+
+int16_t serial_getc_buffered_nonblock(void) {
+    uint16_t tail = serial_rxbuf_tail;
+    if (tail == serial_rxbuf_head) {
+        return -1;
+    }
+    uint8_t value = serial_rxbuf[tail];
+    serial_rxbuf_tail = (tail + 1) & (SERIAL_RXBUF_SIZE - 1);
+    return value;
+}
+
+// ticks: in VBlank ticks; returns -1 on timeout
+int16_t serial_getc_buffered_timeout(uint16_t ticks) {
+    uint16_t ticks_start = vbl_ticks;
+    while (1) {
+        int16_t r = serial_getc_buffered_nonblock();
+        if (r >= 0) {
+            return r;
+        }
+        if (((uint16_t) (vbl_ticks - ticks_start)) >= ticks) {
+            return -1;
+        }
+        cpu_halt();
+    }
+}
@@ -19,6 +19,14 @@
 
 #include <stdint.h>
 
+extern volatile uint16_t serial_rx_overruns;
+
 void serial_init_buffered(void);
 void serial_flush_buffered(void);
 void serial_putc_buffered(uint8_t value);
+
+void serial_init_rx_buffered(void);
+void serial_close_rx_buffered(void);
+uint16_t serial_rx_buffered_count(void);
+int16_t serial_getc_buffered_nonblock(void);
+int16_t serial_getc_buffered_timeout(uint16_t ticks);
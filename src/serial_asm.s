@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <wonderful.h>
+#include "config.h"
+
+	.arch	i186
+	.code16
+	.intel_syntax noprefix
+	.global serial_rxbuf_int_handler
+	.global serial_rxbuf
+	.global serial_rxbuf_head
+	.global serial_rxbuf_tail
+	.global serial_rx_overruns
+	.global serial_txbuf_int_handler
+	.global serial_txbuf
+	.global serial_txbuf_pos
+	.global serial_txbuf_len
+
+// The receive handler lives in RAM, so that it can run while the
+// cartridge's ROM is switched away; the driver only leaves it enabled
+// then if HWINT_SERIAL_RX is set in driver_irq_passthrough.
+	.section .data
+	.align 2
+serial_rxbuf_int_handler:
+	push ax
+	push bx
+	push ds
+	xor ax, ax
+	mov ds, ax
+
+serial_rxbuf_int_handler_loop:
+	in al, 0xB3 // serial status
+	test al, 0x01 // RX ready
+	jz serial_rxbuf_int_handler_done
+	test al, 0x02 // overrun
+	jz 1f
+	// a byte was lost before we got to it
+	or al, 0x20
+	out 0xB3, al
+	inc word ptr [serial_rx_overruns]
+1:
+	in al, 0xB1
+	mov bx, [serial_rxbuf_head]
+	mov [bx + serial_rxbuf], al
+	inc bx
+	and bx, (SERIAL_RXBUF_SIZE - 1)
+	cmp bx, [serial_rxbuf_tail]
+	je serial_rxbuf_int_handler_full
+	mov [serial_rxbuf_head], bx
+	jmp serial_rxbuf_int_handler_loop
+
+serial_rxbuf_int_handler_full:
+	inc word ptr [serial_rx_overruns]
+	jmp serial_rxbuf_int_handler_loop
+
+serial_rxbuf_int_handler_done:
+	mov al, 0x08 // serial RX
+	out 0xB6, al
+	pop ds
+	pop bx
+	pop ax
+	iret
+
+// The transmit handler also lives in RAM, so that a block can be sent
+// while the next one is read from another slot.
+	.align 2
+serial_txbuf_int_handler:
+	push ax
+	push bx
+	push ds
+	xor ax, ax
+	mov ds, ax
+
+	xor bh, bh
+	mov bl, [serial_txbuf_pos]
+	cmp bl, [serial_txbuf_len]
+	je serial_txbuf_int_handler_empty
+	mov al, [bx + serial_txbuf]
+	out 0xB1, al
+	inc bl
+	and bl, (SERIAL_TXBUF_SIZE - 1)
+	mov [serial_txbuf_pos], bl
+	cmp bl, [serial_txbuf_len]
+	jne serial_txbuf_int_handler_done
+
+serial_txbuf_int_handler_empty:
+	// nothing left to send; the interrupt stays asserted while the UART
+	// is idle, so it is disabled until more data is queued
+	in al, 0xB2
+	and al, 0xFE // serial TX
+	out 0xB2, al
+
+serial_txbuf_int_handler_done:
+	mov al, 0x01 // serial TX
+	out 0xB6, al
+	pop ds
+	pop bx
+	pop ax
+	iret
+
+	.section .bss
+	.align 2
+serial_rxbuf_head:
+	.word 0
+serial_rxbuf_tail:
+	.word 0
+serial_rx_overruns:
+	.word 0
+serial_rxbuf:
+	.skip SERIAL_RXBUF_SIZE
+serial_txbuf_pos:
+	.byte 0
+serial_txbuf_len:
+	.byte 0
+serial_txbuf:
+	.skip SERIAL_TXBUF_SIZE
@@ -31,9 +31,6 @@
 // settings changes over the lifespan of the device.
 // (I'd have preferred an SD card slot, but you gotta work with what you gotta work with.)
 
-#define SETTINGS_BANK 0xF4
-#define LEGACY_SETTINGS_BANK 0xF8
-
 uint8_t settings_slot;
 settings_t settings_local;
 bool settings_changed;
@@ -105,6 +102,19 @@ static void settings_migrate(void) {
         settings_local.active_sram_offset_size = SRAM_OFFSET_SIZE_DEFAULT;
     }
 
+    if (settings_local.version < 7) {
+        // invalidates the title cache
+        settings_local.title_cache_db = 0;
+    }
+
+    if (settings_local.version < 8) {
+        settings_local.transfer.type = TRANSFER_NONE;
+    }
+
+    if (settings_local.version < 9) {
+        _nmemset(settings_local.erase_counts, 0, sizeof(settings_local.erase_counts));
+    }
+
     settings_local.version = SETTINGS_VERSION;
 }
 
@@ -121,11 +131,9 @@ static bool try_settings_load(uint8_t settings_bank, uint8_t slot_start, uint8_t
                 bool read_ok = driver_read_slot(((uint8_t*) &settings_local) + 6, driver_get_launch_slot(), bank, offset + 6, sizeof(settings_local) - 6);
                 uint16_t settings_crc;
                 read_ok &= driver_read_slot(&settings_crc, driver_get_launch_slot(), bank, offset + 1022, 2);
-                if (read_ok) {
-                    uint16_t settings_crc_calculated = settings_calculate_crc();
-                    // TODO: check settings CRC
-                    return true;
-                }
+                // a copy with a bad CRC, e.g. one which failed to verify
+                // when saved, is skipped for the one before it
+                if (read_ok && settings_crc == settings_calculate_crc()) return true;
             }
             
             if (settings_slot == slot_start) return false;
@@ -212,12 +220,6 @@ void settings_save(void) {
 
     ui_step_work_indicator();
 
-    if (settings_slot >= 127) {
-        settings_erase_slots();
-    } else {
-        settings_slot++;
-    }
-
     uint8_t active_sram_slot = settings_local.active_sram_slot;
     uint8_t active_sram_offset_size = settings_local.active_sram_offset_size;
     if (active_sram_slot == SRAM_SLOT_FIRST_BOOT) {
@@ -225,13 +227,25 @@ void settings_save(void) {
         settings_local.active_sram_offset_size = SRAM_OFFSET_SIZE_DEFAULT;
     }
 
-    uint8_t bank = SETTINGS_BANK + (settings_slot >> 6);
-    uint16_t offset = settings_slot << 10;
-    // write settings data
-    driver_write_slot(&settings_local, driver_get_launch_slot(), bank, offset, sizeof(settings_local));
-    // write settings CRC
-    uint16_t settings_crc = settings_calculate_crc();
-    driver_write_slot(&settings_crc, driver_get_launch_slot(), bank, offset + 1022, 2);
+    // a copy which does not verify is skipped on load, as its CRC will not
+    // match; try once more in the next slot
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+        if (settings_slot >= 127) {
+            settings_erase_slots();
+        } else {
+            settings_slot++;
+        }
+        // after erasing, which updates the erase counts
+        uint16_t settings_crc = settings_calculate_crc();
+
+        uint8_t bank = SETTINGS_BANK + (settings_slot >> 6);
+        uint16_t offset = settings_slot << 10;
+        // write settings data, then CRC
+        if (driver_write_slot_verify(&settings_local, driver_get_launch_slot(), bank, offset, sizeof(settings_local))
+            && driver_write_slot_verify(&settings_crc, driver_get_launch_slot(), bank, offset + 1022, 2)) {
+            break;
+        }
+    }
 
     settings_local.active_sram_slot = active_sram_slot;
     settings_local.active_sram_offset_size = active_sram_offset_size;
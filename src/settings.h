@@ -26,14 +26,42 @@
 #define SLOT_TYPE_8M_2M 3
 #define SLOT_TYPE_UNUSED 0xFF
 
-#define SETTINGS_VERSION 6
+#define SETTINGS_VERSION 9
 
 #define SRAM_SLOT_ALL 0xFD
 #define SRAM_SLOT_FIRST_BOOT 0xFE
 #define SRAM_SLOT_NONE 0xFF
 
+#define TITLE_CACHE_ENTRIES (GAME_SLOTS * 8)
+
+#define SETTINGS_BANK 0xF4
+#define LEGACY_SETTINGS_BANK 0xF8
+
+// The launcher slot's save blocks and settings, banks 0x80 .. 0xF9.
+#define ERASE_COUNT_BANK_FIRST 0x80
+#define ERASE_COUNT_SECTORS 61
+
+#define TRANSFER_NONE 0
+#define TRANSFER_ROM 1
+#define TRANSFER_WW_OS 2
+
 extern bool settings_first_boot;
 extern bool settings_location_legacy;
+
+typedef struct __attribute__((packed)) {
+	uint8_t key; // header checksum, folded
+	uint16_t title; // title database index
+} title_cache_entry_t;
+
+// Progress of an interrupted serial transfer, so that it can be resumed.
+typedef struct __attribute__((packed)) {
+	uint8_t type; // TRANSFER_*
+	uint8_t entry_id; // TRANSFER_ROM: target slot; TRANSFER_WW_OS: slot | base bank
+	uint32_t size; // as announced by the sender
+	uint32_t done; // bytes committed so far
+	uint16_t crc; // CRC16 of the committed data in flash
+} transfer_checkpoint_t;
+
 typedef struct __attribute__((packed)) {
 	uint8_t magic[4];
 	uint16_t version; // 6
@@ -52,10 +80,19 @@ typedef struct __attribute__((packed)) {
 	// bit 0-3: offset (0-7)
 	// bit 4-7: size (1-8)
 	uint8_t active_sram_offset_size; // 426
+
+	// title database the cache below was computed against
+	uint16_t title_cache_db; // 428
+	title_cache_entry_t title_cache[TITLE_CACHE_ENTRIES]; // 812
+
+	transfer_checkpoint_t transfer; // 824
+
+	// per 128 KB sector, counted by driver_erase_bank()
+	uint16_t erase_counts[ERASE_COUNT_SECTORS]; // 946
 } settings_t;
 
 #if __STDC_VERSION__ >= 201112L
-_Static_assert(sizeof(settings_t) == 426, "settings_t size error");
+_Static_assert(sizeof(settings_t) == 946, "settings_t size error");
 #endif
 
 #define SETT_FLAGS1_HIDE_SLOT_IDS 0x01
@@ -21,13 +21,17 @@
 #include <wonderful.h>
 #include <ws.h>
 #include "config.h"
+#include "deploy.h"
 #include "driver.h"
 #include "error.h"
 #include "lang.h"
+#include "progress.h"
 #include "settings.h"
 #include "sram.h"
+#include "task.h"
 #include "ui.h"
 #include "util.h"
+#include "xmodem.h"
 
 #ifdef USE_SLOT_SYSTEM
 #define USE_PARTIAL_WRITES
@@ -35,7 +39,7 @@
 bool sram_ui_quiet = false;
 
 static inline uint8_t sram_get_bank(uint8_t sram_slot, uint16_t sub_bank) {
-    uint8_t slot = 0x80 + (sram_slot << 3);
+    uint8_t slot = 0x80 + (sram_slot * SRAM_BLOCK_BANKS);
     uint8_t bank = slot + sub_bank;
     // carve out a settings area between F40000 .. F5FFFF
     // this allows writing a Pocket Challenge V2 bootloader there
@@ -50,17 +54,58 @@ static inline uint8_t sram_get_bank(uint8_t sram_slot, uint16_t sub_bank) {
 bool sram_copy_to_buffer_check_flash(void* restrict s1, uint16_t offset);
 bool sram_copy_from_bank1(uint16_t offset, uint16_t words);
 
+typedef struct {
+    uint8_t sram_slot;
+    uint8_t driver_slot;
+    uint8_t bank_offset;
+    uint8_t bank;
+    uint8_t erase_pos, erase_count;
+    uint16_t pos, count;
+    uint8_t buffer[256];
+} sram_backup_job_t;
+
+static bool sram_backup_step(void *userdata) {
+    sram_backup_job_t *job = (sram_backup_job_t*) userdata;
+
+    // erase slots first
+    if (job->erase_pos < job->erase_count) {
+        driver_erase_bank(0, job->driver_slot, sram_get_bank(job->sram_slot, job->erase_pos + job->bank_offset));
+        job->erase_pos++;
+        return true;
+    }
+
+    if (job->pos >= job->count) return false;
+
+    uint16_t i = job->pos++;
+    if (!(i & 255)) {
+        outportb(IO_BANK_RAM, i >> 8);
+        asm volatile("" ::: "memory");
+        job->bank = sram_get_bank(job->sram_slot, (i >> 8) + job->bank_offset);
+    }
+
+    uint16_t offset = (i << 8);
+
+#ifdef USE_PARTIAL_WRITES
+    if (sram_copy_to_buffer_check_flash(job->buffer, offset)) {
+        if (!driver_write_slot_verify(job->buffer, job->driver_slot, job->bank, offset, sizeof(job->buffer)))
+            error_critical(ERROR_CODE_SRAM_VERIFY_FAILED, i);
+    }
+#else
+    uint8_t __far* sram_buffer = MK_FP(0x1000, offset);
+    memcpy(job->buffer, sram_buffer, 256);
+    if (!driver_write_slot_verify(job->buffer, job->driver_slot, job->bank, offset, sizeof(job->buffer)))
+        error_critical(ERROR_CODE_SRAM_VERIFY_FAILED, i);
+#endif
+    progress_add(sizeof(job->buffer));
+    return true;
+}
+
 static void sram_backup_restore_slot(uint8_t sram_slot, uint8_t offset_size, bool is_restore) {
     uint8_t driver_slot = driver_get_launch_slot();
-    uint8_t buffer[256];
+    sram_backup_job_t job;
     uint8_t bank_offset = offset_size & 0xF;
     uint8_t bank_size = offset_size >> 4;
-    ui_pbar_state_t pbar = {
-        .x = 0,
-        .y = 13,
-        .width = 27
-    };
-    ui_pbar_init(&pbar);
+    uint8_t pbar_y = sram_ui_quiet ? PROGRESS_NO_BAR : 13;
 
     if (!sram_ui_quiet) {
         ui_reset_main_screen();
@@ -73,14 +118,8 @@ static void sram_backup_restore_slot(uint8_t sram_slot, uint8_t offset_size, boo
 
     if (_CS >= 0x2000) {
         if (is_restore) {
-            pbar.step_max = 32 * bank_size;
+            progress_start(pbar_y, (uint32_t) bank_size << 16);
             for (uint16_t i = 0; i < 32 * bank_size; i++) {
-                pbar.step = i;
-                if (!sram_ui_quiet) {
-                    ui_pbar_draw(&pbar);
-                }
-                ui_step_work_indicator();
-
                 if (!(i & 31)) {
                     outportb(IO_BANK_RAM, i >> 5);
                     uint8_t bank = sram_get_bank(sram_slot, (i >> 5) + bank_offset);
@@ -92,6 +131,7 @@ static void sram_backup_restore_slot(uint8_t sram_slot, uint8_t offset_size, boo
                 // ROM -> SRAM
                 sram_copy_from_bank1(offset, 2048 >> 1);
                 // memcpy(MK_FP(0x1000, offset), MK_FP(0x3000, offset), 2048);
+                progress_add(2048);
             }
         } else {
             // for backup, erase slots first
@@ -100,9 +140,9 @@ static void sram_backup_restore_slot(uint8_t sram_slot, uint8_t offset_size, boo
                 if (bank_offset & 1) {
                     for (uint16_t i = 0; i < 256; i++) {
                         outportb(IO_BANK_RAM, 0);
-                        memcpy(buffer, MK_FP(0x1000, i << 8), 256);
+                        memcpy(job.buffer, MK_FP(0x1000, i << 8), 256);
                         outportb(IO_BANK_RAM, 1);
-                        memcpy(MK_FP(0x1000, i << 8), buffer, 256);
+                        memcpy(MK_FP(0x1000, i << 8), job.buffer, 256);
                     }
                 }
 
@@ -119,47 +159,59 @@ static void sram_backup_restore_slot(uint8_t sram_slot, uint8_t offset_size, boo
                 error_critical(ERROR_CODE_SRAM_ODD_SIZE_UNHANDLED, offset_size);
             }
             
-            for (uint8_t i = 0; i < bank_size; i++) {
-                ui_step_work_indicator();
-                uint8_t bank = sram_get_bank(sram_slot, i + bank_offset);
-                driver_erase_bank(0, driver_slot, bank);
-            }
-
-            pbar.step_max = 256 * bank_size;
-            uint8_t bank;
-            for (uint16_t i = 0; i < 256 * bank_size; i++) {
-                pbar.step = i;
-                if (!(i & 7)) {
-                    if (!sram_ui_quiet) {
-                        ui_pbar_draw(&pbar);
-                    }
-                    if (!(i & 255)) {
-                        outportb(IO_BANK_RAM, i >> 8);
-                        asm volatile("" ::: "memory");
-                        bank = sram_get_bank(sram_slot, (i >> 8) + bank_offset);
-                    }
-                }
-                ui_step_work_indicator();
-
-                uint16_t offset = (i << 8);
-
-#ifdef USE_PARTIAL_WRITES
-                if (sram_copy_to_buffer_check_flash(buffer, offset)) {
-                    driver_write_slot(buffer, driver_slot, bank, offset, sizeof(buffer));
-                }
-#else
-                uint8_t __far* sram_buffer = MK_FP(0x1000, offset);
-                memcpy(buffer, sram_buffer, 256);
-                driver_write_slot(buffer, driver_slot, bank, offset, sizeof(buffer));
-#endif
-            }
+            job.sram_slot = sram_slot;
+            job.driver_slot = driver_slot;
+            job.bank_offset = bank_offset;
+            job.erase_pos = 0;
+            job.erase_count = bank_size;
+            job.pos = 0;
+            job.count = 256 * bank_size;
+
+            // the save data must end up in flash, so this is not cancellable
+            task_t task = {
+                .step = sram_backup_step,
+                .userdata = &job
+            };
+            progress_start(pbar_y, (uint32_t) bank_size << 16);
+            task_run(&task);
         }
+        progress_finish();
     }
 
-    ui_clear_work_indicator();
     ui_update_indicators();
 }
 
+typedef struct {
+    uint8_t sram_slot;
+    uint8_t driver_slot;
+    uint8_t bank_offset;
+    uint8_t bank_size;
+    uint16_t pos, count;
+} sram_erase_job_t;
+
+static bool sram_erase_step(void *userdata) {
+    sram_erase_job_t *job = (sram_erase_job_t*) userdata;
+    if (job->pos >= job->count) return false;
+
+    uint16_t i = job->pos++;
+    if (job->sram_slot == SRAM_SLOT_NONE) {
+        ws_bank_ram_set(i >> 4);
+        uint8_t __far* sram_buffer = MK_FP(0x1000, i << 12);
+        memset(sram_buffer, 0xFF, 1 << 12);
+        progress_add(1 << 12);
+    } else {
+        uint8_t rom_slot;
+        if (job->sram_slot == SRAM_SLOT_ALL) {
+            rom_slot = sram_get_bank(i / job->bank_size, (i % job->bank_size) + job->bank_offset);
+        } else {
+            rom_slot = sram_get_bank(job->sram_slot, i + job->bank_offset);
+        }
+        driver_erase_bank(0, job->driver_slot, rom_slot);
+        progress_add(0x10000);
+    }
+    return true;
+}
+
 void sram_erase(uint8_t sram_slot, uint8_t offset_size) {
     uint8_t bank_offset = offset_size & 0xF;
     uint8_t bank_size = offset_size >> 4;
@@ -169,56 +221,30 @@ void sram_erase(uint8_t sram_slot, uint8_t offset_size) {
         ui_puts_centered(false, 2, 0, lang_keys[LK_UI_MSG_ERASE_SRAM]);
     }
 
-    ui_pbar_state_t pbar = {
-        .x = 0,
-        .y = 13,
-        .width = 27
+    sram_erase_job_t job = {
+        .sram_slot = sram_slot,
+        .driver_slot = driver_get_launch_slot(),
+        .bank_offset = bank_offset,
+        .bank_size = bank_size,
+        .pos = 0
+    };
+    task_t task = {
+        .step = sram_erase_step,
+        .userdata = &job,
+        .flags = 0
     };
 
     if (sram_slot == SRAM_SLOT_NONE) {
-        pbar.step_max = 16 * bank_size;
-        ui_pbar_init(&pbar);
-
-        for (uint16_t i = 0; i < 16 * bank_size; i++) {
-            pbar.step = i;
-            if (!sram_ui_quiet) ui_pbar_draw(&pbar);
-            ui_step_work_indicator();
-
-            ws_bank_ram_set(i >> 4);
-            uint8_t __far* sram_buffer = MK_FP(0x1000, i << 12);
-            memset(sram_buffer, 0xFF, 1 << 12);
-        }
-
-        ui_clear_work_indicator();
-    } else if (sram_slot == SRAM_SLOT_ALL) {
-        pbar.step_max = bank_size * SRAM_SLOTS;
-        ui_pbar_init(&pbar);
-
-        uint8_t driver_slot = driver_get_launch_slot();
-
-        for (uint8_t i = 0; i < pbar.step_max; i++) {
-            pbar.step = i;
-            if (!sram_ui_quiet) ui_pbar_draw(&pbar);
-            ui_step_work_indicator();
-
-            uint8_t rom_slot = sram_get_bank(i / bank_size, (i % bank_size) + bank_offset);
-            driver_erase_bank(0, driver_slot, rom_slot);
-        }
+        job.count = 16 * bank_size;
+        progress_start(sram_ui_quiet ? PROGRESS_NO_BAR : 13, (uint32_t) job.count << 12);
     } else {
-        pbar.step_max = bank_size;
-        ui_pbar_init(&pbar);
-
-        uint8_t driver_slot = driver_get_launch_slot();
-
-        for (uint8_t i = 0; i < bank_size; i++) {
-            pbar.step = i;
-            if (!sram_ui_quiet) ui_pbar_draw(&pbar);
-            ui_step_work_indicator();
-
-            uint8_t rom_slot = sram_get_bank(sram_slot, i + bank_offset);
-            driver_erase_bank(0, driver_slot, rom_slot);
-        }
+        job.count = (sram_slot == SRAM_SLOT_ALL) ? (bank_size * SRAM_SLOTS) : bank_size;
+        progress_start(sram_ui_quiet ? PROGRESS_NO_BAR : 13, (uint32_t) job.count << 16);
+        // not cancellable: a block left unerased would be restored into SRAM
+        // as a save, and the callers treat the erase as done
     }
+    task_run(&task);
+    progress_finish();
 
     ui_update_indicators();
 }
@@ -238,8 +264,6 @@ void sram_switch_to_slot(uint8_t sram_slot, uint8_t offset_size) {
         return;
     }
 
-    bool unlocked = false;
-
     if (sram_slot >= SRAM_SLOTS && sram_slot != SRAM_SLOT_NONE) {
         error_critical(ERROR_CODE_SRAM_SLOT_OVERFLOW_SWITCH, sram_slot);
     }
@@ -258,6 +282,165 @@ void sram_switch_to_slot(uint8_t sram_slot, uint8_t offset_size) {
         settings_mark_changed();
     }
 }
+
+uint32_t sram_block_save_size(uint8_t sram_slot) {
+    uint8_t header[16];
+    uint8_t slot = settings_local.sram_slot_mapping[sram_slot];
+    bool read_ok = false;
+    if (slot < GAME_SLOTS) {
+        driver_unlock();
+        read_ok = driver_read_slot(header, slot, 0xFF, 0xFFF0, sizeof(header));
+        driver_lock();
+    }
+    if (read_ok) {
+        switch (header[11] & 0x0F) {
+        case 0x1: return 0x2000;
+        case 0x2: return 0x8000;
+        case 0x3: return 0x20000;
+        case 0x4: return 0x40000;
+        case 0x5: return 0x80000;
+        }
+    }
+    return (uint32_t) SRAM_BLOCK_BANKS << 16;
+}
+
+static uint16_t sram_xmodem_result_lk(uint8_t result) {
+    if (result == XMODEM_ERROR) return LK_UI_XMODEM_ERROR;
+    return LK_UI_XMODEM_CANCEL;
+}
+
+void sram_ui_export(uint8_t sram_slot) {
+    // the active block's data lives in SRAM until the next switch
+    bool active = sram_slot == settings_local.active_sram_slot;
+    uint32_t size = sram_block_save_size(sram_slot);
+    uint8_t prev_bank_ram = inportb(IO_BANK_RAM);
+    uint16_t lk_result;
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_SEND]);
+    ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
+
+    xmodem_open_default();
+    uint8_t result = xmodem_send_start();
+    if (result == XMODEM_OK) {
+        ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
+        progress_start(14, size);
+        // save sizes are multiples of 1 KB, so blocks never cross a bank
+        for (uint32_t pos = 0; pos < size && result == XMODEM_OK; pos += XMODEM_BLOCK_SIZE_1K) {
+            uint16_t offset = pos;
+            const uint8_t __far* block;
+            if (active) {
+                outportb(IO_BANK_RAM, pos >> 16);
+                block = MK_FP(0x1000, offset);
+            } else {
+                outportb(IO_BANK_ROM1, sram_get_bank(sram_slot, pos >> 16));
+                block = MK_FP(0x3000, offset);
+            }
+            result = xmodem_send_block(block, XMODEM_BLOCK_SIZE_1K);
+            progress_add(XMODEM_BLOCK_SIZE_1K);
+        }
+        progress_finish();
+        if (result == XMODEM_OK) {
+            result = xmodem_send_finish();
+        }
+    }
+    outportb(IO_BANK_RAM, prev_bank_ram);
+    lk_result = (result == XMODEM_OK) ? LK_UI_XMODEM_COMPLETE : sram_xmodem_result_lk(result);
+    ui_tool_xmodem_ui_message(lk_result);
+
+    xmodem_close();
+    while (!xmodem_poll_exit()) cpu_halt();
+}
+
+static bool sram_import_write(uint8_t *data, uint8_t sram_slot, bool active, uint32_t pos, uint16_t len) {
+    while (len > 0) {
+        uint8_t bank = pos >> 16;
+        uint16_t offset = pos;
+        uint16_t n = len;
+        // blocks are not contiguous in flash around the settings area
+        if (offset != 0 && ((uint16_t) (0 - offset)) < n) {
+            n = 0 - offset;
+        }
+        if (active) {
+            outportb(IO_BANK_RAM, bank);
+            memcpy(MK_FP(0x1000, offset), data, n);
+        } else if (!deploy_write_chunk(data, driver_get_launch_slot(), (((uint32_t) sram_get_bank(sram_slot, bank)) << 16) | offset, n)) {
+            return false;
+        }
+        data += n;
+        pos += n;
+        len -= n;
+    }
+    return true;
+}
+
+void sram_ui_import(uint8_t sram_slot) {
+    uint8_t buffer[XMODEM_BLOCK_SIZE_1K];
+    bool active = sram_slot == settings_local.active_sram_slot;
+    uint32_t size = sram_block_save_size(sram_slot);
+    uint8_t prev_bank_ram = inportb(IO_BANK_RAM);
+    uint16_t lk_result = LK_UI_XMODEM_CANCEL;
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_RECEIVE]);
+    ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
+
+    xmodem_open_default();
+    if (xmodem_recv_start() == XMODEM_OK) {
+        ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
+        progress_start(14, size);
+        driver_irq_passthrough = HWINT_SERIAL_RX;
+        uint32_t received = 0;
+        bool erased = active;
+        bool running = true;
+        while (running) {
+            uint16_t len = sizeof(buffer);
+            uint8_t result = xmodem_recv_block(buffer, &len);
+            switch (result) {
+            case XMODEM_COMPLETE:
+                xmodem_recv_finish();
+                lk_result = LK_UI_XMODEM_COMPLETE;
+                running = false;
+                break;
+            case XMODEM_OK:
+                // anything past the game's save size is dropped
+                if (len > size - received) len = size - received;
+                if (!erased) {
+                    // erase only the 128 KB sectors the save covers, once the
+                    // first block has arrived, so that a transfer which never
+                    // starts leaves the save in place
+                    uint8_t banks = ((size + 0x1FFFF) >> 17) << 1;
+                    ui_tool_xmodem_ui_message(LK_UI_ROM_RECEIVE_ERASING);
+                    for (uint8_t i = 0; i < banks; i++) {
+                        driver_erase_bank(0, driver_get_launch_slot(), sram_get_bank(sram_slot, i));
+                    }
+                    ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
+                    erased = true;
+                }
+                if (len > 0 && !sram_import_write(buffer, sram_slot, active, received, len)) {
+                    xmodem_recv_cancel();
+                    lk_result = LK_UI_ROM_RECEIVE_VERIFY_FAILED;
+                    running = false;
+                    break;
+                }
+                received += len;
+                progress_add(len);
+                break;
+            default:
+                lk_result = sram_xmodem_result_lk(result);
+                running = false;
+                break;
+            }
+        }
+        driver_irq_passthrough = 0;
+        progress_finish();
+    }
+    outportb(IO_BANK_RAM, prev_bank_ram);
+    ui_tool_xmodem_ui_message(lk_result);
+
+    xmodem_close();
+    while (!xmodem_poll_exit()) cpu_halt();
+}
 #else
 void sram_switch_to_slot(uint8_t sram_slot, uint8_t offset_size) {
     // stub
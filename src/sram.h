@@ -40,3 +40,14 @@ void sram_switch_to_slot(uint8_t sram_slot, uint8_t offset_size);
 static inline void sram_unload(void) {
     sram_switch_to_slot(SRAM_SLOT_NONE, SRAM_OFFSET_SIZE_DEFAULT);
 }
+
+// Each save block holds up to 512 KB of save data in flash.
+#define SRAM_BLOCK_BANKS 8
+// The SRAM size declared by the header of the game mapped to the block,
+// or the whole block if it is not known.
+uint32_t sram_block_save_size(uint8_t sram_slot);
+// Transfer a save block over XMODEM, trimmed to sram_block_save_size().
+// The active block is read from/written to SRAM; other blocks are streamed
+// from/to flash directly, without switching to them.
+void sram_ui_export(uint8_t sram_slot);
+void sram_ui_import(uint8_t sram_slot);
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ws.h>
+#include "driver.h"
+#include "input.h"
+#include "lang.h"
+#include "task.h"
+#include "ui.h"
+
+extern volatile uint16_t vbl_ticks;
+
+// returns false if the job should be cancelled
+static bool task_pause(const task_t *task) {
+    uint8_t result = ui_dialog_run(0, 0, LK_DIALOG_TASK_PAUSED,
+        (task->flags & TASK_CANCELLABLE) ? LK_DIALOG_RESUME_CANCEL : LK_DIALOG_RESUME);
+    return !((task->flags & TASK_CANCELLABLE) && result == 1);
+}
+
+task_result_t task_run(const task_t *task) {
+    task_result_t result = TASK_FINISHED;
+    uint16_t slice_ticks = vbl_ticks;
+
+    if (task->flags & TASK_UNLOCK_DRIVER) driver_unlock();
+    while (task->step(task->userdata)) {
+        if (slice_ticks == vbl_ticks) continue;
+
+        input_update();
+        if (input_pressed & KEY_B) {
+            if (!task_pause(task)) {
+                result = TASK_CANCELLED;
+                break;
+            }
+        }
+        slice_ticks = vbl_ticks;
+    }
+    if (task->flags & TASK_UNLOCK_DRIVER) driver_lock();
+
+    return result;
+}
@@ -0,0 +1,45 @@
+#pragma once
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Long-running jobs are split into steps (typically one flash chunk or
+// bank). Between steps - that is, never while a driver call is in flight -
+// the runner yields to the UI once per VBlank tick: pressing B pauses the
+// job and, if allowed, offers to cancel it.
+
+#define TASK_CANCELLABLE 0x01
+// The driver is unlocked for the duration of the job.
+#define TASK_UNLOCK_DRIVER 0x02
+
+typedef enum {
+	TASK_FINISHED = 0,
+	TASK_CANCELLED
+} task_result_t;
+
+// Performs one step of the job; returns false once there is nothing left to do.
+typedef bool (*task_step_func_t)(void *userdata);
+
+typedef struct {
+	task_step_func_t step;
+	void *userdata;
+	uint8_t flags;
+} task_t;
+
+task_result_t task_run(const task_t *task);
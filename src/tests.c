@@ -17,10 +17,12 @@
 #include <string.h>
 #include "driver.h"
 #include "input.h"
+#include "progress.h"
 #include "tests.h"
 #include "settings.h"
 #include "sram.h"
 #include "ui.h"
+#include "util.h"
 #include "ws/hardware.h"
 
 #ifdef USE_SLOT_SYSTEM
@@ -33,7 +35,7 @@ static void test_save_read_write_error_emit(uint8_t x, uint8_t y, uint16_t bank,
     outportb(IO_BANK_RAM, 0);
     sram_ui_quiet = false;
 
-    ui_clear_work_indicator();
+    progress_finish();
     ui_update_indicators();
 
     ui_bg_printf(x, y, 0, msg_save_read_write_error1, bank, offset, expected);
@@ -59,8 +61,9 @@ bool test_save_read_write(uint8_t x, uint8_t y, uint8_t slot) {
     sram_erase(slot, SRAM_OFFSET_SIZE_DEFAULT);
 
     // Write test pattern to SRAM
+    progress_start(PROGRESS_NO_BAR, 0x80000);
     for (int i = 0; i < 8; i++) {
-        ui_step_work_indicator();
+        progress_add(0x10000);
         outportb(IO_BANK_RAM, i);
         volatile uint8_t __far *ptr = MK_FP(0x1000, 0x0000);
         for (int j = 0; j < 256; j++) {
@@ -71,8 +74,9 @@ bool test_save_read_write(uint8_t x, uint8_t y, uint8_t slot) {
     }
 
     // Compare SRAM
+    progress_start(PROGRESS_NO_BAR, 0x80000);
     for (int i = 0; i < 8; i++) {
-        ui_step_work_indicator();
+        progress_add(0x10000);
         outportb(IO_BANK_RAM, i);
         uint16_t ofs = 0;
         for (int j = 0; j < 256; j++) {
@@ -91,8 +95,9 @@ bool test_save_read_write(uint8_t x, uint8_t y, uint8_t slot) {
     ui_bg_putc(x + 2, y, '.', 0);
 
     // Compare SRAM
+    progress_start(PROGRESS_NO_BAR, 0x80000);
     for (int i = 0; i < 8; i++) {
-        ui_step_work_indicator();
+        progress_add(0x10000);
         outportb(IO_BANK_RAM, i);
         uint16_t ofs = 0;
         for (int j = 0; j < 256; j++) {
@@ -105,8 +110,9 @@ bool test_save_read_write(uint8_t x, uint8_t y, uint8_t slot) {
     ui_bg_putc(x + 3, y, '.', 0);
 
     // Write test pattern to SRAM
+    progress_start(PROGRESS_NO_BAR, 0x80000);
     for (int i = 0; i < 8; i++) {
-        ui_step_work_indicator();
+        progress_add(0x10000);
         outportb(IO_BANK_RAM, i);
         volatile uint8_t __far *ptr = MK_FP(0x1000, 0x0000);
         for (int j = 0; j < 256; j++) {
@@ -117,8 +123,9 @@ bool test_save_read_write(uint8_t x, uint8_t y, uint8_t slot) {
     }
 
     // Compare SRAM
+    progress_start(PROGRESS_NO_BAR, 0x80000);
     for (int i = 0; i < 8; i++) {
-        ui_step_work_indicator();
+        progress_add(0x10000);
         outportb(IO_BANK_RAM, i);
         uint16_t ofs = 0;
         for (int j = 0; j < 256; j++) {
@@ -137,8 +144,9 @@ bool test_save_read_write(uint8_t x, uint8_t y, uint8_t slot) {
     ui_bg_putc(x + 6, y, '.', 0);
 
     // Compare SRAM
+    progress_start(PROGRESS_NO_BAR, 0x80000);
     for (int i = 0; i < 8; i++) {
-        ui_step_work_indicator();
+        progress_add(0x10000);
         outportb(IO_BANK_RAM, i);
         uint16_t ofs = 0;
         for (int j = 0; j < 256; j++) {
@@ -157,9 +165,306 @@ bool test_save_read_write(uint8_t x, uint8_t y, uint8_t slot) {
     outportb(IO_BANK_RAM, 0);
     sram_ui_quiet = false;
 
-    ui_clear_work_indicator();
+    progress_finish();
     ui_update_indicators();
 
     return true;
 }
+// SRAM chip diagnostic. Unlike test_save_read_write(), this only tests the
+// SRAM chip itself; its contents are lost.
+
+#define TEST_SRAM_BANKS 8
+#define TEST_SRAM_ADDRESS_LINES 19
+#define TEST_SRAM_PATTERN 0xAA
+#define TEST_SRAM_ANTIPATTERN 0x55
+#define TEST_SRAM_NO_LINE 0xFF
+
+#define TEST_SRAM_MARCH_READ1  0x01
+#define TEST_SRAM_MARCH_WRITE1 0x02
+#define TEST_SRAM_MARCH_DOWN   0x04
+
+uint16_t test_sram_march_step(uint16_t expected, uint16_t value, bool down);
+
+// March C-, after the initial up(w0) fill.
+static const uint8_t __far test_sram_march_elements[] = {
+    TEST_SRAM_MARCH_WRITE1,
+    TEST_SRAM_MARCH_READ1,
+    TEST_SRAM_MARCH_DOWN | TEST_SRAM_MARCH_WRITE1,
+    TEST_SRAM_MARCH_DOWN | TEST_SRAM_MARCH_READ1,
+    0
+};
+
+typedef struct {
+    uint8_t bank;
+    uint16_t offset;
+    uint16_t bits;
+    uint8_t line;
+} test_sram_error_t;
+
+static uint8_t test_sram_peek(uint32_t addr) {
+    outportb(IO_BANK_RAM, addr >> 16);
+    return *((volatile uint8_t __far*) MK_FP(0x1000, (uint16_t) addr));
+}
+
+static void test_sram_poke(uint32_t addr, uint8_t value) {
+    outportb(IO_BANK_RAM, addr >> 16);
+    *((volatile uint8_t __far*) MK_FP(0x1000, (uint16_t) addr)) = value;
+}
+
+static bool test_sram_check(test_sram_error_t *error, uint32_t addr, uint8_t expected, uint8_t line) {
+    uint8_t value = test_sram_peek(addr);
+    if (value == expected) return true;
+    error->bank = addr >> 16;
+    error->offset = addr;
+    error->bits = value ^ expected;
+    error->line = line;
+    return false;
+}
+
+static bool test_sram_data_lines(test_sram_error_t *error) {
+    for (uint8_t i = 0; i < 8; i++) {
+        test_sram_poke(0, 1 << i);
+        if (!test_sram_check(error, 0, 1 << i, TEST_SRAM_NO_LINE)) return false;
+    }
+    return true;
+}
+
+// Bank select lines are treated as address lines 16 and up. Each line is
+// tested by writing to the address with only that line set, and checking
+// that the write doesn't show up at any of the other addresses.
+static bool test_sram_address_lines(test_sram_error_t *error) {
+    for (uint8_t i = 0; i < TEST_SRAM_ADDRESS_LINES; i++) {
+        test_sram_poke(1UL << i, TEST_SRAM_PATTERN);
+    }
+
+    // stuck high
+    test_sram_poke(0, TEST_SRAM_ANTIPATTERN);
+    for (uint8_t i = 0; i < TEST_SRAM_ADDRESS_LINES; i++) {
+        if (!test_sram_check(error, 1UL << i, TEST_SRAM_PATTERN, i)) return false;
+    }
+    test_sram_poke(0, TEST_SRAM_PATTERN);
+
+    // stuck low, shorted to another line
+    for (uint8_t i = 0; i < TEST_SRAM_ADDRESS_LINES; i++) {
+        test_sram_poke(1UL << i, TEST_SRAM_ANTIPATTERN);
+        if (!test_sram_check(error, 0, TEST_SRAM_PATTERN, i)) return false;
+        for (uint8_t j = 0; j < TEST_SRAM_ADDRESS_LINES; j++) {
+            if (i != j && !test_sram_check(error, 1UL << j, TEST_SRAM_PATTERN, i)) return false;
+        }
+        test_sram_poke(1UL << i, TEST_SRAM_PATTERN);
+    }
+    return true;
+}
+
+// Runs across all banks, so that bank select faults show up as coupling
+// between cells.
+static bool test_sram_march(test_sram_error_t *error) {
+    for (uint8_t i = 0; i < TEST_SRAM_BANKS; i++) {
+        outportb(IO_BANK_RAM, i);
+        memset(MK_FP(0x1000, 0x0000), 0x00, 0x8000);
+        memset(MK_FP(0x1000, 0x8000), 0x00, 0x8000);
+    }
+
+    for (uint8_t i = 0; i < sizeof(test_sram_march_elements); i++) {
+        uint8_t element = test_sram_march_elements[i];
+        bool down = element & TEST_SRAM_MARCH_DOWN;
+        uint16_t expected = (element & TEST_SRAM_MARCH_READ1) ? 0xFFFF : 0x0000;
+        uint16_t value = (element & TEST_SRAM_MARCH_WRITE1) ? 0xFFFF : 0x0000;
+
+        for (uint8_t j = 0; j < TEST_SRAM_BANKS; j++) {
+            uint8_t bank = down ? (TEST_SRAM_BANKS - 1 - j) : j;
+            outportb(IO_BANK_RAM, bank);
+            uint16_t offset = test_sram_march_step(expected, value, down);
+            if (offset != 0xFFFF) {
+                error->bank = bank;
+                error->offset = offset;
+                error->bits = *((volatile uint16_t __far*) MK_FP(0x1000, offset)) ^ expected;
+                error->line = TEST_SRAM_NO_LINE;
+                return false;
+            }
+            ui_step_work_indicator();
+        }
+    }
+    return true;
+}
+
+static uint16_t __far test_sram_step_lks[] = {
+    LK_UI_SRAM_TEST_DATA_LINES,
+    LK_UI_SRAM_TEST_ADDRESS_LINES,
+    LK_UI_SRAM_TEST_MARCH
+};
+
+bool test_sram(uint8_t y) {
+    test_sram_error_t error;
+    uint8_t prev_bank_ram = inportb(IO_BANK_RAM);
+    bool result = true;
+
+    for (uint8_t i = 0; i < 3; i++) {
+        ui_puts(false, 2, y + i, 0, lang_keys[test_sram_step_lks[i]]);
+    }
+    for (uint8_t i = 0; i < 3 && result; i++) {
+        switch (i) {
+        case 0: result = test_sram_data_lines(&error); break;
+        case 1: result = test_sram_address_lines(&error); break;
+        case 2: result = test_sram_march(&error); break;
+        }
+        ui_bg_putc(24, y + i, result ? UI_GLYPH_CHECK : UI_GLYPH_CROSS, 0);
+    }
+    ui_clear_work_indicator();
+
+    if (!result) {
+        ui_bg_printf_centered(y + 4, 0, lang_keys[LK_UI_SRAM_TEST_ERROR],
+            error.bank, error.offset, error.bits);
+        if (error.line != TEST_SRAM_NO_LINE) {
+            ui_bg_printf_centered(y + 5, 0, lang_keys[LK_UI_SRAM_TEST_ERROR_LINE], error.line);
+        }
+    }
+
+    outportb(IO_BANK_RAM, prev_bank_ram);
+    return result;
+}
+
+// Flash sector health. Only sectors of the launcher slot's save area which
+// are erased already are tested, as they are erased again afterwards.
+
+#define TEST_FLASH_PROGRAM_SIZE 0x1000
+#define TEST_FLASH_HISTOGRAM_BUCKETS 6
+#define TEST_FLASH_HISTOGRAM_STEP_MS 250
+#define TEST_FLASH_HISTOGRAM_WIDTH 14
+
+typedef struct {
+    uint8_t tested;
+    uint8_t slowest_bank;
+    uint16_t erase_ms_min, erase_ms_max;
+    uint32_t erase_ms_total;
+    uint32_t program_lines_total;
+    uint8_t histogram[TEST_FLASH_HISTOGRAM_BUCKETS];
+} test_flash_health_t;
+
+// The save block a sector belongs to, or 0xFF.
+static uint8_t test_flash_bank_block(uint8_t bank) {
+    if (!settings_location_legacy && bank >= SETTINGS_BANK) {
+        if (bank < SETTINGS_BANK + 2) return 0xFF;
+        bank -= 2;
+    }
+    bank = (bank - 0x80) / SRAM_BLOCK_BANKS;
+    return bank < SRAM_SLOTS ? bank : 0xFF;
+}
+
+static void test_flash_health_sector(test_flash_health_t *health, uint8_t *buffer, uint8_t bank) {
+    uint8_t slot = driver_get_launch_slot();
+
+    uint16_t start = line_timer_get();
+    for (uint16_t i = 0; i < TEST_FLASH_PROGRAM_SIZE; i += 256) {
+        driver_write_slot(buffer, slot, bank, i, 256);
+    }
+    uint16_t program_lines = line_timer_get() - start;
+
+    start = line_timer_get();
+    driver_erase_bank(0, slot, bank);
+    uint16_t erase_ms = (uint16_t) (line_timer_get() - start) / (LINE_TIMER_HZ / 1000);
+
+    if (health->tested == 0 || erase_ms < health->erase_ms_min) health->erase_ms_min = erase_ms;
+    if (health->tested == 0 || erase_ms > health->erase_ms_max) {
+        health->erase_ms_max = erase_ms;
+        health->slowest_bank = bank;
+    }
+    health->erase_ms_total += erase_ms;
+    health->program_lines_total += program_lines;
+    uint16_t bucket = erase_ms / TEST_FLASH_HISTOGRAM_STEP_MS;
+    health->histogram[bucket < TEST_FLASH_HISTOGRAM_BUCKETS ? bucket : (TEST_FLASH_HISTOGRAM_BUCKETS - 1)]++;
+    health->tested++;
+}
+
+static bool test_flash_health_run(const uint32_t *table, void *userdata) {
+    test_flash_health_t *health = (test_flash_health_t*) userdata;
+    uint8_t buffer[256];
+    for (uint16_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = i;
+    }
+
+    driver_unlock();
+    for (uint8_t i = 0; i < ERASE_COUNT_SECTORS; i++) {
+        uint8_t bank = ERASE_COUNT_BANK_FIRST + (i << 1);
+        if (driver_sector_erased(table, driver_get_launch_slot(), bank)) {
+            test_flash_health_sector(health, buffer, bank);
+        }
+        progress_add(0x20000);
+    }
+    driver_lock();
+    return true;
+}
+
+static void test_flash_health_draw_histogram(test_flash_health_t *health, uint8_t y) {
+    uint8_t max = 1;
+    for (uint8_t i = 0; i < TEST_FLASH_HISTOGRAM_BUCKETS; i++) {
+        if (health->histogram[i] > max) max = health->histogram[i];
+    }
+    for (uint8_t i = 0; i < TEST_FLASH_HISTOGRAM_BUCKETS; i++) {
+        uint16_t from = i * TEST_FLASH_HISTOGRAM_STEP_MS;
+        if (i == TEST_FLASH_HISTOGRAM_BUCKETS - 1) {
+            ui_bg_printf(1, y + i, 0, ">%u", from);
+        } else {
+            ui_bg_printf(1, y + i, 0, "%u-%u", from, from + TEST_FLASH_HISTOGRAM_STEP_MS - 1);
+        }
+        uint8_t width = ((uint16_t) health->histogram[i] * TEST_FLASH_HISTOGRAM_WIDTH + max - 1) / max;
+        for (uint8_t j = 0; j < width; j++) {
+            ui_bg_putc(11 + j, y + i, '#', 0);
+        }
+        ui_bg_printf_right(26, y + i, 0, "%u", health->histogram[i]);
+    }
+}
+
+void test_flash_health(void) {
+    test_flash_health_t health;
+    memset(&health, 0, sizeof(health));
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 1, 0, lang_keys[LK_UI_FLASH_HEALTH_LINE1]);
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_PLEASE_WAIT]);
+
+    uint8_t prev_timer_ctrl = line_timer_start();
+    progress_start(13, (uint32_t) ERASE_COUNT_SECTORS << 17);
+    crc32_with_table(test_flash_health_run, &health);
+    progress_finish();
+    line_timer_stop(prev_timer_ctrl);
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 1, 0, lang_keys[LK_UI_FLASH_HEALTH_LINE1]);
+    ui_bg_printf(1, 3, 0, lang_keys[LK_UI_FLASH_HEALTH_TESTED], health.tested);
+    if (health.tested > 0) {
+        ui_bg_printf(1, 4, 0, lang_keys[LK_UI_FLASH_HEALTH_ERASE],
+            health.erase_ms_min, (uint16_t) (health.erase_ms_total / health.tested), health.erase_ms_max);
+        ui_bg_printf(1, 5, 0, lang_keys[LK_UI_FLASH_HEALTH_PROGRAM],
+            (uint16_t) (((uint32_t) TEST_FLASH_PROGRAM_SIZE * health.tested * (LINE_TIMER_HZ / 1000)) / health.program_lines_total));
+        uint8_t block = test_flash_bank_block(health.slowest_bank);
+        ui_bg_printf(1, 6, 0, lang_keys[LK_UI_FLASH_HEALTH_SLOWEST],
+            health.slowest_bank, block < SRAM_SLOTS ? (block + 'A') : '-');
+        test_flash_health_draw_histogram(&health, 8);
+    }
+    ui_puts_centered(false, 16, 0, lang_keys[LK_UI_PRESS_ANY_KEY]);
+    input_wait_any_key();
+
+    // erase counts, per save block
+    uint32_t block_counts[SRAM_SLOTS];
+    uint16_t settings_count = 0;
+    memset(block_counts, 0, sizeof(block_counts));
+    for (uint8_t i = 0; i < ERASE_COUNT_SECTORS; i++) {
+        uint8_t block = test_flash_bank_block(ERASE_COUNT_BANK_FIRST + (i << 1));
+        if (block < SRAM_SLOTS) {
+            block_counts[block] += settings_local.erase_counts[i];
+        } else {
+            settings_count += settings_local.erase_counts[i];
+        }
+    }
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 1, 0, lang_keys[LK_UI_FLASH_HEALTH_ERASE_COUNTS]);
+    for (uint8_t i = 0; i < SRAM_SLOTS; i++) {
+        ui_bg_printf(13 * (i / 8) + 1, 3 + (i % 8), 0, "%c: %lu", 'A' + i, block_counts[i]);
+    }
+    ui_bg_printf(14, 10, 0, lang_keys[LK_UI_FLASH_HEALTH_SETTINGS], settings_count);
+    ui_puts_centered(false, 16, 0, lang_keys[LK_UI_PRESS_ANY_KEY]);
+    input_wait_any_key();
+}
 #endif
@@ -28,3 +28,9 @@
  * @param slot Flash slot to test
  */
 bool test_save_read_write(uint8_t x, uint8_t y, uint8_t slot);
+// Tests the SRAM chip's data lines, address and bank select lines, and
+// cells, destroying its contents. Results are drawn from line y on.
+bool test_sram(uint8_t y);
+// Times programming and erasing the launcher slot's empty save sectors, then
+// shows the erase counts kept in the settings.
+void test_flash_health(void);
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <wonderful.h>
+#include "config.h"
+
+	.arch	i186
+	.code16
+	.intel_syntax noprefix
+
+#ifdef USE_SLOT_SYSTEM
+	// uint16_t test_sram_march_step(uint16_t expected, uint16_t value, bool down)
+	// One March element over the SRAM bank at 0x1000: every word is compared
+	// with expected, then replaced with value, going up or down.
+	// Returns the offset of the first mismatching word, or 0xFFFF.
+	.global test_sram_march_step
+	.align 2
+test_sram_march_step:
+	push	di
+	push	es
+
+	mov bx, dx // bx = value
+	mov dx, 0x1000
+	mov es, dx
+	test cl, cl
+	mov cx, 0x2000 // 4 words per iteration
+	jnz test_sram_march_step_down
+
+	xor di, di
+	cld
+	.align 2, 0x90
+test_sram_march_step_up_loop:
+.rept 4
+	scasw
+	jne test_sram_march_step_up_error
+	mov es:[di - 2], bx
+.endr
+	dec cx
+	jnz test_sram_march_step_up_loop
+	jmp test_sram_march_step_ok
+
+test_sram_march_step_up_error:
+	lea ax, [di - 2]
+	jmp test_sram_march_step_done
+
+test_sram_march_step_down:
+	mov di, 0xFFFE
+	std
+	.align 2, 0x90
+test_sram_march_step_down_loop:
+.rept 4
+	scasw
+	jne test_sram_march_step_down_error
+	mov es:[di + 2], bx
+.endr
+	dec cx
+	jnz test_sram_march_step_down_loop
+
+test_sram_march_step_ok:
+	mov ax, 0xFFFF
+	jmp test_sram_march_step_done
+
+test_sram_march_step_down_error:
+	lea ax, [di + 2]
+
+test_sram_march_step_done:
+	cld
+	pop	es
+	pop	di
+	IA16_RET
+#endif
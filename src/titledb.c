@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ws.h>
+#include "config.h"
+#include "driver.h"
+#include "lang.h"
+#include "settings.h"
+#include "task.h"
+#include "titledb.h"
+#include "titledb_data.h"
+#include "ui.h"
+#include "util.h"
+
+#ifdef USE_SLOT_SYSTEM
+
+#define TITLE_CACHE_KEY(checksum) ((uint8_t) ((checksum) ^ ((checksum) >> 8)))
+
+uint16_t titledb_find(uint32_t crc) {
+    uint16_t lo = 0;
+    uint16_t hi = TITLEDB_COUNT;
+
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) >> 1;
+        uint32_t mid_crc = titledb_crcs[mid];
+        if (mid_crc == crc) {
+            return mid;
+        } else if (mid_crc < crc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return TITLEDB_NOT_FOUND;
+}
+
+void titledb_get_name(uint16_t idx, char *buf, uint16_t buf_len) {
+    const char __far* src = titledb_names + titledb_name_offsets[idx];
+    char *buf_end = buf + buf_len - 1;
+
+    while (*src && buf < buf_end) {
+        uint8_t c = *(src++);
+        if (c >= TITLEDB_TOKEN_FIRST) {
+            const char __far* token = titledb_tokens + titledb_token_offsets[c - TITLEDB_TOKEN_FIRST];
+            while (*token && buf < buf_end) {
+                *(buf++) = *(token++);
+            }
+        } else {
+            *(buf++) = c;
+        }
+    }
+    *buf = 0;
+}
+
+static void titledb_check_cache(void) {
+    if (settings_local.title_cache_db != TITLEDB_HASH) {
+        for (uint8_t i = 0; i < TITLE_CACHE_ENTRIES; i++) {
+            settings_local.title_cache[i].title = TITLEDB_UNCACHED;
+        }
+        settings_local.title_cache_db = TITLEDB_HASH;
+        settings_mark_changed();
+    }
+}
+
+typedef struct {
+    const uint32_t *crc_table;
+    uint32_t crc;
+    uint8_t slot;
+    uint8_t bank, bank_last;
+    bool failed;
+} titledb_identify_job_t;
+
+static bool titledb_identify_step(void *userdata) {
+    titledb_identify_job_t *job = (titledb_identify_job_t*) userdata;
+
+    ui_step_work_indicator();
+    if (!driver_crc32_slot(&job->crc, job->slot, job->bank, job->crc_table, 0)) {
+        job->failed = true;
+        return false;
+    }
+    if (job->bank == job->bank_last) return false;
+    job->bank++;
+    return true;
+}
+
+static bool titledb_identify_run(const uint32_t *table, void *userdata) {
+    titledb_identify_job_t *job = (titledb_identify_job_t*) userdata;
+    task_t task = {
+        .step = titledb_identify_step,
+        .userdata = job,
+        .flags = TASK_CANCELLABLE
+    };
+
+    job->crc_table = table;
+    return task_run(&task) != TASK_CANCELLED;
+}
+
+static uint16_t titledb_identify_slot(uint8_t slot, uint8_t bank_last, uint16_t size_banks) {
+    titledb_identify_job_t job = {
+        .crc = CRC32_INIT,
+        .slot = slot,
+        .bank = bank_last + 1 - size_banks,
+        .bank_last = bank_last,
+        .failed = false
+    };
+
+    if (!crc32_with_table(titledb_identify_run, &job)) {
+        return TITLEDB_UNCACHED;
+    }
+
+    return job.failed ? TITLEDB_NOT_FOUND : titledb_find(~job.crc);
+}
+
+uint16_t titledb_identify(uint8_t entry_id, uint8_t slot, uint8_t bank_last, uint16_t size_banks, uint16_t checksum) {
+    if (TITLEDB_COUNT == 0) {
+        return TITLEDB_NOT_FOUND;
+    }
+
+    titledb_check_cache();
+    title_cache_entry_t *entry = &settings_local.title_cache[entry_id];
+    if (entry->title != TITLEDB_UNCACHED && entry->key == TITLE_CACHE_KEY(checksum)) {
+        return entry->title;
+    }
+
+    ui_puts_centered(false, 8, 0, lang_keys[LK_UI_BROWSE_IDENTIFYING]);
+    uint16_t title = titledb_identify_slot(slot, bank_last, size_banks);
+    if (title != TITLEDB_UNCACHED) {
+        entry->key = TITLE_CACHE_KEY(checksum);
+        entry->title = title;
+        settings_mark_changed();
+    }
+    return title;
+}
+
+bool titledb_get_cached_name(uint8_t entry_id, uint16_t checksum, char *buf, uint16_t buf_len) {
+    if (TITLEDB_COUNT == 0 || settings_local.title_cache_db != TITLEDB_HASH) {
+        return false;
+    }
+
+    title_cache_entry_t *entry = &settings_local.title_cache[entry_id];
+    if (entry->title >= TITLEDB_COUNT || entry->key != TITLE_CACHE_KEY(checksum)) {
+        return false;
+    }
+
+    titledb_get_name(entry->title, buf, buf_len);
+    return true;
+}
+
+void titledb_invalidate(uint8_t entry_id) {
+    if (settings_local.title_cache[entry_id].title != TITLEDB_UNCACHED) {
+        settings_local.title_cache[entry_id].title = TITLEDB_UNCACHED;
+        settings_mark_changed();
+    }
+}
+
+void titledb_invalidate_bank(uint8_t slot, uint8_t bank) {
+    transfer_checkpoint_t *checkpoint = &settings_local.transfer;
+
+    // entry (slot | (i << 4)) is the ROM ending at bank 0xFF - (i << 4)
+    for (uint8_t i = 0; i < (TITLE_CACHE_ENTRIES / GAME_SLOTS); i++) {
+        if ((uint8_t) (0xFF - (i << 4)) < bank) break;
+        titledb_invalidate(slot | (i << 4));
+        if (checkpoint->type == TRANSFER_ROM && checkpoint->entry_id == (slot | (i << 4))) {
+            // the sectors committed so far may change
+            checkpoint->type = TRANSFER_NONE;
+            settings_mark_changed();
+        }
+    }
+}
+
+#endif
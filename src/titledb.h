@@ -0,0 +1,37 @@
+#pragma once
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TITLEDB_NOT_FOUND 0xFFFE
+#define TITLEDB_UNCACHED 0xFFFF
+
+uint16_t titledb_find(uint32_t crc);
+void titledb_get_name(uint16_t idx, char *buf, uint16_t buf_len);
+
+// Computes the CRC32 of a ROM ending at bank_last and caches the result
+// for entry_id, keyed by the ROM header's checksum. Driver must be unlocked.
+// Returns TITLEDB_UNCACHED if cancelled by the user.
+uint16_t titledb_identify(uint8_t entry_id, uint8_t slot, uint8_t bank_last, uint16_t size_banks, uint16_t checksum);
+bool titledb_get_cached_name(uint8_t entry_id, uint16_t checksum, char *buf, uint16_t buf_len);
+void titledb_invalidate(uint8_t entry_id);
+// Invalidates the entries of slot whose ROM may include bank, i.e. those
+// ending at or after it, along with an interrupted ROM transfer into one
+// of them; to be called before writing to the slot.
+void titledb_invalidate_bank(uint8_t slot, uint8_t bank);
@@ -214,7 +214,7 @@ inline void ui_fg_putc(uint8_t x, uint8_t y, uint16_t chr, uint8_t color) {
 
 void ui_fill_line(uint8_t y, uint8_t color) {
     uint16_t prefix = SCR_ENTRY_PALETTE(color);
-    uint16_t *screen = SCREEN1 + (y << 5);
+    uint16_t *screen = SCREEN1 + ((y & 31) << 5);
     for (uint8_t i = 0; i < 32; i++) {
         *(screen++) = prefix;
     }
@@ -400,22 +400,64 @@ void ui_clear_work_indicator(void) {
 
 // Menu system
 
+// Formatted lines are cached, as moving the cursor redraws the same
+// lines repeatedly. The cache is cleared whenever a menu is (re)selected.
+#define UI_MENU_LINE_CACHE_SIZE 4
+
+typedef struct {
+    uint8_t pos;
+    char buf[31];
+    char buf_right[21];
+} ui_menu_line_t;
+
+static ui_menu_line_t ui_menu_line_cache[UI_MENU_LINE_CACHE_SIZE];
+static uint8_t ui_menu_line_cache_next;
+
+static void ui_menu_line_cache_clear(void) {
+    for (uint8_t i = 0; i < UI_MENU_LINE_CACHE_SIZE; i++) {
+        ui_menu_line_cache[i].pos = MENU_ENTRY_END;
+    }
+}
+
+static ui_menu_line_t *ui_menu_build_line(ui_menu_state_t *menu, uint8_t pos) {
+    ui_menu_line_t *line;
+    for (uint8_t i = 0; i < UI_MENU_LINE_CACHE_SIZE; i++) {
+        line = &ui_menu_line_cache[i];
+        if (line->pos == pos) return line;
+    }
+
+    line = &ui_menu_line_cache[ui_menu_line_cache_next];
+    ui_menu_line_cache_next = (ui_menu_line_cache_next + 1) & (UI_MENU_LINE_CACHE_SIZE - 1);
+
+    line->pos = pos;
+    line->buf[0] = 0; line->buf_right[0] = 0;
+    menu->build_line_func(menu->list[pos], menu->build_line_data, line->buf, sizeof(line->buf) - 1, line->buf_right, sizeof(line->buf_right) - 1);
+    line->buf[sizeof(line->buf) - 1] = 0;
+    line->buf_right[sizeof(line->buf_right) - 1] = 0;
+    return line;
+}
+
 static void ui_menu_draw_line(ui_menu_state_t *menu, uint8_t pos, uint8_t color) {
     if (menu->list[pos] == MENU_ENTRY_DIVIDER) {
-        ws_screen_fill_tiles(SCREEN1, 196, 0, pos, 32, 1);
+        ws_screen_fill_tiles(SCREEN1, 196, 0, pos & 31, 32, 1);
         return;
     }
 
-    char buf[31];
-    char buf_right[31];
-    buf[0] = 0; buf_right[0] = 0;
-
-    menu->build_line_func(menu->list[pos], menu->build_line_data, buf, 30, buf_right, 30);
-    if (buf[0] != 0) {
-        ui_puts(false, 0, pos, color, buf);
+    ui_menu_line_t *line = ui_menu_build_line(menu, pos);
+    if (line->buf[0] != 0) {
+        ui_puts(false, 0, pos, color, line->buf);
     }
-    if (buf_right[0] != 0) {
-        ui_puts(false, MAIN_SCREEN_WIDTH - strlen(buf_right), pos, color, buf_right);
+    if (line->buf_right[0] != 0) {
+        ui_puts(false, MAIN_SCREEN_WIDTH - strlen(line->buf_right), pos, color, line->buf_right);
+    }
+}
+
+// Clears and draws rows which have just been scrolled into view.
+static void ui_menu_draw_rows(ui_menu_state_t *menu, uint8_t first, uint8_t count) {
+    for (uint8_t i = first; i < first + count; i++) {
+        uint8_t color = (i == menu->pos) ? 1 : 0;
+        ui_fill_line(i, color);
+        ui_menu_draw_line(menu, i, color);
     }
 }
 
@@ -463,12 +505,18 @@ static void ui_menu_move(ui_menu_state_t *menu, int8_t delta) {
         ui_scroll(scroll_delta);
         menu->y = new_y;
 
-        // TODO: optimize
-        ui_menu_redraw(menu);
+        if (scroll_delta > 0) {
+            if (scroll_delta > 16) scroll_delta = 16;
+            ui_menu_draw_rows(menu, menu->y + 16 - scroll_delta, scroll_delta);
+        } else {
+            if (scroll_delta < -16) scroll_delta = -16;
+            ui_menu_draw_rows(menu, menu->y, -scroll_delta);
+        }
     }
 }
 
 void ui_menu_init(ui_menu_state_t *menu) {
+    ui_menu_line_cache_clear();
     menu->height = u8_arraylist_len(menu->list);
     menu->pos = 0;
     menu->y = 0;
@@ -478,6 +526,7 @@ void ui_menu_init(ui_menu_state_t *menu) {
 
 uint16_t ui_menu_select(ui_menu_state_t *menu) {
     ui_clear_work_indicator();
+    ui_menu_line_cache_clear();
     ui_menu_redraw(menu);
 
     uint16_t result = MENU_ENTRY_END;
@@ -638,7 +687,8 @@ void ui_pbar_init(ui_pbar_state_t *state) {
 void ui_pbar_draw(ui_pbar_state_t *state) {
     uint16_t step_count = state->width * 8;
     uint16_t step_current = (((uint32_t) state->step) * step_count) / state->step_max;
-    if (state->step_last != step_current) {
+    if (step_current > state->step_last) {
+        state->step_last = step_current;
         uint8_t i = 0;
         uint8_t x = state->x;
         for (i = 8; i <= step_current; i += 8) {
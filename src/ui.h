@@ -167,7 +167,12 @@ bool ui_osk_run(uint16_t flags, char *buf, uint8_t buf_width); // ui_osk.c
 // Tab implementations
 
 void ui_about(void); // ui_about.c
+void ui_benchmark(void); // ui_benchmark.c
 void ui_browse(void); // ui_browse.c
+// Switches to the game's save block and locks IEEPROM, as the game needs
+// before it is launched; with select_save, the user picks one of several
+// save blocks. Returns false if the user backed out.
+bool ui_browse_prepare_launch(uint8_t entry_id, bool select_save); // ui_browse.c
 void ui_settings(void); // ui_settings.c
 void ui_tools(void); // ui_tools.c
 
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <ws.h>
+#include "driver.h"
 #include "input.h"
 #include "lang.h"
 #include "ui.h"
@@ -42,12 +43,61 @@ static inline int16_t cos(int16_t v) {
 
 static const char cartfriend_name[] = "CartFriend " VERSION;
 
-void ui_about(void) {
+// slot switches and AVR wakes/sleeps each wait about this long
+#define DRIVER_STATS_WAIT_MS 12
+
+static void ui_about_driver_stats_draw(void) {
+    uint8_t y = 4;
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_DRIVER_STATS]);
+
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_SLOT_SWITCHES]);
+    ui_bg_printf_right(26, y++, 0, "%u", driver_stats.slot_switches);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_AVR_WAKES]);
+    ui_bg_printf_right(26, y++, 0, "%u", driver_stats.avr_wakes);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_AVR_SLEEPS]);
+    ui_bg_printf_right(26, y++, 0, "%u", driver_stats.avr_sleeps);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_WAIT_TIME]);
+    ui_bg_printf_right(26, y++, 0, lang_keys[LK_UI_DRIVER_STATS_WAIT_MS],
+        ((uint32_t) driver_stats.slot_switches + driver_stats.avr_wakes + driver_stats.avr_sleeps) * DRIVER_STATS_WAIT_MS);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_BYTES_READ]);
+    ui_bg_printf_right(26, y++, 0, "%lu", driver_stats.bytes_read);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_BYTES_PROGRAMMED]);
+    ui_bg_printf_right(26, y++, 0, "%lu", driver_stats.bytes_programmed);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_BUFFERED_WRITES]);
+    ui_bg_printf_right(26, y++, 0, "%u", driver_stats.buffered_writes);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_BYTE_WRITES]);
+    ui_bg_printf_right(26, y++, 0, "%u", driver_stats.byte_writes);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_ERASES]);
+    ui_bg_printf_right(26, y++, 0, "%u", driver_stats.erases);
+    ui_puts(false, 1, y, 0, lang_keys[LK_UI_DRIVER_STATS_BUSY_POLLS]);
+    ui_bg_printf_right(26, y++, 0, "%lu", driver_stats.busy_polls);
+
+    ui_puts_centered(false, 16, 0, lang_keys[LK_UI_DRIVER_STATS_KEYS]);
+}
+
+// returns false if the tab was changed
+static bool ui_about_driver_stats(void) {
+    ui_about_driver_stats_draw();
+
+    while (ui_poll_events()) {
+        wait_for_vblank();
+        if (input_pressed & KEY_A) {
+            driver_stats_reset();
+            ui_about_driver_stats_draw();
+        }
+        if (input_pressed & KEY_B) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ui_about_draw(void) {
     ui_puts_centered(false, 2, 0, cartfriend_name);
 #ifdef TARGET_flash_masta
-    outportb(0xCE, 0xAA);
-    bool is_rev5 = inportb(0xCE) == 0xAA;
-    ui_puts_centered(false, 3, 0, lang_keys[is_rev5 ? LK_UI_FM_REV5 : LK_UI_FM_REV4]);
+    ui_puts_centered(false, 3, 0, lang_keys[driver_fm_is_rev5() ? LK_UI_FM_REV5 : LK_UI_FM_REV4]);
 #else
     ui_puts_centered(false, 3, 0, lang_keys[LK_UI_GENERIC]);
 #endif
@@ -60,6 +110,11 @@ void ui_about(void) {
         (int) fm_initial_slot[3]); */
     ui_puts_centered(false, 12, 0, lang_keys[LK_UI_ABOUT_URL_LINE1]);
     ui_puts_centered(false, 13, 0, lang_keys[LK_UI_ABOUT_URL_LINE2]);
+    ui_puts_centered(false, 15, 0, lang_keys[LK_UI_ABOUT_DRIVER_STATS_HINT]);
+}
+
+void ui_about(void) {
+    ui_about_draw();
 
     outportb(IO_SPR_BASE, SPR_BASE(SPRITE_TABLE));
     outportb(IO_SPR_FIRST, 128 >> 2);
@@ -79,6 +134,14 @@ void ui_about(void) {
     while (ui_poll_events()) {
         wait_for_vblank();
 
+        if (input_pressed & KEY_START) {
+            outportw(IO_DISPLAY_CTRL, inportw(IO_DISPLAY_CTRL) & (~DISPLAY_SPR_ENABLE));
+            if (!ui_about_driver_stats()) break;
+            ui_reset_main_screen();
+            ui_about_draw();
+            continue;
+        }
+
         if (input_held & KEY_UP) {
             rotY -= 9;
         }
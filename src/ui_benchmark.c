@@ -0,0 +1,301 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <wonderful.h>
+#include <ws.h>
+#include "config.h"
+#include "driver.h"
+#include "lang.h"
+#include "serial.h"
+#include "settings.h"
+#include "sram.h"
+#include "ui.h"
+#include "util.h"
+#include "ws/hardware.h"
+#include "xmodem.h"
+
+#ifdef USE_SLOT_SYSTEM
+
+extern volatile uint16_t vbl_ticks;
+
+#define BENCH_SKIPPED 0xFFFFFFFF
+
+#define BENCH_BUFFER_SIZE 1024
+#define BENCH_WRITE_SIZE 0x4000
+#define BENCH_SRAM_SIZE 0x4000
+#define BENCH_CRC16_SIZE 0x1000
+#define BENCH_SERIAL_SIZE 1024
+
+typedef enum {
+    BENCH_SLOT_SWITCH,
+    BENCH_SLOT_READ,
+    BENCH_SLOT_CRC32,
+    BENCH_WRITE_BUFFERED,
+    BENCH_WRITE_UNBUFFERED,
+    BENCH_ERASE_SECTOR,
+    BENCH_SRAM_FAST,
+    BENCH_SRAM_SLOW,
+    BENCH_CRC16,
+    BENCH_SERIAL_TX,
+    BENCH_COUNT
+} bench_id_t;
+
+typedef enum {
+    BENCH_UNIT_US,
+    BENCH_UNIT_MS,
+    BENCH_UNIT_KBPS,
+    BENCH_UNIT_BPS
+} bench_unit_t;
+
+typedef struct {
+    uint16_t lk;
+    uint8_t unit;
+    char name[17];
+} bench_test_t;
+
+static const bench_test_t __far bench_tests[BENCH_COUNT] = {
+    { LK_UI_BENCH_SLOT_SWITCH, BENCH_UNIT_US, "slot_switch" },
+    { LK_UI_BENCH_SLOT_READ, BENCH_UNIT_KBPS, "slot_read" },
+    { LK_UI_BENCH_SLOT_CRC32, BENCH_UNIT_KBPS, "slot_crc32" },
+    { LK_UI_BENCH_WRITE_BUFFERED, BENCH_UNIT_KBPS, "write_buffered" },
+    { LK_UI_BENCH_WRITE_UNBUFFERED, BENCH_UNIT_KBPS, "write_unbuffered" },
+    { LK_UI_BENCH_ERASE_SECTOR, BENCH_UNIT_MS, "erase_sector" },
+    { LK_UI_BENCH_SRAM_FAST, BENCH_UNIT_KBPS, "sram_read_fast" },
+    { LK_UI_BENCH_SRAM_SLOW, BENCH_UNIT_KBPS, "sram_read_slow" },
+    { LK_UI_BENCH_CRC16, BENCH_UNIT_KBPS, "crc16" },
+    { LK_UI_BENCH_SERIAL_TX, BENCH_UNIT_BPS, "serial_tx" }
+};
+
+static const char __far bench_units[][5] = {
+    "us", "ms", "KB/s", "B/s"
+};
+
+typedef struct {
+    uint16_t vbl;
+    uint16_t line;
+} bench_timer_t;
+
+static void bench_timer_start(bench_timer_t *timer) {
+    timer->vbl = vbl_ticks;
+    timer->line = line_timer_get();
+}
+
+// Returns the time elapsed since bench_timer_start(), in lines.
+static uint32_t bench_timer_end(bench_timer_t *timer) {
+    uint16_t lines = line_timer_get() - timer->line;
+    uint32_t vbl_lines = ((uint32_t) ((uint16_t) (vbl_ticks - timer->vbl))) * LINE_TIMER_LINES_PER_FRAME;
+    // The line counter wraps every ~5.4 seconds, while vbl_ticks stands
+    // still during driver calls; only trust the latter for long runs.
+    if (vbl_lines >= 0xF000) return vbl_lines;
+    return lines > 0 ? lines : 1;
+}
+
+static inline uint32_t bench_us(uint32_t lines, uint16_t count) {
+    return (lines * 250) / (3 * (uint32_t) count);
+}
+
+static inline uint32_t bench_kbps(uint32_t bytes, uint32_t lines) {
+    return (bytes * 375 / 32) / lines;
+}
+
+static inline uint32_t bench_bps(uint32_t bytes, uint32_t lines) {
+    return (bytes * LINE_TIMER_HZ) / lines;
+}
+
+typedef struct {
+    uint32_t *results;
+    uint8_t slot;
+} bench_crc32_job_t;
+
+static bool bench_slot_crc32(const uint32_t *table, void *userdata) {
+    bench_crc32_job_t *job = (bench_crc32_job_t*) userdata;
+    uint32_t crc = CRC32_INIT;
+    bench_timer_t timer;
+
+    bench_timer_start(&timer);
+    driver_crc32_slot(&crc, job->slot, 0xFF, table, 0);
+    job->results[BENCH_SLOT_CRC32] = bench_kbps(0x10000, bench_timer_end(&timer));
+
+    // Writes are only timed on a sector which is erased already, so that
+    // erasing it again afterwards loses nothing.
+    return driver_sector_erased(table, job->slot, 0x00);
+}
+
+static void bench_slot(uint32_t *results, uint8_t *buffer, uint8_t slot) {
+    bench_timer_t timer;
+
+    // Every call switches to the slot and back.
+    bench_timer_start(&timer);
+    for (uint8_t i = 0; i < 8; i++) {
+        driver_read_slot(buffer, slot, 0xFF, 0xFFF0, 2);
+    }
+    results[BENCH_SLOT_SWITCH] = bench_us(bench_timer_end(&timer), 16);
+
+    bench_timer_start(&timer);
+    for (uint8_t i = 0; i < 16; i++) {
+        driver_read_slot(buffer, slot, 0xFF, i * BENCH_BUFFER_SIZE, BENCH_BUFFER_SIZE);
+    }
+    results[BENCH_SLOT_READ] = bench_kbps(16 * BENCH_BUFFER_SIZE, bench_timer_end(&timer));
+
+    bench_crc32_job_t crc32_job = {
+        .results = results,
+        .slot = slot
+    };
+    if (!crc32_with_table(bench_slot_crc32, &crc32_job)) return;
+
+    uint8_t prev_flags1 = settings_local.flags1;
+    for (uint16_t i = 0; i < 256; i++) {
+        buffer[i] = i;
+    }
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        uint16_t offset = pass * BENCH_WRITE_SIZE;
+        if (pass == 0) {
+            settings_local.flags1 &= ~SETT_FLAGS1_DISABLE_BUFFERED_WRITES;
+        } else {
+            settings_local.flags1 |= SETT_FLAGS1_DISABLE_BUFFERED_WRITES;
+        }
+        bench_timer_start(&timer);
+        for (uint16_t i = 0; i < BENCH_WRITE_SIZE; i += 256) {
+            driver_write_slot(buffer, slot, 0x00, offset + i, 256);
+        }
+        results[BENCH_WRITE_BUFFERED + pass] = bench_kbps(BENCH_WRITE_SIZE, bench_timer_end(&timer));
+    }
+    settings_local.flags1 = prev_flags1;
+
+    bench_timer_start(&timer);
+    driver_erase_bank(0, slot, 0x00);
+    results[BENCH_ERASE_SECTOR] = bench_timer_end(&timer) / (LINE_TIMER_HZ / 1000);
+}
+
+static void bench_local(uint32_t *results, uint8_t *buffer) {
+    bench_timer_t timer;
+    uint8_t prev_system_ctrl2 = inportb(IO_SYSTEM_CTRL2);
+
+    // Only read from SRAM, so that the loaded save data is left alone.
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        if (pass == 0) sram_enable_fast(); else sram_disable_fast();
+        bench_timer_start(&timer);
+        for (uint16_t i = 0; i < BENCH_SRAM_SIZE; i += BENCH_BUFFER_SIZE) {
+            memcpy(buffer, MK_FP(0x1000, i), BENCH_BUFFER_SIZE);
+        }
+        results[BENCH_SRAM_FAST + pass] = bench_kbps(BENCH_SRAM_SIZE, bench_timer_end(&timer));
+    }
+    outportb(IO_SYSTEM_CTRL2, prev_system_ctrl2);
+
+    uint16_t crc = 0;
+    bench_timer_start(&timer);
+    for (uint16_t i = 0; i < BENCH_CRC16_SIZE; i++) {
+        crc = crc16_xmodem_update(crc, buffer[i & (BENCH_BUFFER_SIZE - 1)]);
+    }
+    results[BENCH_CRC16] = bench_kbps(BENCH_CRC16_SIZE, bench_timer_end(&timer));
+
+    // Sent as a CSV comment line, so that it doesn't disturb the results.
+    bench_timer_start(&timer);
+    for (uint16_t i = 0; i < BENCH_SERIAL_SIZE - 2; i++) {
+        serial_putc_buffered('#');
+    }
+    serial_putc_buffered('\r');
+    serial_putc_buffered('\n');
+    serial_flush_buffered();
+    results[BENCH_SERIAL_TX] = bench_bps(BENCH_SERIAL_SIZE, bench_timer_end(&timer));
+}
+
+__attribute__((format(printf, 1, 2)))
+static void bench_serial_printf(const char __far* format, ...) {
+    char buf[48];
+    va_list val;
+    va_start(val, format);
+    int len = vsnprintf(buf, sizeof(buf), format, val);
+    va_end(val);
+    for (int i = 0; i < len && i < (int) (sizeof(buf) - 1); i++) {
+        serial_putc_buffered(buf[i]);
+    }
+}
+
+static void bench_format_value(char *buf, int buf_len, uint32_t value, uint8_t unit) {
+    if (value == BENCH_SKIPPED) {
+        strncpy(buf, "-", buf_len);
+    } else {
+        int len = snprintf(buf, buf_len, "%ld ", value);
+        strncpy(buf + len, bench_units[unit], buf_len - len);
+    }
+}
+
+void ui_benchmark(void) {
+    uint8_t buffer[BENCH_BUFFER_SIZE];
+    uint32_t results[BENCH_COUNT];
+    char buf[24];
+    uint8_t slot = (driver_get_launch_slot() + 1) & (GAME_SLOTS - 1);
+
+#ifdef TARGET_flash_masta
+    uint16_t lk_target = driver_fm_is_rev5() ? LK_UI_FM_REV5 : LK_UI_FM_REV4;
+#else
+    uint16_t lk_target = LK_UI_GENERIC;
+#endif
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_TOOLS_BENCHMARK]);
+    ui_puts_centered(false, 3, 0, lang_keys[LK_UI_BENCH_RUNNING]);
+
+    for (uint8_t i = 0; i < BENCH_COUNT; i++) {
+        results[i] = BENCH_SKIPPED;
+    }
+    memset(buffer, 0, sizeof(buffer));
+
+    uint8_t prev_timer_ctrl = line_timer_start();
+
+    driver_unlock();
+    bench_slot(results, buffer, slot);
+    driver_lock();
+
+    xmodem_open_default();
+    bench_local(results, buffer);
+
+    line_timer_stop(prev_timer_ctrl);
+
+    ui_fill_line(3, 0);
+    strncpy(buf, lang_keys[lk_target], sizeof(buf));
+    bench_serial_printf("# CartFriend " VERSION ",%s,%s\r\n",
+        buf, ws_system_color_active() ? "color" : "mono");
+    bench_serial_printf("name,value,unit\r\n");
+    for (uint8_t i = 0; i < BENCH_COUNT; i++) {
+        const bench_test_t __far* test = &bench_tests[i];
+
+        bench_format_value(buf, sizeof(buf), results[i], test->unit);
+        ui_puts(false, 1, 4 + i, 0, lang_keys[test->lk]);
+        ui_bg_printf_right(26, 4 + i, 0, "%s", buf);
+
+        strncpy(buf, test->name, sizeof(buf));
+        bench_serial_printf("%s,", buf);
+        if (results[i] != BENCH_SKIPPED) {
+            bench_serial_printf("%ld", results[i]);
+        }
+        strncpy(buf, bench_units[test->unit], sizeof(buf));
+        bench_serial_printf(",%s\r\n", buf);
+    }
+    serial_flush_buffered();
+    ui_puts_centered(false, 15, 0, lang_keys[LK_UI_BENCH_SENT]);
+
+    xmodem_close();
+    while (!xmodem_poll_exit()) cpu_halt();
+}
+
+#endif
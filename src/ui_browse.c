@@ -21,14 +21,18 @@
 #include <string.h>
 #include <ws.h>
 #include "config.h"
+#include "deploy.h"
 #include "driver.h"
 #include "input.h"
 #include "lang.h"
+#include "progress.h"
 #include "settings.h"
 #include "sram.h"
+#include "titledb.h"
 #include "ui.h"
 #include "util.h"
 #include "ww.h"
+#include "xmodem.h"
 
 #ifdef USE_SLOT_SYSTEM
 
@@ -37,11 +41,15 @@
 #define BROWSE_SUB_RENAME 2
 #define BROWSE_SUB_INSTALL_WW 3
 #define BROWSE_SUB_MANAGE_WW 4
+#define BROWSE_SUB_RECEIVE_ROM 5
+#define BROWSE_SUB_DELTA_DEPLOY 6
+#define BROWSE_SUB_SEND_ROM 7
 
 #define WW_MANAGE_SUB_UPDATE_FULL 0
 #define WW_MANAGE_SUB_UPDATE_OS 1
 #define WW_MANAGE_SUB_UPDATE_BIOS 2
 #define WW_MANAGE_SUB_ERASE_FS 3
+#define WW_MANAGE_SUB_FILES 4
 
 // in Mbits
 static const uint8_t __far rom_size_table[] = {
@@ -112,6 +120,8 @@ static void ui_browse_menu_build_line(uint8_t entry_id, void *userdata, char *bu
         if (entry_id < GAME_SLOTS && settings_local.slot_name[entry_id][0] >= 0x20) {
             _nmemcpy(buf_name, settings_local.slot_name[entry_id] + 1, 23);
             buf_name[23] = 0;
+        } else if (cart_metadata->type == CART_TYPE_NORMAL && titledb_get_cached_name(entry_id, cart_metadata->normal.checksum, buf_name, 24)) {
+            // identified via title database
         } else if (settings_local.flags1 & SETT_FLAGS1_HIDE_SLOT_IDS) {
             buf_name[0] = 0;
         } else if (cart_metadata->type == CART_TYPE_NORMAL) {
@@ -141,7 +151,10 @@ static uint16_t __far browse_sub_lks[] = {
     LK_UI_BROWSE_POPUP_INFO,
     LK_UI_BROWSE_POPUP_RENAME,
     LK_UI_BROWSE_POPUP_INSTALL_WW,
-    LK_UI_BROWSE_POPUP_MANAGE
+    LK_UI_BROWSE_POPUP_MANAGE,
+    LK_UI_BROWSE_POPUP_RECEIVE_ROM,
+    LK_UI_BROWSE_POPUP_DELTA_DEPLOY,
+    LK_UI_BROWSE_POPUP_SEND_ROM
 };
 
 static void ui_browse_submenu_build_line(uint8_t entry_id, void *userdata, char *buf, int buf_len) {
@@ -152,7 +165,8 @@ static uint16_t __far ww_manage_sub_lks[] = {
     LK_UI_WW_UPDATE_FULL,
     LK_UI_WW_UPDATE_OS,
     LK_UI_WW_UPDATE_BIOS,
-    LK_UI_WW_ERASE_FS
+    LK_UI_WW_ERASE_FS,
+    LK_UI_WW_MANAGE_FILES
 };
 
 static void ui_ww_manage_build_line(uint8_t entry_id, void *userdata, char *buf, int buf_len, char *buf_right, int buf_right_len) {
@@ -188,6 +202,7 @@ static bool is_valid_rom_header(cart_header_t *buffer) {
 
 static uint8_t iterate_carts(uint8_t *menu_list, uint8_t *cart_metadata_tbl, uint8_t i) {
     cart_header_t header;
+    bool identify = true;
 
     ui_step_work_indicator();
     driver_unlock();
@@ -240,6 +255,12 @@ static uint8_t iterate_carts(uint8_t *menu_list, uint8_t *cart_metadata_tbl, uin
             if (cart_metadata->type != CART_TYPE_EMPTY && header.rom_size < sizeof(rom_size_table)) {
                 size_banks = ((uint16_t) rom_size_table[header.rom_size]) * 2;
             }
+            if (identify && cart_metadata->type == CART_TYPE_NORMAL && size_banks > 0 && size_banks <= (bank - 0x7F)) {
+                // if cancelled, skip identification until the next scan
+                if (titledb_identify(entry_id, slot, bank, size_banks, header.checksum) == TITLEDB_UNCACHED) {
+                    identify = false;
+                }
+            }
             if (size_banks < min_size_banks) size_banks = min_size_banks;
             bank -= size_banks;
         }
@@ -331,12 +352,334 @@ void ui_browse_info(uint8_t slot) {
 
     ui_bg_printf(0, 14, 0, lang_keys[LK_UI_BROWSE_INFO_CHECKSUM], (uint16_t) rom_header.checksum);
 
+    if (titledb_get_cached_name(slot, rom_header.checksum, buf2, sizeof(buf2))) {
+        ui_puts(false, 0, 16, 0, buf2);
+    }
+
     while (ui_poll_events()) {
         wait_for_vblank();
         if (input_pressed & (KEY_A | KEY_B)) return;
     }
 }
 
+// The sectors committed by an interrupted transfer into entry_id are still
+// in flash, unless the slot has been written to since.
+static bool ui_browse_receive_can_resume(uint8_t entry_id) {
+    uint8_t buffer[1024];
+    transfer_checkpoint_t *checkpoint = &settings_local.transfer;
+    uint8_t slot = entry_id & 0x0F;
+    uint8_t bank_last = 0xFF - (entry_id & 0xF0);
+    uint16_t crc = 0;
+
+    if (checkpoint->type != TRANSFER_ROM || checkpoint->entry_id != entry_id
+        || checkpoint->done == 0 || checkpoint->done > checkpoint->size) {
+        return false;
+    }
+
+    ui_reset_main_screen();
+    ui_tool_xmodem_ui_message(LK_UI_DEPLOY_CHECKING);
+    progress_start(14, checkpoint->done);
+    uint32_t pos = (((uint32_t) bank_last + 1) << 16) - checkpoint->size;
+    uint32_t len = checkpoint->done;
+    driver_unlock();
+    while (len > 0) {
+        // reads must not cross a bank
+        uint16_t n = 0x10000 - (pos & 0xFFFF);
+        if (n == 0 || n > sizeof(buffer)) n = sizeof(buffer);
+        if (n > len) n = len;
+        driver_read_slot(buffer, slot, pos >> 16, (uint16_t) pos, n);
+        for (uint16_t i = 0; i < n; i++) {
+            crc = crc16_xmodem_update(crc, buffer[i]);
+        }
+        pos += n;
+        len -= n;
+        progress_add(n);
+    }
+    driver_lock();
+    progress_finish();
+
+    return crc == checkpoint->crc;
+}
+
+static void ui_browse_receive_rom(uint8_t entry_id, bool resume) {
+    uint8_t buffer[XMODEM_BLOCK_SIZE_1K];
+    cart_header_t header;
+    transfer_checkpoint_t *checkpoint = &settings_local.transfer;
+    uint32_t offset = resume ? checkpoint->done : 0;
+    uint16_t crc = resume ? checkpoint->crc : 0;
+    uint8_t slot = entry_id & 0x0F;
+    uint8_t bank_last = 0xFF - (entry_id & 0xF0);
+    bool complete = false;
+    uint16_t lk_result = LK_UI_XMODEM_CANCEL;
+
+    if (slot == driver_get_launch_slot())
+        return;
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_RECEIVE]);
+    ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
+    ui_puts_centered(false, 5, 0, lang_keys[resume ? LK_UI_TRANSFER_RESUME_WAITING : LK_UI_ROM_RECEIVE_YMODEM]);
+
+    xmodem_open_default();
+    if (resume && !deploy_send_resume_offset(offset)) {
+        goto receive_end;
+    }
+    // the size must be known to place the image, so wait for a YMODEM header
+    if (xmodem_recv_start() != XMODEM_OK || xmodem_recv_header() != XMODEM_OK) {
+        goto receive_end;
+    }
+    uint32_t size = xmodem_file.size;
+    if (size == 0 || size == XMODEM_SIZE_UNKNOWN || size > (((uint32_t) deploy_slot_capacity_banks(entry_id)) << 16)
+        || (resume && size != checkpoint->size)) {
+        xmodem_recv_cancel();
+        ui_tool_xmodem_ui_message(LK_UI_XMODEM_INVALID_FILE);
+        goto receive_end;
+    }
+
+    // the image ends at the last bank of the (sub)slot; erase only the
+    // 128 KB sectors it covers and which were not committed before, while
+    // the sender waits for us
+    uint32_t pos = (((uint32_t) bank_last + 1) << 16) - size;
+    uint16_t bank_first = ((pos + offset) >> 16) & 0xFFFE;
+    ui_tool_xmodem_ui_message(LK_UI_ROM_RECEIVE_ERASING);
+    progress_start(14, ((uint32_t) (bank_last + 1 - bank_first)) << 16);
+    driver_unlock();
+    for (uint16_t bank = bank_first; bank <= bank_last; bank += 2) {
+        driver_erase_bank(0, slot, bank);
+        progress_add(0x20000);
+    }
+    driver_lock();
+    progress_finish();
+
+    titledb_invalidate_bank(slot, pos >> 16);
+    if (entry_id < GAME_SLOTS && settings_local.slot_name[entry_id][0] != 0) {
+        _nmemset(settings_local.slot_name[entry_id], 0, 24);
+        settings_mark_changed();
+    }
+
+    // saved if the transfer does not complete
+    checkpoint->type = TRANSFER_ROM;
+    checkpoint->entry_id = entry_id;
+    checkpoint->size = size;
+    checkpoint->done = offset;
+    checkpoint->crc = crc;
+    settings_mark_changed();
+
+    // the serial interrupt keeps filling the RX buffer with the next block
+    // while the previous one is being written
+    ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
+    progress_start(14, size);
+    progress_add(offset);
+    driver_irq_passthrough = HWINT_SERIAL_RX;
+    driver_unlock();
+    uint32_t received = offset;
+    bool active = true;
+    while (active) {
+        uint16_t len = sizeof(buffer);
+        uint8_t result = xmodem_recv_block(buffer, &len);
+        switch (result) {
+        case XMODEM_COMPLETE:
+            if (received == size && xmodem_recv_finish() == XMODEM_COMPLETE) {
+                complete = true;
+            } else {
+                lk_result = LK_UI_XMODEM_ERROR;
+            }
+            active = false;
+            break;
+        case XMODEM_OK:
+            // drop the sender's padding
+            if (len > size - received) len = size - received;
+            if (len > 0 && !deploy_write_chunk(buffer, slot, pos + received, len)) {
+                xmodem_recv_cancel();
+                lk_result = LK_UI_ROM_RECEIVE_VERIFY_FAILED;
+                active = false;
+                break;
+            }
+            for (uint16_t i = 0; i < len; i++) {
+                crc = crc16_xmodem_update(crc, buffer[i]);
+            }
+            received += len;
+            progress_add(len);
+            if (((pos + received) & (DEPLOY_SECTOR_SIZE - 1)) == 0) {
+                // a whole sector was written and verified
+                checkpoint->done = received;
+                checkpoint->crc = crc;
+            }
+            break;
+        case XMODEM_ERROR:
+            lk_result = LK_UI_XMODEM_ERROR;
+            active = false;
+            break;
+        default:
+            active = false;
+            break;
+        }
+    }
+    driver_lock();
+    driver_irq_passthrough = 0;
+    progress_finish();
+
+    if (complete) {
+        checkpoint->type = TRANSFER_NONE;
+    }
+    settings_save();
+
+    if (complete) {
+        driver_unlock();
+        _nmemset(&header, 0xFF, sizeof(header));
+        ui_read_rom_header(&header, slot, bank_last);
+        driver_lock();
+        lk_result = is_valid_rom_header(&header) ? LK_UI_XMODEM_COMPLETE : LK_UI_ROM_RECEIVE_BAD_HEADER;
+    }
+    ui_tool_xmodem_ui_message(lk_result);
+
+receive_end:
+    xmodem_close();
+    while (!xmodem_poll_exit()) cpu_halt();
+}
+
+static void ui_browse_send_rom(uint8_t entry_id, bool ymodem) {
+    // one buffer is sent while the other is read from the slot
+    uint8_t buffer[2][XMODEM_BLOCK_SIZE_1K];
+    char name[20];
+    cart_header_t header;
+    uint8_t slot = entry_id & 0x0F;
+    uint8_t bank_last = 0xFF - (entry_id & 0xF0);
+    uint16_t lk_result = LK_UI_XMODEM_CANCEL;
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_SEND]);
+    ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
+
+    _nmemset(&header, 0xFF, sizeof(header));
+    driver_unlock();
+    ui_read_rom_header_from_entry(&header, entry_id);
+    driver_lock();
+    if (!is_valid_rom_header(&header) || header.rom_size >= sizeof(rom_size_table)) {
+        ui_tool_xmodem_ui_message(LK_UI_ROM_RECEIVE_BAD_HEADER);
+        while (!xmodem_poll_exit()) cpu_halt();
+        return;
+    }
+    // the image ends at the last bank of the (sub)slot
+    uint32_t size = ((uint32_t) rom_size_table[header.rom_size]) << 17;
+    uint32_t capacity = ((uint32_t) deploy_slot_capacity_banks(entry_id)) << 16;
+    if (size > capacity) size = capacity;
+    uint32_t pos = (((uint32_t) bank_last + 1) << 16) - size;
+    snprintf(name, sizeof(name), "slot%02d_%02X.ws%s", slot + 1, bank_last, header.color ? "c" : "");
+
+    xmodem_open_default();
+    uint8_t result = xmodem_send_start();
+    if (result == XMODEM_OK && ymodem) {
+        result = xmodem_send_header(name, size);
+    }
+    if (result == XMODEM_OK) {
+        ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
+        progress_start(14, size);
+        // the TX interrupt keeps sending the tail of the previous block
+        // while the cartridge is switched to the slot being read
+        driver_irq_passthrough = HWINT_SERIAL_RX | HWINT_SERIAL_TX;
+        driver_unlock();
+        uint8_t current = 0;
+        driver_read_slot(buffer[current], slot, pos >> 16, pos, XMODEM_BLOCK_SIZE_1K);
+        for (uint32_t sent = 0; sent < size && result == XMODEM_OK; sent += XMODEM_BLOCK_SIZE_1K) {
+            uint32_t next = pos + sent + XMODEM_BLOCK_SIZE_1K;
+            xmodem_send_block_begin(buffer[current], XMODEM_BLOCK_SIZE_1K);
+            if (sent + XMODEM_BLOCK_SIZE_1K < size) {
+                driver_read_slot(buffer[current ^ 1], slot, next >> 16, next, XMODEM_BLOCK_SIZE_1K);
+            }
+            result = xmodem_send_block_end();
+            progress_add(XMODEM_BLOCK_SIZE_1K);
+            current ^= 1;
+        }
+        driver_lock();
+        driver_irq_passthrough = 0;
+        progress_finish();
+        if (result == XMODEM_OK) {
+            result = xmodem_send_finish();
+        }
+        if (result == XMODEM_OK && ymodem) {
+            result = xmodem_send_batch_end();
+        }
+    }
+    if (result == XMODEM_OK) {
+        lk_result = LK_UI_XMODEM_COMPLETE;
+    } else if (result == XMODEM_ERROR) {
+        lk_result = LK_UI_XMODEM_ERROR;
+    }
+    ui_tool_xmodem_ui_message(lk_result);
+
+    xmodem_close();
+    while (!xmodem_poll_exit()) cpu_halt();
+}
+
+bool ui_browse_prepare_launch(uint8_t entry_id, bool select_save) {
+    uint8_t menu_list[SRAM_SLOTS + 1];
+    cart_header_t header;
+    uint8_t slot_type = settings_local.slot_type[entry_id & 0x0F];
+
+    _nmemset(menu_list, 0xFF, sizeof(menu_list));
+    _nmemset(&header, 0xFF, sizeof(header));
+    driver_unlock();
+    ui_read_rom_header_from_entry(&header, entry_id);
+    driver_lock();
+
+    // does the game use save data?
+    if (header.save_type != 0 && _CS >= 0x2000) {
+        // figure out SRAM slots
+        uint8_t i = 0;
+        for (uint8_t k = 0; k < SRAM_SLOTS; k++) {
+            if (settings_local.sram_slot_mapping[k] == (entry_id & 0x0F)) {
+                menu_list[i++] = k;
+            }
+        }
+        uint8_t sram_slot = 0xFF;
+        if (select_save && i > 1) {
+            menu_list[i++] = MENU_ENTRY_END;
+            ui_menu_state_t menu = {
+                .list = menu_list,
+                .build_line_func = ui_browse_save_select_build_line,
+                .flags = MENU_B_AS_BACK
+            };
+            ui_menu_init(&menu);
+            uint16_t result_sram = ui_menu_select(&menu);
+            if (result_sram == MENU_ENTRY_END) {
+                return false;
+            } else {
+                sram_slot = menu_list[result_sram & 0xFF];
+            }
+        } else if (i > 0) {
+            sram_slot = menu_list[0];
+        }
+
+        uint8_t offset_size = SRAM_OFFSET_SIZE_DEFAULT;
+        if (slot_type == SLOT_TYPE_8M_2M  ) offset_size = SRAM_OFFSET_SIZE((entry_id >= 0x10) ? 4 : 0, 4);
+        if (slot_type == SLOT_TYPE_8M_512K) offset_size = SRAM_OFFSET_SIZE((entry_id >> 4) & 7, 1);
+        
+        sram_switch_to_slot(sram_slot, offset_size);
+    } else {
+        if (settings_local.active_sram_slot == SRAM_SLOT_FIRST_BOOT) {
+            settings_local.active_sram_slot = SRAM_SLOT_NONE;
+            settings_local.active_sram_offset_size = SRAM_OFFSET_SIZE_DEFAULT;
+            settings_mark_changed();
+        }
+    }
+
+    // does the game leave IEEPROM unlocked?
+    if (!(header.version & 0x80)) {
+        // lock IEEPROM
+        outportw(IO_IEEP_CTRL, IEEP_PROTECT);
+    }
+    return true;
+}
+
+static void ui_browse_launch(uint8_t entry_id, bool is_ww) {
+    ui_reset_main_screen();
+    if (!ui_browse_prepare_launch(entry_id, !is_ww)) return;
+
+    input_wait_clear();
+    launch_slot(entry_id & 0x0F, 0xFF - (entry_id & 0xF0));
+}
+
 __attribute__((noinline))
 static uint8_t ui_browse_inner(uint8_t *entry_id_ret) {
     uint8_t menu_list[256];
@@ -345,6 +688,8 @@ static uint8_t ui_browse_inner(uint8_t *entry_id_ret) {
 
     i = iterate_carts(menu_list, cart_metadata, i);
     menu_list[i++] = MENU_ENTRY_END;
+    // clear identification status, if any
+    ui_reset_main_screen();
 
     ui_menu_state_t menu = {
         .list = menu_list,
@@ -373,63 +718,17 @@ static uint8_t ui_browse_inner(uint8_t *entry_id_ret) {
             menu_list[i++] = BROWSE_SUB_INFO;
             if (entry_id < 0x10) menu_list[i++] = BROWSE_SUB_RENAME;
             if (!is_ww && (slot_type == SLOT_TYPE_SOFT || slot_type == SLOT_TYPE_8M_2M)) menu_list[i++] = BROWSE_SUB_INSTALL_WW;
+            if (slot_type != SLOT_TYPE_LAUNCHER) {
+                menu_list[i++] = BROWSE_SUB_RECEIVE_ROM;
+                menu_list[i++] = BROWSE_SUB_DELTA_DEPLOY;
+            }
+            if (!is_ww && CART_METADATA_GET(cart_metadata, entry_id)->type != CART_TYPE_EMPTY) menu_list[i++] = BROWSE_SUB_SEND_ROM;
             menu_list[i++] = MENU_ENTRY_END;
             subaction = ui_popup_menu_run(&popup_menu);
         }
 
         if (subaction == BROWSE_SUB_LAUNCH) {
-            ui_reset_main_screen();
-
-            cart_header_t *header = (cart_header_t*) (menu_list + 128);
-            _nmemset(menu_list, 0xFF, 16);
-            ui_read_rom_header_from_entry(header, entry_id);
-
-            // does the game use save data?
-            if (header->save_type != 0 && _CS >= 0x2000) {
-                // figure out SRAM slots
-                i = 0;
-                for (uint8_t k = 0; k < SRAM_SLOTS; k++) {
-                    if (settings_local.sram_slot_mapping[k] == (entry_id & 0x0F)) {
-                        menu_list[i++] = k;
-                    }
-                }
-                uint8_t sram_slot = 0xFF;
-                if (!is_ww && i > 1) {
-                    menu_list[i++] = MENU_ENTRY_END;
-                    menu.build_line_func = ui_browse_save_select_build_line;
-                    menu.flags = MENU_B_AS_BACK;
-                    ui_menu_init(&menu);
-                    uint16_t result_sram = ui_menu_select(&menu);
-                    if (result_sram == MENU_ENTRY_END) {
-                        return 0;
-                    } else {
-                        sram_slot = menu_list[result_sram & 0xFF];
-                    }
-                } else if (i > 0) {
-                    sram_slot = menu_list[0];
-                }
-
-                uint8_t offset_size = SRAM_OFFSET_SIZE_DEFAULT;
-                if (slot_type == SLOT_TYPE_8M_2M  ) offset_size = SRAM_OFFSET_SIZE((entry_id >= 0x10) ? 4 : 0, 4);
-                if (slot_type == SLOT_TYPE_8M_512K) offset_size = SRAM_OFFSET_SIZE((entry_id >> 4) & 7, 1);
-                
-                sram_switch_to_slot(sram_slot, offset_size);
-            } else {
-                if (settings_local.active_sram_slot == SRAM_SLOT_FIRST_BOOT) {
-                    settings_local.active_sram_slot = SRAM_SLOT_NONE;
-                    settings_local.active_sram_offset_size = SRAM_OFFSET_SIZE_DEFAULT;
-                    settings_mark_changed();
-                }
-            }
-
-            // does the game leave IEEPROM unlocked?
-            if (!(header->version & 0x80)) {
-                // lock IEEPROM
-                outportw(IO_IEEP_CTRL, IEEP_PROTECT);
-            }
-
-            input_wait_clear();
-            launch_slot(entry_id & 0x0F, 0xFF - (entry_id & 0xF0));
+            ui_browse_launch(entry_id, is_ww);
         } else if (subaction == BROWSE_SUB_INFO) {
             ui_browse_info(entry_id);
         } else if (subaction == BROWSE_SUB_RENAME) {
@@ -448,7 +747,8 @@ static uint8_t ui_browse_inner(uint8_t *entry_id_ret) {
                     settings_mark_changed();
                 }
             }
-        } else if (subaction == BROWSE_SUB_INSTALL_WW || subaction == BROWSE_SUB_MANAGE_WW) {
+        } else if (subaction == BROWSE_SUB_INSTALL_WW || subaction == BROWSE_SUB_MANAGE_WW || subaction == BROWSE_SUB_RECEIVE_ROM || subaction == BROWSE_SUB_DELTA_DEPLOY
+            || subaction == BROWSE_SUB_SEND_ROM) {
             return subaction;
         }
     }
@@ -465,7 +765,25 @@ void ui_browse(void) {
     uint8_t bank = 0xF0 - (entry_id & 0xF0);
     uint8_t menu_list[8];
 
-    if (subaction == BROWSE_SUB_INSTALL_WW) {
+    if (subaction == BROWSE_SUB_RECEIVE_ROM) {
+        if (ui_browse_receive_can_resume(entry_id)
+            && ui_dialog_run(0, 1, LK_DIALOG_TRANSFER_RESUME, LK_DIALOG_YES_NO) == 0) {
+            ui_browse_receive_rom(entry_id, true);
+        } else if (ui_dialog_run(0, 1, LK_DIALOG_ROM_RECEIVE, LK_DIALOG_YES_NO) == 0) {
+            ui_browse_receive_rom(entry_id, false);
+        }
+    } else if (subaction == BROWSE_SUB_DELTA_DEPLOY) {
+        if (ui_dialog_run(0, 1, LK_DIALOG_ROM_RECEIVE, LK_DIALOG_YES_NO) == 0) {
+            if (deploy_ui_delta(entry_id)) {
+                ui_browse_launch(entry_id, false);
+            }
+        }
+    } else if (subaction == BROWSE_SUB_SEND_ROM) {
+        uint8_t protocol = ui_dialog_run(0, 1, LK_DIALOG_ROM_SEND, LK_DIALOG_XMODEM_YMODEM);
+        if (protocol != 0xFF) {
+            ui_browse_send_rom(entry_id, protocol == 1);
+        }
+    } else if (subaction == BROWSE_SUB_INSTALL_WW) {
         if (ui_dialog_run(0, 1, LK_DIALOG_WW_INSTALL, LK_DIALOG_YES_NO) == 0) {
             ww_ui_erase_userdata(slot, bank);
             ww_ui_install_full(slot, bank);
@@ -482,6 +800,7 @@ void ui_browse(void) {
         menu_list[i++] = WW_MANAGE_SUB_UPDATE_FULL;
         menu_list[i++] = WW_MANAGE_SUB_UPDATE_OS;
         menu_list[i++] = WW_MANAGE_SUB_UPDATE_BIOS;
+        menu_list[i++] = WW_MANAGE_SUB_FILES;
         menu_list[i++] = WW_MANAGE_SUB_ERASE_FS;
         menu_list[i++] = MENU_ENTRY_END;
         ui_menu_init(&menu);
@@ -492,6 +811,8 @@ void ui_browse(void) {
             ww_ui_install_bios(slot, bank);
         } else if (result == WW_MANAGE_SUB_UPDATE_OS) {
             ww_ui_install_os(slot, bank);
+        } else if (result == WW_MANAGE_SUB_FILES) {
+            ww_ui_manage_files(slot, bank);
         } else if (result == WW_MANAGE_SUB_ERASE_FS) {
             if (ui_dialog_run(0, 1, LK_DIALOG_CONFIRM, LK_DIALOG_YES_NO) == 0) {
                 ww_ui_erase_userdata(slot, bank);
@@ -215,8 +215,16 @@ static void ui_opt_menu_erase_sram_build_line(uint8_t entry_id, void *userdata,
         strncpy(buf, lang_keys[LK_UI_ERASE_UNDO_SRAM], buf_len);
     } else if (entry_id == 0xED) {
         strncpy(buf, lang_keys[LK_UI_ERASE_TEST_ALL_SAVE_DATA], buf_len);
+    } else if (entry_id == 0xE9) {
+        strncpy(buf, lang_keys[LK_UI_SRAM_TEST], buf_len);
+    } else if (entry_id == 0xE8) {
+        strncpy(buf, lang_keys[LK_UI_FLASH_HEALTH], buf_len);
     } else if (entry_id == 0xEC) {
         strncpy(buf, lang_keys[LK_UI_ERASE_ALL_SAVE_BLOCKS], buf_len);
+    } else if (entry_id == 0xEB) {
+        strncpy(buf, lang_keys[LK_UI_SAVE_EXPORT], buf_len);
+    } else if (entry_id == 0xEA) {
+        strncpy(buf, lang_keys[LK_UI_SAVE_IMPORT], buf_len);
     }
 }
 
@@ -380,9 +388,13 @@ Reselect:
         for (uint8_t j = 0; j < SRAM_SLOTS; j++) {
             menu_list[i++] = j;
         }
+        menu_list[i++] = 0xEB;
+        menu_list[i++] = 0xEA;
         menu_list[i++] = 0xEC;
         menu_list[i++] = 0xEF;
         menu_list[i++] = 0xED;
+        menu_list[i++] = 0xE9;
+        menu_list[i++] = 0xE8;
         menu_list[i++] = 0xEE;
         menu_list[i] = MENU_ENTRY_END;
 
@@ -397,6 +409,33 @@ SaveMgmtReselect:
             return;
         }
 
+        if (result == 0xEB || result == 0xEA) {
+            // pick the block to transfer
+            bool is_import = result == 0xEA;
+            uint8_t block_list[SRAM_SLOTS + 1];
+            for (uint8_t j = 0; j < SRAM_SLOTS; j++) {
+                block_list[j] = j;
+            }
+            block_list[SRAM_SLOTS] = MENU_ENTRY_END;
+            ui_menu_state_t block_menu = {
+                .list = block_list,
+                .build_line_func = ui_opt_menu_savemap_build_line,
+                .flags = MENU_B_AS_BACK
+            };
+            ui_menu_init(&block_menu);
+            ui_reset_main_screen();
+            result = ui_menu_select(&block_menu);
+            if (result != MENU_ENTRY_END) {
+                if (!is_import) {
+                    sram_ui_export(result);
+                } else if (ui_dialog_run(0, 1, LK_DIALOG_SAVE_IMPORT, LK_DIALOG_YES_NO) == 0) {
+                    sram_ui_import(result);
+                }
+            }
+            ui_reset_main_screen();
+            goto SaveMgmtReselect;
+        }
+
         if (ui_dialog_run(0, 1, LK_DIALOG_CONFIRM, LK_DIALOG_YES_NO) == 0) {
             if (result < SRAM_SLOTS) {
                 // if active, erase in-SRAM data too
@@ -443,6 +482,23 @@ SaveMgmtReselect:
                 ui_puts_centered(false, 2, 0, lang_keys[LK_UI_PRESS_ANY_KEY]);
                 input_wait_any_key();
                 settings_mark_changed();
+            } else if (result == 0xE8) {
+                test_flash_health();
+            } else if (result == 0xE9) {
+                // test the SRAM chip; save data is moved to flash first
+                sram_unload();
+                ui_reset_main_screen();
+                ui_puts_centered(false, 1, 0, lang_keys[LK_UI_SRAM_TEST_LINE1]);
+                ui_puts_centered(false, 2, 0, lang_keys[LK_UI_PLEASE_WAIT]);
+                test_sram(4);
+                sram_ui_quiet = true;
+                sram_erase(SRAM_SLOT_NONE, SRAM_OFFSET_SIZE_DEFAULT);
+                sram_ui_quiet = false;
+                settings_local.active_sram_slot = SRAM_SLOT_NONE;
+                settings_local.active_sram_offset_size = SRAM_OFFSET_SIZE_DEFAULT;
+                ui_puts_centered(false, 2, 0, lang_keys[LK_UI_PRESS_ANY_KEY]);
+                input_wait_any_key();
+                settings_mark_changed();
             } else {
                 return;
             }
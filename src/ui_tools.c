@@ -22,9 +22,12 @@
 #include <wsx/zx0.h>
 #include "driver.h"
 #include "lang.h"
+#include "remote.h"
+#include "serial.h"
 #include "settings.h"
 #include "sram.h"
 #include "ui.h"
+#include "unpack.h"
 #include "util.h"
 #include "ws/hardware.h"
 #include "ws/system.h"
@@ -35,6 +38,8 @@ typedef enum {
     MENU_TOOL_BFBCODE_XM,
     MENU_TOOL_SRAMCODE_XM,
     MENU_TOOL_WSMONITOR_RAM,
+    MENU_TOOL_REMOTE,
+    MENU_TOOL_BENCHMARK,
     MENU_TOOL_IPL_SRAM
 } ui_tool_id_t;
 
@@ -42,6 +47,8 @@ static uint16_t __far ui_tool_lks[] = {
     LK_UI_TOOLS_BFBCODE_XM,
     LK_UI_TOOLS_SRAMCODE_XM,
     LK_UI_TOOLS_WSMONITOR_RAM,
+    LK_UI_TOOLS_REMOTE,
+    LK_UI_TOOLS_BENCHMARK,
     LK_UI_TOOLS_IPL_SRAM
 };
 static void ui_tool_menu_build_line(uint8_t entry_id, void *userdata, char *buf, int buf_len, char *buf_right, int buf_right_len) {
@@ -56,6 +63,11 @@ static void ui_tool_menu_build_line(uint8_t entry_id, void *userdata, char *buf,
 void ui_tool_xmodem_ui_message(uint16_t lk_msg) {
     ui_fill_line(13, 0);
     ui_puts_centered(false, 13, 0, lang_keys[lk_msg]);
+    if (lk_msg == LK_UI_XMODEM_ERROR) {
+        ui_fill_line(15, 0);
+        ui_bg_printf_centered(15, 0, lang_keys[LK_UI_XMODEM_STATS],
+            xmodem_stats.blocks, xmodem_stats.retries, serial_rx_overruns);
+    }
 }
 
 void ui_tool_xmodem_ui_step(uint32_t bytes) {
@@ -67,25 +79,33 @@ void ui_tool_xmodem_ui_step(uint32_t bytes) {
     ui_step_work_indicator();
 }
 
-static void ui_tool_sramcode_bfb() {
-    uint8_t buffer[128];
+// The first block is received at the lowest address a program may start
+// at, then moved into place once its header has been parsed.
+#define BFB_CODE_MIN 0x6800
+#define BFB_CODE_END 0xFE00
 
+static void ui_tool_sramcode_bfb() {
     ui_reset_main_screen();
     ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_RECEIVE]);
     ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
 
+    unpack_state_t unpack;
+    uint8_t __far* buffer = MK_FP(BFB_CODE_MIN >> 4, 0x0000);
     uint8_t __far* code_start_ptr;
     uint8_t __far* code_ptr = buffer;
-    uint16_t code_blocks_left = 0xFFFF;
-    bool code_offset0 = false;
+    uint16_t code_left = 0xFFFF;
     bool active = true;
 
     xmodem_open_default();
     if (xmodem_recv_start() == XMODEM_OK) {
+        unpack_init(&unpack);
         while (active) {
-            uint8_t result = xmodem_recv_block(code_ptr);
+            uint16_t len = code_left > XMODEM_BLOCK_SIZE_1K ? XMODEM_BLOCK_SIZE_1K : code_left;
+            uint8_t result = unpack_recv_block(&unpack, code_ptr, &len);
             switch (result) {
                 case XMODEM_COMPLETE:
+                    xmodem_recv_finish();
+                    xmodem_close();
                     launch_ram(code_start_ptr);
                     break;
                 case XMODEM_SELF_CANCEL:
@@ -93,7 +113,7 @@ static void ui_tool_sramcode_bfb() {
                     active = false;
                     break;
                 case XMODEM_OK:
-                    if (code_blocks_left == 0xFFFF) {
+                    if (code_left == 0xFFFF) {
                         ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
 
                         if (buffer[0] != 'b' || buffer[1] != 'F') {
@@ -101,31 +121,39 @@ static void ui_tool_sramcode_bfb() {
                             active = false;
                             break;
                         } else {
-                            uint16_t code_start = *((uint16_t *) (buffer + 2));
+                            // later compressed frames may refer back to the
+                            // header, so it is kept in front of the code
+                            bool compressed = unpack_is_compressed(&unpack);
+                            uint16_t code_min = compressed ? (BFB_CODE_MIN + 4) : BFB_CODE_MIN;
+                            uint16_t code_start = *((uint16_t __far*) (buffer + 2));
                             if (code_start == 0xFFFF) {
-                                code_start = 0x6800;
-                                code_start_ptr = MK_FP(0x0680, 0x0000);
-                                code_offset0 = true;
+                                code_start = compressed ? (BFB_CODE_MIN + 16) : BFB_CODE_MIN;
+                                code_start_ptr = MK_FP(code_start >> 4, 0x0000);
                             } else {
                                 code_start_ptr = MK_FP(0x0000, code_start);
                             }
-                            if (code_start < 0x6800 || code_start > 0xFD80) {
+                            if (code_start < code_min || code_start > (BFB_CODE_END - len + 4)
+                                || (!compressed && xmodem_file.size != XMODEM_SIZE_UNKNOWN && xmodem_file.size > (uint32_t) (BFB_CODE_END - code_start + 4))) {
                                 ui_tool_xmodem_ui_message(LK_UI_XMODEM_INVALID_FILE);
                                 active = false;
                                 break;
                             } else {
-                                code_blocks_left = (0xFE00 - code_start - 124) >> 7;
-                                code_ptr = code_start_ptr;
-                                memcpy(code_ptr, buffer + 4, 124);
-                                code_ptr += 124;
+                                code_left = BFB_CODE_END - code_start - (len - 4);
+                                code_ptr = MK_FP(0x0000, code_start);
+                                if (compressed) {
+                                    memmove(code_ptr - 4, buffer, len);
+                                } else {
+                                    memmove(code_ptr, buffer + 4, len - 4);
+                                }
+                                code_ptr += len - 4;
                                 break;
                             }
                         }
-                    } else if (code_blocks_left--) {
-                        code_ptr += 128;
+                    } else {
+                        code_left -= len;
+                        code_ptr += len;
                         break;
                     }
-                    // fall through to XMODEM_ERROR
                 case XMODEM_ERROR:
                     ui_tool_xmodem_ui_message(LK_UI_XMODEM_ERROR);
                     active = false;
@@ -139,6 +167,28 @@ static void ui_tool_sramcode_bfb() {
     while (!xmodem_poll_exit()) cpu_halt();
 }
 
+// Programs are loaded at 1000:0010 onwards, continuing across all eight
+// 64 KB SRAM banks; bank N holds the file from offset N * 64 KB - 16 on.
+// Compressed uploads are limited to the first bank, as their frames are
+// unpacked in place to keep earlier data visible to later matches.
+#define SRAMCODE_START 0x0010
+#define SRAMCODE_MAX_SIZE (0x80000 - SRAMCODE_START)
+
+static void ui_tool_sramcode_copy(const uint8_t *data, uint32_t pos, uint16_t len) {
+    while (len > 0) {
+        uint16_t offset = pos;
+        uint16_t n = len;
+        if (offset != 0 && ((uint16_t) (0 - offset)) < n) {
+            n = 0 - offset;
+        }
+        outportb(IO_BANK_RAM, pos >> 16);
+        memcpy(MK_FP(0x1000, offset), data, n);
+        data += n;
+        pos += n;
+        len -= n;
+    }
+}
+
 static void ui_tool_sramcode_xm() {
     sram_unload();
 
@@ -146,33 +196,52 @@ static void ui_tool_sramcode_xm() {
     ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_RECEIVE]);
     ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
 
-    uint8_t __far* sram_ptr = MK_FP(0x1000, 0x0010);
-    uint16_t sram_incrs = 0;
+    uint8_t buffer[XMODEM_BLOCK_SIZE_1K];
+    unpack_state_t unpack;
+    // linear SRAM address
+    uint32_t sram_pos = SRAMCODE_START;
     bool active = true;
 
     xmodem_open_default();
     if (xmodem_recv_start() == XMODEM_OK) {
+        unpack_init(&unpack);
         while (active) {
-            uint8_t result = xmodem_recv_block(sram_ptr);
+            // blocks are received into RAM first, as 1K blocks can cross
+            // an SRAM bank boundary
+            uint8_t __far* dest = buffer;
+            uint16_t len = (0x80000 - sram_pos) > sizeof(buffer) ? sizeof(buffer) : (0x80000 - sram_pos);
+            if (sram_pos != SRAMCODE_START && unpack_is_compressed(&unpack)) {
+                dest = MK_FP(0x1000, (uint16_t) sram_pos);
+                len = (0x10000 - sram_pos) > UNPACK_FRAME_SIZE ? UNPACK_FRAME_SIZE : (0x10000 - sram_pos);
+            }
+            uint8_t result = unpack_recv_block(&unpack, dest, &len);
             switch (result) {
                 case XMODEM_COMPLETE:
-                    launch_ram(MK_FP(0x1000, 0x0010));
+                    xmodem_recv_finish();
+                    xmodem_close();
+                    // start with the program's first bank mapped
+                    outportb(IO_BANK_RAM, 0);
+                    launch_ram(MK_FP(0x1000, SRAMCODE_START));
                     break;
                 case XMODEM_SELF_CANCEL:
                 case XMODEM_CANCEL:
                     active = false;
                     break;
                 case XMODEM_OK:
-                    if (sram_incrs == 0) {
+                    if (sram_pos == SRAMCODE_START) {
+                        if (xmodem_file.size != XMODEM_SIZE_UNKNOWN && xmodem_file.size > SRAMCODE_MAX_SIZE) {
+                            ui_tool_xmodem_ui_message(LK_UI_XMODEM_INVALID_FILE);
+                            active = false;
+                            break;
+                        }
                         ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
                     }
-                    sram_incrs++;
-                    if (sram_incrs < 512) {
-                        ui_tool_xmodem_ui_step((uint32_t) sram_incrs << 7);
-                        sram_ptr += 128;
-                        break;
+                    if (dest == buffer) {
+                        ui_tool_sramcode_copy(buffer, sram_pos, len);
                     }
-                    // fall through to XMODEM_ERROR
+                    sram_pos += len;
+                    ui_tool_xmodem_ui_step(sram_pos - SRAMCODE_START);
+                    break;
                 case XMODEM_ERROR:
                     ui_tool_xmodem_ui_message(LK_UI_XMODEM_ERROR);
                     active = false;
@@ -192,6 +261,10 @@ void ui_tools(void) {
     if (ws_system_color_active()) menu_list[i++] = MENU_TOOL_BFBCODE_XM;
     if ((_CS & 0xF000) != 0x1000) menu_list[i++] = MENU_TOOL_SRAMCODE_XM;
     menu_list[i++] = MENU_TOOL_WSMONITOR_RAM;
+#ifdef USE_SLOT_SYSTEM
+    menu_list[i++] = MENU_TOOL_REMOTE;
+    menu_list[i++] = MENU_TOOL_BENCHMARK;
+#endif
 #ifndef TARGET_flash_masta
     if (!(inportb(IO_SYSTEM_CTRL1) & SYSTEM_CTRL1_IPL_LOCKED)) menu_list[i++] = MENU_TOOL_IPL_SRAM;
 #endif
@@ -208,6 +281,10 @@ void ui_tools(void) {
     switch (result) {
         case MENU_TOOL_BFBCODE_XM: ui_tool_sramcode_bfb(); break;
         case MENU_TOOL_SRAMCODE_XM: ui_tool_sramcode_xm(); break;
+#ifdef USE_SLOT_SYSTEM
+        case MENU_TOOL_REMOTE: remote_ui_run(); break;
+        case MENU_TOOL_BENCHMARK: ui_benchmark(); break;
+#endif
         case MENU_TOOL_WSMONITOR_RAM: {
             wait_for_vblank();
             outportw(IO_DISPLAY_CTRL, 0);
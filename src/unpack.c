@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ws.h>
+#include <wsx/zx0.h>
+#include "unpack.h"
+#include "xmodem.h"
+
+static const char __far unpack_magic[3] = {'C', 'F', 'Z'};
+
+void unpack_init(unpack_state_t *state) {
+    state->mode = UNPACK_MODE_DETECT;
+    state->independent = false;
+    state->pos = 0;
+    state->fill = 0;
+}
+
+// Unpacks the next frame in the buffer, if it has been received in full.
+static uint8_t unpack_frame(unpack_state_t *state, uint8_t __far* block, uint16_t *len) {
+    uint16_t avail = state->fill - state->pos;
+    if (avail < UNPACK_FRAME_HEADER_SIZE) {
+        return XMODEM_SELF_CANCEL;
+    }
+
+    const uint8_t *frame = state->buffer + state->pos;
+    uint16_t packed_len = frame[0] | (frame[1] << 8);
+    uint16_t raw_len = frame[2] | (frame[3] << 8);
+    if (packed_len == 0) {
+        return XMODEM_COMPLETE;
+    } else if (packed_len > raw_len || raw_len > UNPACK_FRAME_SIZE || raw_len > *len) {
+        return XMODEM_ERROR;
+    } else if (avail < UNPACK_FRAME_HEADER_SIZE + packed_len) {
+        return XMODEM_SELF_CANCEL;
+    }
+
+    if (packed_len == raw_len) {
+        memcpy(block, frame + UNPACK_FRAME_HEADER_SIZE, raw_len);
+    } else {
+        wsx_zx0_decompress(block, frame + UNPACK_FRAME_HEADER_SIZE);
+    }
+    state->pos += UNPACK_FRAME_HEADER_SIZE + packed_len;
+    *len = raw_len;
+    return XMODEM_OK;
+}
+
+uint8_t unpack_recv_block(unpack_state_t *state, uint8_t __far* block, uint16_t *len) {
+    if (state->mode == UNPACK_MODE_RAW) {
+        return xmodem_recv_block(block, len);
+    }
+
+    while (true) {
+        if (state->mode == UNPACK_MODE_ZX0) {
+            // XMODEM_SELF_CANCEL: more data needed
+            uint8_t result = unpack_frame(state, block, len);
+            if (result == XMODEM_OK) {
+                return XMODEM_OK;
+            } else if (result == XMODEM_COMPLETE) {
+                // anything past the end is padding
+                state->mode = UNPACK_MODE_ZX0_END;
+            } else if (result == XMODEM_ERROR) {
+                xmodem_recv_cancel();
+                return XMODEM_ERROR;
+            } else {
+                // keep the partial frame, making room for the next block
+                state->fill -= state->pos;
+                memmove(state->buffer, state->buffer + state->pos, state->fill);
+                state->pos = 0;
+            }
+        }
+        if (state->mode == UNPACK_MODE_ZX0_END) {
+            state->pos = 0;
+            state->fill = 0;
+        }
+
+        uint16_t block_len = sizeof(state->buffer) - state->fill;
+        uint8_t result = xmodem_recv_block(state->buffer + state->fill, &block_len);
+        if (result == XMODEM_COMPLETE && state->mode == UNPACK_MODE_ZX0) {
+            // the stream was cut short
+            return XMODEM_ERROR;
+        } else if (result != XMODEM_OK) {
+            return result;
+        }
+        state->fill += block_len;
+
+        if (state->mode == UNPACK_MODE_DETECT) {
+            // "CFZ0" or "CFZ1"
+            if (block_len > sizeof(unpack_magic) && !memcmp(state->buffer, unpack_magic, sizeof(unpack_magic))
+                && (state->buffer[sizeof(unpack_magic)] & 0xFE) == '0') {
+                state->mode = UNPACK_MODE_ZX0;
+                state->independent = state->buffer[sizeof(unpack_magic)] == '1';
+                state->pos = sizeof(unpack_magic) + 1;
+            } else {
+                // not compressed; pass this and all further blocks through
+                state->mode = UNPACK_MODE_RAW;
+                if (block_len > *len) {
+                    xmodem_recv_cancel();
+                    return XMODEM_ERROR;
+                }
+                memcpy(block, state->buffer, block_len);
+                *len = block_len;
+                return XMODEM_OK;
+            }
+        }
+    }
+}
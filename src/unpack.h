@@ -0,0 +1,58 @@
+#pragma once
+/**
+ * Copyright (c) 2022 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "xmodem.h"
+
+// Compressed uploads (see tools/zx0pack.py) start with "CFZ0", followed
+// by frames of: u16 packed length (0 = end), u16 unpacked length, data.
+// A frame is stored if both lengths are equal, and ZX0-packed otherwise.
+// Frames are unpacked to consecutive addresses, as their matches may
+// reach back into the ones before.
+// "CFZ1" streams are framed the same way, but each frame is packed on its
+// own, and may be unpacked anywhere.
+#define UNPACK_FRAME_SIZE 512
+#define UNPACK_FRAME_HEADER_SIZE 4
+
+#define UNPACK_MODE_DETECT 0
+#define UNPACK_MODE_RAW 1
+#define UNPACK_MODE_ZX0 2
+#define UNPACK_MODE_ZX0_END 3
+
+typedef struct {
+    uint8_t mode;
+    bool independent;
+    uint16_t pos;
+    uint16_t fill;
+    // a partial frame, followed by room for the next XMODEM block
+    uint8_t buffer[UNPACK_FRAME_HEADER_SIZE + UNPACK_FRAME_SIZE + XMODEM_BLOCK_SIZE_1K];
+} unpack_state_t;
+
+void unpack_init(unpack_state_t *state);
+// Like xmodem_recv_block(), but unpacks compressed uploads; in that case,
+// the returned blocks are of any size up to UNPACK_FRAME_SIZE.
+uint8_t unpack_recv_block(unpack_state_t *state, uint8_t __far* block, uint16_t *len);
+
+static inline bool unpack_is_compressed(const unpack_state_t *state) {
+    return state->mode >= UNPACK_MODE_ZX0;
+}
+
+static inline bool unpack_is_independent(const unpack_state_t *state) {
+    return state->mode >= UNPACK_MODE_ZX0 && state->independent;
+}
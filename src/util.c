@@ -34,6 +34,22 @@ void wait_for_vblank(void) {
         }
 }
 
+uint8_t line_timer_start(void) {
+    uint8_t prev_ctrl = inportb(IO_TIMER_CTRL);
+    outportw(IO_HBLANK_TIMER, 0xFFFF);
+    outportb(IO_TIMER_CTRL, prev_ctrl | 0x03); // HBlank enable, repeat
+    return prev_ctrl;
+}
+
+void line_timer_stop(uint8_t prev_ctrl) {
+    outportb(IO_TIMER_CTRL, prev_ctrl);
+}
+
+uint16_t line_timer_get(void) {
+    // the counter counts down
+    return ~inportw(IO_HBLANK_COUNTER);
+}
+
 int u8_arraylist_len(uint8_t *list) {
     int i = 0;
     while (*(list++) != 0xFF) {
@@ -97,4 +113,28 @@ uint16_t crc16(const char *data, uint16_t len, uint16_t pad_len) {
 
     crc = ~crc;
     return (crc << 8) | (crc >> 8);
-}
\ No newline at end of file
+}
+
+// CRC-16/XMODEM (polynomial 0x1021), one byte at a time without a table
+uint16_t crc16_xmodem_update(uint16_t crc, uint8_t v) {
+    crc = (crc >> 8) | (crc << 8);
+    crc ^= v;
+    crc ^= (crc & 0xFF) >> 4;
+    crc ^= crc << 12;
+    crc ^= (crc & 0xFF) << 5;
+    return crc;
+}
+
+#define CRC32_POLY 0xEDB88320
+
+bool crc32_with_table(bool (*func)(const uint32_t *table, void *userdata), void *userdata) {
+    uint32_t table[256];
+    for (uint16_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ CRC32_POLY) : (crc >> 1);
+        }
+        table[i] = crc;
+    }
+    return func(table, userdata);
+}
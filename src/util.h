@@ -23,9 +23,24 @@ void xmodem_open_default(void);
 
 void wait_for_vblank(void);
 
+// The HBlank timer, run as a free-running counter of display lines.
+#define LINE_TIMER_HZ 12000
+#define LINE_TIMER_LINES_PER_FRAME 159
+uint8_t line_timer_start(void); // returns the state to pass to line_timer_stop()
+void line_timer_stop(uint8_t prev_ctrl);
+uint16_t line_timer_get(void); // wraps every ~5.4 seconds
+
 int u8_arraylist_len(uint8_t *list);
 int u16_arraylist_len(uint16_t *list);
 
 uint16_t crc16(const char *data, uint16_t len, uint16_t pad_len);
+uint16_t crc16_xmodem_update(uint16_t crc, uint8_t v);
+
+#define CRC32_INIT 0xFFFFFFFF
+// CRC32 of a fully erased 128 KB flash sector.
+#define CRC32_ERASED_SECTOR 0x154803CC
+// Builds the 256-entry table used by driver_crc32_*() on the stack (1 KB)
+// and passes it to func, returning its result.
+bool crc32_with_table(bool (*func)(const uint32_t *table, void *userdata), void *userdata);
 
 extern void crt0_restart();
@@ -15,202 +15,610 @@
  * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <ws.h>
 #include <wsx/zx0.h>
 #include "ww.h"
 #include "config.h"
+#include "deploy.h"
 #include "driver.h"
 #include "error.h"
 #include "input.h"
 #include "lang.h"
+#include "progress.h"
 #include "settings.h"
 #include "sram.h"
+#include "titledb.h"
 #include "ui.h"
+#include "unpack.h"
 #include "util.h"
 #include "ws/cartridge.h"
 #include "xmodem.h"
-#include "../obj/assets/athenabios_zx0.h"
+#include "../obj/assets/athenabios_cfz.h"
 
 #ifdef USE_SLOT_SYSTEM
-#define COPY_BOTH 0
-#define COPY_BIOS_ONLY 1
-#define COPY_OS_ONLY 2
+// Banks of a WW program, relative to its base bank: 8-D hold the file
+// system, E the OS and F the BIOS. The OS and BIOS share one 128 KB erase
+// sector, so the half which is kept is parked in the unused sector at 6-7
+// while the other one is replaced.
+#define WW_BANK_SCRATCH 0x6
+#define WW_BANK_OS 0xE
+#define WW_BANK_BIOS 0xF
+
+// the last 128 bytes of the OS area hold the footer
+#define WW_OS_MAX_SIZE 0xFF80
+
+// Decodes OS data in place; each 128-byte unit is encoded separately.
+void ww_decode_os(uint8_t *data, uint16_t len);
+
+static void ww_write_chunk(uint8_t *buffer, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) {
+    // erased flash reads as 0xFF already
+    uint16_t i = 0;
+    while (i < len && buffer[i] == 0xFF) i++;
+    if (i < len && !deploy_write_chunk(buffer, slot, (((uint32_t) bank) << 16) | offset, len)) {
+        error_critical(ERROR_CODE_WW_FLASH_FAILED, offset);
+    }
+}
 
-static void ww_copy_to_sram(uint16_t slot, uint16_t bank, uint8_t mode) {
+// Copies one 64 KB bank to another, erased one.
+static void ww_copy_bank(uint16_t slot, uint16_t src_bank, uint16_t dst_bank) {
     uint8_t buffer[1024];
 
-    ui_pbar_state_t pbar = {
-        .x = 0,
-        .y = 13,
-        .width = 27,
-        .step = 0,
-        .step_max = mode == COPY_BOTH ? 128 : 64
-    };
-    ui_pbar_init(&pbar);
+    for (uint16_t i = 0; i < 64; i++) {
+        driver_read_slot(buffer, slot, src_bank, i << 10, sizeof(buffer));
+        ww_write_chunk(buffer, slot, dst_bank, i << 10, sizeof(buffer));
+        progress_add(sizeof(buffer));
+    }
+}
 
+// Erases the OS and BIOS, except for the half in keep (0 = none).
+static void ww_erase(uint16_t slot, uint16_t bank, uint16_t keep) {
+    titledb_invalidate_bank(slot, bank);
     ui_reset_main_screen();
-    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_WW_INSTALL_START]);
+    ui_puts_centered(false, 2, 0, lang_keys[keep ? LK_UI_WW_BIOS_FLASH : LK_UI_WW_INSTALL_START]);
 
     driver_unlock();
-    for (int i = (mode == COPY_BIOS_ONLY ? 64 : 0); i < (mode == COPY_OS_ONLY ? 64 : 128); i++) {
-        ui_pbar_draw(&pbar);
-        ui_step_work_indicator();
-        pbar.step++;
+    if (keep) {
+        uint16_t scratch_bank = bank | WW_BANK_SCRATCH | (keep & 1);
+        progress_start(13, 131072);
+        driver_erase_bank(0, slot, bank | WW_BANK_SCRATCH);
+        ww_copy_bank(slot, bank | keep, scratch_bank);
+        driver_erase_bank(0, slot, bank | WW_BANK_OS);
+        ww_copy_bank(slot, scratch_bank, bank | keep);
+        progress_finish();
+    } else {
+        driver_erase_bank(0, slot, bank | WW_BANK_OS);
+    }
+    driver_lock();
+}
+
+// Writes the bundled AthenaBIOS to the erased BIOS bank. It is packed in
+// independent frames (see tools/zx0pack.py), unpacked one at a time.
+static void ww_flash_bios(uint16_t slot, uint16_t bank) {
+    uint8_t buffer[UNPACK_FRAME_SIZE];
+    const uint8_t __far* src = athenabios + 4;
+    uint16_t offset = 0;
+    uint32_t magic;
+
+    ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_WW_BIOS_UNPACK]);
+    progress_start(13, 65536);
 
-        driver_read_slot(buffer, slot, bank | 0xE | (i >> 6), (i << 10), sizeof(buffer));
+    driver_unlock();
+    while (true) {
+        uint16_t packed_len = src[0] | (src[1] << 8);
+        uint16_t raw_len = src[2] | (src[3] << 8);
+        if (packed_len == 0) {
+            break;
+        } else if (raw_len > sizeof(buffer)) {
+            error_critical(ERROR_CODE_WW_UNPACK_FAILED, offset);
+        }
 
-        ws_bank_ram_set(i >> 6);
-        memcpy(MK_FP(0x1000, i << 10), buffer, sizeof(buffer));
+        if (packed_len == raw_len) {
+            memcpy(buffer, src + 4, raw_len);
+        } else {
+            wsx_zx0_decompress(buffer, src + 4);
+        }
+        ww_write_chunk(buffer, slot, bank | WW_BANK_BIOS, offset, raw_len);
+        src += 4 + packed_len;
+        offset += raw_len;
+        progress_add(raw_len);
     }
+
+    driver_read_slot(&magic, slot, bank | WW_BANK_BIOS, 0xFFE0, sizeof(magic));
+    if (magic != WW_ATHENABIOS_MAGIC)
+        error_critical(ERROR_CODE_WW_UNPACK_FAILED, (uint16_t) magic);
     driver_lock();
-    
-    ui_clear_work_indicator();
+
+    progress_finish();
 }
 
-static void ww_flash_from_sram(uint16_t slot, uint16_t bank) {
+static uint8_t ww_transfer_entry_id(uint16_t slot, uint16_t bank) {
+    return (slot & 0x0F) | (bank & 0xF0);
+}
+
+// CRC16 of the first len bytes of the OS area
+static uint16_t ww_os_crc(uint16_t slot, uint16_t bank, uint16_t len) {
     uint8_t buffer[1024];
+    uint16_t offset = 0;
+    uint16_t crc = 0;
 
-    ui_pbar_state_t pbar = {
-        .x = 0,
-        .y = 13,
-        .width = 27,
-        .step_max = 128
-    };
-    ui_pbar_init(&pbar);
+    driver_unlock();
+    while (len > 0) {
+        uint16_t n = len > sizeof(buffer) ? sizeof(buffer) : len;
+        driver_read_slot(buffer, slot, bank | WW_BANK_OS, offset, n);
+        for (uint16_t i = 0; i < n; i++) {
+            crc = crc16_xmodem_update(crc, buffer[i]);
+        }
+        offset += n;
+        len -= n;
+    }
+    driver_lock();
+    return crc;
+}
+
+// The data received so far is still in flash, unless the OS has been
+// written to since.
+static bool ww_os_ask_resume(uint16_t slot, uint16_t bank) {
+    transfer_checkpoint_t *checkpoint = &settings_local.transfer;
 
+    if (checkpoint->type == TRANSFER_WW_OS && checkpoint->entry_id == ww_transfer_entry_id(slot, bank)
+        && checkpoint->done > 0 && checkpoint->done <= WW_OS_MAX_SIZE
+        && ww_os_crc(slot, bank, checkpoint->done) == checkpoint->crc) {
+        return ui_dialog_run(0, 1, LK_DIALOG_TRANSFER_RESUME, LK_DIALOG_YES_NO) == 0;
+    }
+    return false;
+}
+
+// Receives the OS straight into its erased bank; received blocks are
+// decoded and written while the next ones arrive.
+static void ww_download_os(uint16_t slot, uint16_t bank, bool resume) {
+    transfer_checkpoint_t *checkpoint = &settings_local.transfer;
+    uint8_t buffer[XMODEM_BLOCK_SIZE_1K];
+
+    titledb_invalidate_bank(slot, bank);
+    if (!resume) {
+        // Wait for user to initiate send
+        ui_reset_main_screen();
+        ui_puts_centered(false, 6, 0, lang_keys[LK_UI_WW_OS_DOWNLOAD_1]);
+        ui_puts_centered(false, 7, 0, lang_keys[LK_UI_WW_OS_DOWNLOAD_2]);
+        ui_puts_centered(false, 8, 0, lang_keys[LK_UI_WW_OS_DOWNLOAD_3]);
+        ui_puts_centered(false, 9, 0, lang_keys[LK_UI_WW_OS_DOWNLOAD_4]);
+
+        input_wait_key(KEY_A);
+    }
+
+    // Receive data
     ui_reset_main_screen();
-    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_WW_BIOS_FLASH]);
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_RECEIVE]);
+    ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
+    if (resume) {
+        ui_puts_centered(false, 5, 0, lang_keys[LK_UI_TRANSFER_RESUME_WAITING]);
+    }
 
-    driver_unlock();
-    driver_erase_bank(0, slot, bank | 0xE);
-    for (int i = 0; i < 128; i++) {
-        pbar.step++;
-        ui_pbar_draw(&pbar);
-
-        ws_bank_ram_set(i >> 6);
-        memcpy(buffer, MK_FP(0x1000, i << 10), sizeof(buffer));
-
-        ui_step_work_indicator();
-        driver_write_slot(buffer,       slot, bank | 0xE | (i >> 6), (i << 10),       256);
-        ui_step_work_indicator();
-        driver_write_slot(buffer + 256, slot, bank | 0xE | (i >> 6), (i << 10) + 256, 256);
-        ui_step_work_indicator();
-        driver_write_slot(buffer + 512, slot, bank | 0xE | (i >> 6), (i << 10) + 512, 256);
-        ui_step_work_indicator();
-        driver_write_slot(buffer + 768, slot, bank | 0xE | (i >> 6), (i << 10) + 768, 256);
-        ui_step_work_indicator();
-        driver_read_slot( buffer,       slot, bank | 0xE | (i >> 6), (i << 10),       sizeof(buffer));
-        if (memcmp(buffer, MK_FP(0x1000, i << 10), sizeof(buffer))) {
-            error_critical(ERROR_CODE_WW_FLASH_FAILED, i);
+    unpack_state_t unpack;
+    uint16_t received = resume ? checkpoint->done : 0;
+    bool active = true;
+    bool complete = false;
+    bool started = false;
+    bool compressed = false;
+
+    xmodem_open_default();
+    if ((!resume || deploy_send_resume_offset(received)) && xmodem_recv_start() == XMODEM_OK) {
+        unpack_init(&unpack);
+        driver_irq_passthrough = HWINT_SERIAL_RX;
+        driver_unlock();
+        while (active) {
+            uint16_t len = sizeof(buffer);
+            uint8_t result = unpack_recv_block(&unpack, buffer, &len);
+            switch (result) {
+                case XMODEM_COMPLETE:
+                    complete = (xmodem_recv_finish() == XMODEM_COMPLETE);
+                    active = false;
+                    break;
+                case XMODEM_SELF_CANCEL:
+                case XMODEM_CANCEL:
+                    active = false;
+                    break;
+                case XMODEM_OK:
+                    if (!started) {
+                        // a YMODEM sender tells us the size up front, but
+                        // that of a compressed upload is the packed one;
+                        // those cannot be resumed, and their frames may not
+                        // refer back to the data already written
+                        compressed = unpack_is_compressed(&unpack);
+                        if ((compressed && !unpack_is_independent(&unpack))
+                            || (!compressed && xmodem_file.size != XMODEM_SIZE_UNKNOWN && xmodem_file.size > WW_OS_MAX_SIZE)
+                            || (resume && (compressed || (checkpoint->size != XMODEM_SIZE_UNKNOWN && xmodem_file.size != checkpoint->size)))) {
+                            xmodem_recv_cancel();
+                            ui_tool_xmodem_ui_message(LK_UI_XMODEM_INVALID_FILE);
+                            active = false;
+                            break;
+                        }
+                        ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
+                        if (!resume) checkpoint->size = xmodem_file.size;
+                        started = true;
+                    }
+
+                    // blocks and frames both start on a 128-byte unit, so
+                    // they can be decoded as they arrive; then, drop the
+                    // padding past a known file size
+                    ww_decode_os(buffer, len);
+                    if (!compressed && xmodem_file.size < (uint32_t) received + len) {
+                        len = xmodem_file.size > received ? (xmodem_file.size - received) : 0;
+                    }
+
+                    if ((uint32_t) received + len > WW_OS_MAX_SIZE) {
+                        xmodem_recv_cancel();
+                        ui_tool_xmodem_ui_message(LK_UI_XMODEM_ERROR);
+                        active = false;
+                        break;
+                    }
+                    if (len > 0 && !deploy_write_chunk(buffer, slot, (((uint32_t) (bank | WW_BANK_OS)) << 16) | received, len)) {
+                        xmodem_recv_cancel();
+                        ui_tool_xmodem_ui_message(LK_UI_ROM_RECEIVE_VERIFY_FAILED);
+                        active = false;
+                        break;
+                    }
+                    received += len;
+                    ui_tool_xmodem_ui_step(received);
+                    break;
+                case XMODEM_ERROR:
+                    ui_tool_xmodem_ui_message(LK_UI_XMODEM_ERROR);
+                    active = false;
+                    break;
+            }
+        }
+
+        if (complete) {
+            // write footer; the rest of the OS area is left erased
+            uint16_t size_blocks = (received + 127) >> 7;
+            buffer[0x0] = 0xEA;
+            buffer[0x1] = 0x00;
+            buffer[0x2] = 0x00;
+            buffer[0x3] = 0x00;
+            buffer[0x4] = 0xE0;
+            buffer[0x5] = 0x00;
+            buffer[0x6] = size_blocks;
+            buffer[0x7] = size_blocks >> 8;
+            ww_write_chunk(buffer, slot, bank | WW_BANK_OS, 0xFFF0, 8);
         }
+        driver_lock();
+        driver_irq_passthrough = 0;
     }
-    driver_lock();
 
     ui_clear_work_indicator();
+    xmodem_close();
+
+    if (complete) {
+        if (checkpoint->type == TRANSFER_WW_OS) {
+            checkpoint->type = TRANSFER_NONE;
+            settings_mark_changed();
+        }
+    } else if (started && !compressed) {
+        // remember the blocks already in flash, so that the transfer can resume
+        checkpoint->type = TRANSFER_WW_OS;
+        checkpoint->entry_id = ww_transfer_entry_id(slot, bank);
+        checkpoint->done = received;
+        checkpoint->crc = ww_os_crc(slot, bank, received);
+        settings_mark_changed();
+        settings_save();
+    }
+
+    if (!complete) {
+        while (!xmodem_poll_exit()) cpu_halt();
+    }
 }
 
-static void ww_unpack_bios(void) {
-    ui_reset_main_screen();
-    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_WW_BIOS_UNPACK]);
+// File system
+
+// Files are stored back to back in banks 8-D, in 128-byte blocks. Each one
+// starts with the header of its .fx/.fr/.il file, which holds its directory
+// entry; the first block without the header's magic ends the list.
+#define WW_FS_BANK 0x8
+#define WW_FS_BLOCKS 3072 // 384 KB
+#define WW_FS_MAX_FILES 32
+#define WW_FS_UPLOAD 0xF0 // menu entry
+
+typedef struct __attribute__((packed)) {
+    char magic[4]; // "#!ws"
+    uint8_t reserved[60];
+    char name[16];
+    char info[24];
+    uint32_t loc;
+    uint32_t len;
+    uint16_t count;
+    uint16_t mode;
+    uint32_t mtime;
+    uint32_t il;
+    uint32_t resource;
+} ww_file_header_t;
+
+typedef struct {
+    uint16_t block;
+    uint16_t blocks; // including the header
+    char name[17];
+} ww_file_t;
+
+typedef struct {
+    ww_file_t files[WW_FS_MAX_FILES];
+    uint8_t count; // listed files; the area may hold more
+    uint16_t end; // first free block
+} ww_fs_t;
+
+static inline uint16_t ww_fs_bank(uint16_t bank, uint16_t block) {
+    return bank | (WW_FS_BANK + (block >> 9));
+}
+
+static inline uint32_t ww_fs_pos(uint16_t bank, uint16_t block) {
+    return (((uint32_t) (bank | WW_FS_BANK)) << 16) + (((uint32_t) block) << 7);
+}
+
+// The far pointer to the data of the file whose header is at block, which
+// the OS reads in place: banks 4-F are mapped at segments 4000-F000.
+static inline uint32_t ww_fs_loc(uint16_t block) {
+    return ((uint32_t) ((WW_FS_BANK << 12) + ((block + 1) << 3))) << 16;
+}
 
-    ws_bank_ram_set(1);
-    wsx_zx0_decompress(MK_FP(0x1000, 0x0000), athenabios);
-    if (*((uint32_t __far*) MK_FP(0x1000, 0xFFE0)) != WW_ATHENABIOS_MAGIC)
-        error_critical(ERROR_CODE_WW_UNPACK_FAILED, *((uint16_t __far*) MK_FP(0x1000, 0xFFE0)));
+// Blocks taken up by the file, or 0 if this is not a file header.
+static uint16_t ww_fs_header_blocks(const ww_file_header_t *header) {
+    if (memcmp(header->magic, "#!ws", 4) || header->len > ((uint32_t) (WW_FS_BLOCKS - 1) << 7))
+        return 0;
+    return 1 + ((header->len + 127) >> 7);
 }
 
-static bool ww_download_os() {
-    uint8_t buffer[128];
+static void ww_fs_scan(uint16_t slot, uint16_t bank, ww_fs_t *fs) {
+    ww_file_header_t header;
+    uint16_t block = 0;
 
+    fs->count = 0;
+    driver_unlock();
+    while (block < WW_FS_BLOCKS) {
+        driver_read_slot(&header, slot, ww_fs_bank(bank, block), block << 7, sizeof(header));
+        uint16_t blocks = ww_fs_header_blocks(&header);
+        if (blocks == 0 || blocks > WW_FS_BLOCKS - block)
+            break;
+        if (fs->count < WW_FS_MAX_FILES) {
+            ww_file_t *file = &fs->files[fs->count++];
+            file->block = block;
+            file->blocks = blocks;
+            memcpy(file->name, header.name, 16);
+            file->name[16] = 0;
+        }
+        block += blocks;
+    }
+    driver_lock();
+    fs->end = block;
+}
+
+// Reads blocks as they were before the sector in parked was moved to the
+// scratch sector; those past end read as erased.
+static void ww_fs_read_old(uint8_t *buffer, uint16_t slot, uint16_t bank, uint16_t block, uint16_t count, uint16_t parked, uint16_t end) {
+    while (count > 0) {
+        if (block >= end) {
+            memset(buffer, 0xFF, count << 7);
+            return;
+        }
+        // up to the end of the 64 KB bank
+        uint16_t n = 512 - (block & 511);
+        if (n > count) n = count;
+        if (n > end - block) n = end - block;
+        uint16_t read_bank = ((block >> 10) == parked) ? (bank | WW_BANK_SCRATCH | ((block >> 9) & 1)) : ww_fs_bank(bank, block);
+        driver_read_slot(buffer, slot, read_bank, block << 7, n << 7);
+        buffer += n << 7;
+        block += n;
+        count -= n;
+    }
+}
+
+// Removes count blocks from start on, moving the files up to end down in
+// their place. Each 128 KB sector from the one holding start is parked in
+// the scratch sector, erased and written back with its new contents; the
+// headers of the moved files get their new location.
+static void ww_fs_remove(uint16_t slot, uint16_t bank, uint16_t start, uint16_t count, uint16_t end) {
+    uint8_t buffer[1024];
+    uint16_t moved = start; // header of the next moved file, at its new block
+    uint16_t sector_first = start >> 10;
+    uint16_t sector_last = (end - 1) >> 10;
+
+    titledb_invalidate_bank(slot, bank);
     ui_reset_main_screen();
+    ui_puts_centered(false, 2, 0, lang_keys[LK_UI_WW_BIOS_FLASH]);
+    progress_start(13, ((uint32_t) (sector_last + 1 - sector_first)) << 18);
 
-    // Clear OS SRAM area
-    ws_bank_ram_set(0);
-    memset(MK_FP(0x1000, 0x0000), 0xFF, 16384);
-    memset(MK_FP(0x1000, 0x4000), 0xFF, 16384);
-    memset(MK_FP(0x1000, 0x8000), 0xFF, 16384);
-    memset(MK_FP(0x1000, 0xC000), 0xFF, 16384);
+    driver_unlock();
+    for (uint16_t sector = sector_first; sector <= sector_last; sector++) {
+        uint16_t sector_bank = ww_fs_bank(bank, sector << 10);
+        driver_erase_bank(0, slot, bank | WW_BANK_SCRATCH);
+        ww_copy_bank(slot, sector_bank, bank | WW_BANK_SCRATCH);
+        ww_copy_bank(slot, sector_bank + 1, bank | WW_BANK_SCRATCH | 1);
+        driver_erase_bank(0, slot, sector_bank);
+
+        for (uint16_t block = sector << 10; block < ((sector + 1) << 10); block += 8) {
+            // blocks before start stay, the ones after it come from further on
+            uint16_t kept = block < start ? (start - block) : 0;
+            if (kept > 8) kept = 8;
+            ww_fs_read_old(buffer, slot, bank, block, kept, sector, end);
+            ww_fs_read_old(buffer + (kept << 7), slot, bank, block + kept + count, 8 - kept, sector, end);
+            while (moved >= block && moved < block + 8 && moved < end - count) {
+                ww_file_header_t *header = (ww_file_header_t*) (buffer + ((moved - block) << 7));
+                uint16_t blocks = ww_fs_header_blocks(header);
+                if (blocks == 0) {
+                    moved = end;
+                    break;
+                }
+                header->loc = ww_fs_loc(moved);
+                moved += blocks;
+            }
+            ww_write_chunk(buffer, slot, ww_fs_bank(bank, block), block << 7, sizeof(buffer));
+            progress_add(sizeof(buffer));
+        }
+    }
+    driver_lock();
 
-    // Wait for user to initiate send
-    ui_puts_centered(false, 6, 0, lang_keys[LK_UI_WW_OS_DOWNLOAD_1]);
-    ui_puts_centered(false, 7, 0, lang_keys[LK_UI_WW_OS_DOWNLOAD_2]);
-    ui_puts_centered(false, 8, 0, lang_keys[LK_UI_WW_OS_DOWNLOAD_3]);
-    ui_puts_centered(false, 9, 0, lang_keys[LK_UI_WW_OS_DOWNLOAD_4]);
+    progress_finish();
+}
 
-    input_wait_key(KEY_A);
+// Appends a file received over XMODEM, replacing the one of the same name.
+static void ww_fs_upload(uint16_t slot, uint16_t bank, const ww_fs_t *fs) {
+    ww_file_header_t header;
+    uint8_t buffer[XMODEM_BLOCK_SIZE_1K];
+    unpack_state_t unpack;
+    uint32_t size = 0;
+    uint32_t received = 0;
+    uint32_t written = 0; // including a chunk which failed to verify
+    bool active = true;
+    bool complete = false;
+    bool started = false;
 
-    // Receive data
     ui_reset_main_screen();
     ui_puts_centered(false, 2, 0, lang_keys[LK_UI_XMODEM_RECEIVE]);
     ui_puts_centered(false, 3, 0, lang_keys[LK_UI_XMODEM_PRESS_B_TO_CANCEL]);
 
-    uint8_t __far* sram_ptr = MK_FP(0x1000, 0x0000);
-    uint16_t sram_incrs = 0;
-    bool active = true;
-
     xmodem_open_default();
     if (xmodem_recv_start() == XMODEM_OK) {
+        titledb_invalidate_bank(slot, bank);
+        unpack_init(&unpack);
+        driver_irq_passthrough = HWINT_SERIAL_RX;
+        driver_unlock();
         while (active) {
-            uint8_t result = xmodem_recv_block(buffer);
+            uint16_t len = sizeof(buffer);
+            uint16_t skip = 0;
+            uint8_t result = unpack_recv_block(&unpack, buffer, &len);
             switch (result) {
                 case XMODEM_COMPLETE:
-                    return true;
+                    complete = (xmodem_recv_finish() == XMODEM_COMPLETE) && started && received == size;
+                    if (!complete) {
+                        ui_tool_xmodem_ui_message(LK_UI_XMODEM_ERROR);
+                    }
+                    active = false;
+                    break;
                 case XMODEM_SELF_CANCEL:
                 case XMODEM_CANCEL:
                     active = false;
                     break;
-                case XMODEM_OK: {
-                    if (sram_incrs == 0) {
+                case XMODEM_OK:
+                    if (!started) {
+                        // the header is written last, so that an interrupted
+                        // upload does not show up as a file
+                        uint16_t blocks = 0;
+                        if (len >= sizeof(header)) {
+                            memcpy(&header, buffer, sizeof(header));
+                            blocks = ww_fs_header_blocks(&header);
+                        }
+                        if ((unpack_is_compressed(&unpack) && !unpack_is_independent(&unpack))
+                            || blocks == 0 || blocks > WW_FS_BLOCKS - fs->end) {
+                            xmodem_recv_cancel();
+                            ui_tool_xmodem_ui_message(blocks == 0 ? LK_UI_XMODEM_INVALID_FILE : LK_UI_WW_FS_FULL);
+                            active = false;
+                            break;
+                        }
                         ui_tool_xmodem_ui_message(LK_UI_XMODEM_IN_PROGRESS);
-                    }
-                    // Write to SRAM
-                    uint8_t prev_b = 0xFF;
-                    for (int i = 0; i < 128; i++) {
-                        sram_ptr[i] = buffer[i] ^ prev_b;
-                        prev_b = buffer[i];
+                        size = sizeof(header) + header.len;
+                        received = skip = sizeof(header);
+                        started = true;
                     }
 
-                    // Step, acknowledge packet
-                    sram_incrs++;
-                    if (sram_incrs < 512) {
-                        ui_tool_xmodem_ui_step((uint32_t) sram_incrs << 7);
-                        sram_ptr += 128;
+                    // drop the padding past the end of the file
+                    len -= skip;
+                    if (len > size - received) len = size - received;
+                    if (len > 0) written = received + len;
+                    if (len > 0 && !deploy_write_chunk(buffer + skip, slot, ww_fs_pos(bank, fs->end) + received, len)) {
+                        xmodem_recv_cancel();
+                        ui_tool_xmodem_ui_message(LK_UI_ROM_RECEIVE_VERIFY_FAILED);
+                        active = false;
                         break;
                     }
-                }
-                // fall through to XMODEM_ERROR
+                    received += len;
+                    ui_tool_xmodem_ui_step(received);
+                    break;
                 case XMODEM_ERROR:
                     ui_tool_xmodem_ui_message(LK_UI_XMODEM_ERROR);
                     active = false;
                     break;
             }
         }
+
+        if (complete) {
+            header.loc = ww_fs_loc(fs->end);
+            written = size;
+            if (!deploy_write_chunk((uint8_t*) &header, slot, ww_fs_pos(bank, fs->end), sizeof(header))) {
+                ui_tool_xmodem_ui_message(LK_UI_ROM_RECEIVE_VERIFY_FAILED);
+                complete = false;
+            }
+        }
+        driver_lock();
+        driver_irq_passthrough = 0;
     }
 
     ui_clear_work_indicator();
     xmodem_close();
-    while (!xmodem_poll_exit()) cpu_halt();
 
-    // clear remaining data
-    uint16_t size_blocks = sram_incrs;
-    for (; sram_incrs < 512; sram_incrs++) {
-         memset(sram_ptr, 0xFF, 128);
-         sram_ptr += 128;
+    uint16_t end = fs->end + ((written + 127) >> 7);
+    if (complete) {
+        for (uint8_t i = 0; i < fs->count; i++) {
+            if (!memcmp(fs->files[i].name, header.name, 16)) {
+                ww_fs_remove(slot, bank, fs->files[i].block, fs->files[i].blocks, end);
+                break;
+            }
+        }
+    } else {
+        while (!xmodem_poll_exit()) cpu_halt();
+        if (written > 0) {
+            // the blocks written so far are no longer erased
+            ww_fs_remove(slot, bank, fs->end, end - fs->end, end);
+        }
     }
+}
 
-    // write footer
-    uint8_t __far* sram_footer = MK_FP(0x1000, 0xFFF0);
-    sram_footer[0x0] = 0xEA;
-    sram_footer[0x1] = 0x00;
-    sram_footer[0x2] = 0x00;
-    sram_footer[0x3] = 0x00;
-    sram_footer[0x4] = 0xE0;
-    sram_footer[0x5] = 0x00;
-    sram_footer[0x6] = size_blocks;
-    sram_footer[0x7] = size_blocks >> 8;
+static void ww_ui_files_build_line(uint8_t entry_id, void *userdata, char *buf, int buf_len, char *buf_right, int buf_right_len) {
+    const ww_fs_t *fs = (const ww_fs_t*) userdata;
 
-    return false;
+    if (entry_id == WW_FS_UPLOAD) {
+        strncpy(buf, lang_keys[LK_UI_WW_FS_UPLOAD], buf_len);
+    } else {
+        strncpy(buf, fs->files[entry_id].name, buf_len);
+        snprintf(buf_right, buf_right_len, lang_keys[LK_UI_WW_FS_FILE_SIZE], (fs->files[entry_id].blocks + 7) >> 3);
+    }
+}
+
+void ww_ui_manage_files(uint16_t slot, uint16_t bank) {
+    ww_fs_t fs;
+    uint8_t menu_list[WW_FS_MAX_FILES + 2];
+
+    if (slot == driver_get_launch_slot())
+        return;
+
+    while (true) {
+        ww_fs_scan(slot, bank, &fs);
+
+        ui_reset_main_screen();
+        ui_menu_state_t menu = {
+            .list = menu_list,
+            .build_line_func = ww_ui_files_build_line,
+            .build_line_data = &fs,
+            .flags = MENU_B_AS_BACK
+        };
+        uint8_t i = 0;
+        menu_list[i++] = WW_FS_UPLOAD;
+        for (uint8_t k = 0; k < fs.count; k++) {
+            menu_list[i++] = k;
+        }
+        menu_list[i++] = MENU_ENTRY_END;
+        ui_menu_init(&menu);
+
+        uint16_t result = ui_menu_select(&menu);
+        if (result == WW_FS_UPLOAD) {
+            ww_fs_upload(slot, bank, &fs);
+        } else if (result < fs.count) {
+            if (ui_dialog_run(0, 1, LK_DIALOG_CONFIRM, LK_DIALOG_YES_NO) == 0) {
+                ww_fs_remove(slot, bank, fs.files[result].block, fs.files[result].blocks, fs.end);
+            }
+        } else {
+            return;
+        }
+    }
 }
 
 void ww_ui_erase_userdata(uint16_t slot, uint16_t bank) {
@@ -218,6 +626,7 @@ void ww_ui_erase_userdata(uint16_t slot, uint16_t bank) {
         return;
 
     sram_unload();
+    titledb_invalidate_bank(slot, bank);
 
     ui_reset_main_screen();
     ui_puts_centered(false, 2, 0, lang_keys[LK_UI_MSG_ERASE_SRAM]);
@@ -239,31 +648,30 @@ void ww_ui_install_full(uint16_t slot, uint16_t bank) {
     if (slot == driver_get_launch_slot())
         return;
 
-    sram_unload();
-    ww_unpack_bios();
-    if (!ww_download_os())
-        return;
-    ww_flash_from_sram(slot, bank);
+    bool resume = ww_os_ask_resume(slot, bank);
+    if (!resume) {
+        ww_erase(slot, bank, 0);
+        ww_flash_bios(slot, bank);
+    }
+    ww_download_os(slot, bank, resume);
 }
 
 void ww_ui_install_bios(uint16_t slot, uint16_t bank) {
     if (slot == driver_get_launch_slot())
         return;
-    
-    sram_unload();
-    ww_copy_to_sram(slot, bank, COPY_OS_ONLY);
-    ww_unpack_bios();
-    ww_flash_from_sram(slot, bank);
+
+    ww_erase(slot, bank, WW_BANK_OS);
+    ww_flash_bios(slot, bank);
 }
 
 void ww_ui_install_os(uint16_t slot, uint16_t bank) {
     if (slot == driver_get_launch_slot())
         return;
-    
-    sram_unload();
-    ww_copy_to_sram(slot, bank, COPY_BIOS_ONLY);
-    if (!ww_download_os())
-        return;
-    ww_flash_from_sram(slot, bank);
+
+    bool resume = ww_os_ask_resume(slot, bank);
+    if (!resume) {
+        ww_erase(slot, bank, WW_BANK_BIOS);
+    }
+    ww_download_os(slot, bank, resume);
 }
 #endif
@@ -30,3 +30,5 @@ void ww_ui_erase_userdata(uint16_t slot, uint16_t bank);
 void ww_ui_install_full(uint16_t slot, uint16_t bank);
 void ww_ui_install_bios(uint16_t slot, uint16_t bank);
 void ww_ui_install_os(uint16_t slot, uint16_t bank);
+// Lists the files in the WW file system, to upload or delete single ones.
+void ww_ui_manage_files(uint16_t slot, uint16_t bank);
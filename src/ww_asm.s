@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * CartFriend is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * CartFriend is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with CartFriend. If not, see <https://www.gnu.org/licenses/>. 
+ */
+
+#include <wonderful.h>
+#include "config.h"
+
+	.arch	i186
+	.code16
+	.intel_syntax noprefix
+
+#ifdef USE_SLOT_SYSTEM
+	// ww_decode_os(uint8_t *data, uint16_t len)
+	// FreyaOS update files are encoded in 128-byte units, each byte XORed
+	// with the encoded byte before it (0xFF at the start of a unit).
+	// len is rounded up to whole units.
+	.global ww_decode_os
+	.align 2
+ww_decode_os:
+	push	si
+	push	di
+	push	es
+	push	bx
+
+	// ds:si = es:di = data, dx = units
+	mov si, ax
+	mov di, ax
+	push ds
+	pop es
+	add dx, 127
+	shr dx, 7
+	jz ww_decode_os_done
+	cld
+
+	.align 2, 0x90
+ww_decode_os_unit:
+	mov bl, 0xFF // previous encoded byte
+	mov cx, 16 // 16 * 4 words = 128 bytes
+ww_decode_os_loop:
+.rept 4
+	// out = word ^ ((word << 8) | previous)
+	lodsw
+	mov bh, al
+	xor ax, bx
+	stosw
+	xor bh, ah // b0 ^ (b1 ^ b0) = b1
+	mov bl, bh
+.endr
+	loop ww_decode_os_loop
+	dec dx
+	jnz ww_decode_os_unit
+
+ww_decode_os_done:
+	pop	bx
+	pop	es
+	pop	di
+	pop	si
+	IA16_RET
+#endif
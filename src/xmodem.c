@@ -25,20 +25,46 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <wonderful.h>
 #include "input.h"
+#include "serial.h"
 #include "ui.h"
 #include "util.h"
 #include "xmodem.h"
 
 #define SOH 1
+#define STX 2
 #define EOT 4
 #define ACK 6
 #define NAK 21
 #define CAN 24
+#define CRC_START 'C'
+#define SUB 26
+
+// in VBlank ticks (~75 per second)
+#define XMODEM_TIMEOUT_BYTE  75
+#define XMODEM_TIMEOUT_START 225
+#define XMODEM_TIMEOUT_BLOCK 750
+#define XMODEM_TIMEOUT_PURGE 8
+
+// number of 'C' requests before falling back to checksum mode
+#define XMODEM_CRC_ATTEMPTS 3
+
+#define XMODEM_DUPLICATE 0xFF /* previous block sent again */
+#define XMODEM_HEADER    0xFE /* YMODEM block 0 */
+#define XMODEM_TOO_LARGE 0xFD /* block does not fit the buffer */
+
+extern volatile uint16_t vbl_ticks;
 
 static uint8_t xmodem_idx;
 static uint8_t xmodem_retry;
+static bool xmodem_started;
+static bool xmodem_crc;
+static uint8_t xmodem_crc_attempts;
+static bool xmodem_batch;
+xmodem_stats_t xmodem_stats;
+xmodem_file_t xmodem_file;
 
 bool xmodem_poll_exit(void) {
 	input_update();
@@ -47,105 +73,297 @@ bool xmodem_poll_exit(void) {
 
 void xmodem_open(uint8_t baudrate) {
 	ws_serial_open(baudrate);
-	ws_hwint_set_default_handler_serial_rx();
+	serial_init_rx_buffered();
+	serial_init_buffered();
+	xmodem_stats.blocks = 0;
+	xmodem_stats.retries = 0;
 }
 
 void xmodem_close(void) {
+	serial_flush_buffered();
+	serial_close_rx_buffered();
 	ws_serial_close();
 }
 
-// call after SOH
-static uint8_t xmodem_read_block(uint8_t __far* block) {
-	uint8_t idx = ws_serial_getc();
-	if (idx != xmodem_idx) {
-		return XMODEM_CANCEL;
+// drop incoming data until the line goes quiet
+static void xmodem_purge(void) {
+	while (serial_getc_buffered_timeout(XMODEM_TIMEOUT_PURGE) >= 0);
+}
+
+// call after SOH/STX
+static uint8_t xmodem_read_block(uint8_t __far* block, uint16_t size, uint16_t capacity) {
+	int16_t idx = serial_getc_buffered_timeout(XMODEM_TIMEOUT_BYTE);
+	int16_t idx_inv = serial_getc_buffered_timeout(XMODEM_TIMEOUT_BYTE);
+	if (idx < 0 || idx_inv < 0 || (idx ^ 0xFF) != idx_inv) {
+		return XMODEM_ERROR;
 	}
-	uint8_t idx_inv = ws_serial_getc();
-	if ((idx ^ 0xFF) != idx_inv) {
+	// YMODEM: a batch may start with block 0 instead of block 1
+	bool header = !xmodem_started && idx == 0 && (xmodem_idx == 0 || !xmodem_batch);
+	bool duplicate = !header && (xmodem_started || xmodem_batch) && ((uint8_t) (idx + 1)) == xmodem_idx;
+	if (idx != xmodem_idx && !header && !duplicate) {
 		return XMODEM_CANCEL;
 	}
+	// only the start of the header, holding the name and size, is kept
+	uint16_t store = size;
+	if (header) {
+		store = XMODEM_BLOCK_SIZE;
+	} else if (size > capacity && !duplicate) {
+		return XMODEM_TOO_LARGE;
+	}
 
-	uint8_t checksum = 0;
-	for (uint16_t i = 0; i < XMODEM_BLOCK_SIZE; i++) {
-		uint8_t v = ws_serial_getc();
-		checksum += v;
-		if (block != NULL) { 
+	uint16_t checksum = 0;
+	for (uint16_t i = 0; i < size; i++) {
+		int16_t v = serial_getc_buffered_timeout(XMODEM_TIMEOUT_BYTE);
+		if (v < 0) {
+			return XMODEM_ERROR;
+		}
+		if (xmodem_crc) {
+			checksum = crc16_xmodem_update(checksum, v);
+		} else {
+			checksum += v;
+		}
+		// don't overwrite the block the caller already has
+		if (block != NULL && !duplicate && i < store) {
 			block[i] = v;
 		}
 	}
 
-	uint8_t checksum_actual = ws_serial_getc();
-	return (checksum == checksum_actual) ? XMODEM_OK : XMODEM_ERROR;
+	int16_t checksum_actual = serial_getc_buffered_timeout(XMODEM_TIMEOUT_BYTE);
+	if (xmodem_crc) {
+		int16_t checksum_low = serial_getc_buffered_timeout(XMODEM_TIMEOUT_BYTE);
+		if (checksum_actual < 0 || checksum_low < 0) {
+			return XMODEM_ERROR;
+		}
+		checksum_actual = (checksum_actual << 8) | checksum_low;
+	} else {
+		checksum &= 0xFF;
+	}
+	if (checksum != (uint16_t) checksum_actual) {
+		return XMODEM_ERROR;
+	}
+	return duplicate ? XMODEM_DUPLICATE : (header ? XMODEM_HEADER : XMODEM_OK);
 }
 
-static void xmodem_write_block(const uint8_t __far* block) {
-	ws_serial_putc(SOH);
-	ws_serial_putc(xmodem_idx);
-	ws_serial_putc(xmodem_idx ^ 0xFF);
+static inline void xmodem_putc(uint8_t v, bool buffered) {
+	if (buffered) {
+		serial_putc_buffered(v);
+	} else {
+		ws_serial_putc(v);
+	}
+}
 
-	uint8_t checksum = 0;
-	for (uint16_t i = 0; i < XMODEM_BLOCK_SIZE; i++) {
-		ws_serial_putc(block[i]);
-		checksum += block[i];
+static void xmodem_write_block(const uint8_t __far* block, uint16_t len, uint16_t size, bool buffered) {
+	xmodem_putc(size == XMODEM_BLOCK_SIZE_1K ? STX : SOH, buffered);
+	xmodem_putc(xmodem_idx, buffered);
+	xmodem_putc(xmodem_idx ^ 0xFF, buffered);
+
+	uint16_t checksum = 0;
+	for (uint16_t i = 0; i < size; i++) {
+		uint8_t v = i < len ? block[i] : SUB;
+		xmodem_putc(v, buffered);
+		if (xmodem_crc) {
+			checksum = crc16_xmodem_update(checksum, v);
+		} else {
+			checksum += v;
+		}
 	}
 
-	ws_serial_putc(checksum);
+	if (xmodem_crc) {
+		xmodem_putc(checksum >> 8, buffered);
+	}
+	xmodem_putc(checksum, buffered);
 }
 
 uint8_t xmodem_recv_start(void) {
 	xmodem_idx = 1;
-	xmodem_retry = 1;
+	xmodem_retry = 0;
+	xmodem_started = false;
+	xmodem_crc = true;
+	xmodem_crc_attempts = 0;
+	xmodem_batch = false;
+	xmodem_file.name[0] = 0;
+	xmodem_file.size = XMODEM_SIZE_UNKNOWN;
 
 	return XMODEM_OK;
 }
 
-uint8_t xmodem_recv_block(uint8_t __far* block) {
-recv_block_start:
-	ws_serial_putc(xmodem_retry ? NAK : ACK);
-	cpu_irq_disable();
+/**
+ * Blocks are acknowledged as soon as they have been verified, before
+ * returning to the caller. While the caller processes block N, the sender
+ * is already transmitting block N+1 into the serial RX ring buffer.
+ */
+static uint8_t xmodem_recv(uint8_t __far* block, uint16_t *len) {
+	uint16_t capacity = *len;
+	if (!xmodem_started) {
+		ws_serial_putc(xmodem_crc ? CRC_START : NAK);
+	}
+	uint16_t ticks_start = vbl_ticks;
 
 	while (1) {
 		if (xmodem_poll_exit()) {
-			cpu_irq_enable();
 			return XMODEM_SELF_CANCEL;
 		}
 
-		int16_t r = ws_serial_getc_nonblock();
-		if (r >= 0) {
-			if (r == CAN) {
-				cpu_irq_enable();
-				return XMODEM_CANCEL;
-			} else if (r == EOT) {
-				ws_serial_putc(ACK);
-				cpu_irq_enable();
-				return XMODEM_COMPLETE;
-			} else if (r == SOH) {
-				uint8_t result = xmodem_read_block(block);
-				if (result == XMODEM_OK) {
-					xmodem_idx++;
-					xmodem_retry = 0;
-					cpu_irq_enable();
-					return XMODEM_OK;
-				} else if (result == XMODEM_ERROR) {
-					goto recv_block_error;
-				} else {
-					ws_serial_putc(CAN);
-					cpu_irq_enable();
-					return XMODEM_ERROR;
+		int16_t r = serial_getc_buffered_nonblock();
+		if (r < 0) {
+			uint16_t ticks = vbl_ticks - ticks_start;
+			if (!xmodem_started && ticks >= XMODEM_TIMEOUT_START) {
+				// keep asking until the sender is ready
+				if (xmodem_crc && !xmodem_batch && (++xmodem_crc_attempts) >= XMODEM_CRC_ATTEMPTS) {
+					xmodem_crc = false;
 				}
+				ws_serial_putc(xmodem_crc ? CRC_START : NAK);
+				ticks_start = vbl_ticks;
+			} else if (ticks >= XMODEM_TIMEOUT_BLOCK) {
+				goto recv_block_error;
+			}
+			cpu_halt();
+		} else if (r == CAN) {
+			return XMODEM_CANCEL;
+		} else if (r == EOT) {
+			ws_serial_putc(ACK);
+			return XMODEM_COMPLETE;
+		} else if (r == SOH || r == STX) {
+			uint16_t size = (r == STX) ? XMODEM_BLOCK_SIZE_1K : XMODEM_BLOCK_SIZE;
+			uint8_t result = xmodem_read_block(block, size, capacity);
+			if (result == XMODEM_HEADER) {
+				// the sender waits for another 'C' before the first data block
+				ws_serial_putc(ACK);
+				xmodem_idx = 1;
+				xmodem_retry = 0;
+				return XMODEM_HEADER;
+			} else if (result == XMODEM_OK) {
+				ws_serial_putc(ACK);
+				*len = size;
+				xmodem_started = true;
+				xmodem_idx++;
+				xmodem_retry = 0;
+				xmodem_stats.blocks++;
+				return XMODEM_OK;
+			} else if (result == XMODEM_DUPLICATE) {
+				// our ACK was lost
+				ws_serial_putc(ACK);
+				ticks_start = vbl_ticks;
+			} else if (result == XMODEM_ERROR) {
+				goto recv_block_error;
 			} else {
+				// out of sequence, or too large for the buffer
+				ws_serial_putc(CAN);
+				return XMODEM_ERROR;
+			}
+		} else {
 recv_block_error:
-				xmodem_retry++;
-				if (xmodem_retry > 10) {
-					cpu_irq_enable();
-					return XMODEM_ERROR;
-				}
-				goto recv_block_start;
+			xmodem_stats.retries++;
+			if (++xmodem_retry > 10) {
+				return XMODEM_ERROR;
 			}
+			xmodem_purge();
+			ws_serial_putc((xmodem_crc && !xmodem_started) ? CRC_START : NAK);
+			ticks_start = vbl_ticks;
+		}
+	}
+}
+
+// block 0 holds the NUL-terminated file name, followed by its size in decimal
+static void xmodem_parse_header(const uint8_t __far* block) {
+	uint8_t i = 0;
+	while (i < XMODEM_BLOCK_SIZE && block[i] != 0) {
+		if (i < sizeof(xmodem_file.name) - 1) {
+			xmodem_file.name[i] = block[i];
+		}
+		i++;
+	}
+	xmodem_file.name[i < sizeof(xmodem_file.name) - 1 ? i : sizeof(xmodem_file.name) - 1] = 0;
+
+	xmodem_file.size = XMODEM_SIZE_UNKNOWN;
+	i++;
+	if (i < XMODEM_BLOCK_SIZE && block[i] >= '0' && block[i] <= '9') {
+		xmodem_file.size = 0;
+		while (i < XMODEM_BLOCK_SIZE && block[i] >= '0' && block[i] <= '9') {
+			xmodem_file.size = (xmodem_file.size * 10) + (block[i++] - '0');
+		}
+	}
+}
+
+/**
+ * len holds the space available in block on entry (at least
+ * XMODEM_BLOCK_SIZE) and the size of the received block on return.
+ *
+ * A YMODEM header preceding the first block is handled transparently;
+ * its contents are available in xmodem_file afterwards.
+ */
+uint8_t xmodem_recv_block(uint8_t __far* block, uint16_t *len) {
+	while (true) {
+		uint16_t block_len = *len;
+		uint8_t result = xmodem_recv(block, &block_len);
+		if (result != XMODEM_HEADER) {
+			*len = block_len;
+			return result;
+		}
+		xmodem_parse_header(block);
+		if (xmodem_file.name[0] == 0) {
+			// empty batch
+			return XMODEM_COMPLETE;
+		}
+		xmodem_batch = true;
+	}
+}
+
+/**
+ * Waits for a YMODEM header without receiving any file data, for callers
+ * which need to know the file size up front. Plain XMODEM senders are
+ * not supported here.
+ * Returns XMODEM_OK with xmodem_file updated, or XMODEM_COMPLETE if the
+ * batch has ended.
+ */
+uint8_t xmodem_recv_header(void) {
+	uint8_t buffer[XMODEM_BLOCK_SIZE];
+	uint16_t len = sizeof(buffer);
+
+	xmodem_idx = 0;
+	xmodem_started = false;
+	xmodem_batch = true;
+	uint8_t result = xmodem_recv(buffer, &len);
+	if (result == XMODEM_HEADER) {
+		xmodem_parse_header(buffer);
+		if (xmodem_file.name[0] == 0) {
+			xmodem_batch = false;
+			return XMODEM_COMPLETE;
 		}
+		return XMODEM_OK;
+	}
+	return result;
+}
+
+/**
+ * Call after XMODEM_COMPLETE to wait for the next file of a YMODEM batch.
+ * Returns XMODEM_OK if another file follows, with xmodem_file updated,
+ * or XMODEM_COMPLETE once the batch has ended.
+ */
+uint8_t xmodem_recv_next_file(void) {
+	if (!xmodem_batch) {
+		return XMODEM_COMPLETE;
 	}
+	return xmodem_recv_header();
+}
 
-	cpu_irq_enable();
+/**
+ * Call after XMODEM_COMPLETE if no further files are wanted. Ends a YMODEM
+ * batch, cancelling any files which remain in it.
+ */
+uint8_t xmodem_recv_finish(void) {
+	uint8_t result = xmodem_recv_next_file();
+	if (result == XMODEM_OK) {
+		xmodem_recv_cancel();
+		return XMODEM_SELF_CANCEL;
+	}
+	return result;
+}
+
+void xmodem_recv_cancel(void) {
+	ws_serial_putc(CAN);
+	ws_serial_putc(CAN);
+	xmodem_batch = false;
 }
 
 uint8_t xmodem_send_start(void) {
@@ -153,54 +371,161 @@ uint8_t xmodem_send_start(void) {
 	xmodem_retry = 0;
 
 	while (!xmodem_poll_exit()) {
-		int16_t r = ws_serial_getc_nonblock();
+		int16_t r = serial_getc_buffered_nonblock();
 		if (r >= 0) {
 			if (r == CAN) {
 				return XMODEM_CANCEL;
-			} else if (r == NAK) {
+			} else if (r == NAK || r == CRC_START) {
+				xmodem_crc = (r == CRC_START);
 				return XMODEM_OK;
 			}
 		}
 
-		ws_hwint_enable(HWINT_SERIAL_RX);
 		cpu_halt();
 	}
 	return XMODEM_SELF_CANCEL;
 }
 
-uint8_t xmodem_send_block(const uint8_t __far* block) {
-	uint8_t retries = 10;
-send_write_again:
-	if ((retries--) == 0) return XMODEM_ERROR;
-	xmodem_write_block(block);
+// call after writing a block; resends it until it is acknowledged, or if
+// there is no reply in time
+static uint8_t xmodem_send_wait(const uint8_t __far* block, uint16_t len, uint16_t size, bool buffered) {
+	uint8_t retries = 9;
+	uint16_t ticks_start = vbl_ticks;
 
 	while (!xmodem_poll_exit()) {
-		int16_t r = ws_serial_getc_nonblock();
-		if (r >= 0) {
-			if (r == CAN) {
-				return XMODEM_CANCEL;
-			} else if (r == NAK) {
-				goto send_write_again;
-			} else if (r == ACK) {
-				xmodem_idx++;
-				return XMODEM_OK;
-			}
+		int16_t r = serial_getc_buffered_nonblock();
+		if (r == CAN) {
+			return XMODEM_CANCEL;
+		} else if (r == ACK) {
+			xmodem_idx++;
+			xmodem_stats.blocks++;
+			return XMODEM_OK;
+		} else if (r == NAK
+			// a CRC receiver rejects the header or the first block by
+			// asking for it with 'C' again
+			|| (r == CRC_START && xmodem_crc && xmodem_idx <= 1)
+			|| (r < 0 && ((uint16_t) (vbl_ticks - ticks_start)) >= XMODEM_TIMEOUT_BLOCK)) {
+			if ((retries--) == 0) return XMODEM_ERROR;
+			xmodem_stats.retries++;
+			xmodem_write_block(block, len, size, buffered);
+			ticks_start = vbl_ticks;
 		}
 
-		ws_hwint_enable(HWINT_SERIAL_RX);
-		cpu_halt();
+		if (r < 0) cpu_halt();
 	}
 	return XMODEM_SELF_CANCEL;
 }
 
+static uint8_t xmodem_send_block_sized(const uint8_t __far* block, uint16_t len, uint16_t size) {
+	xmodem_write_block(block, len, size, false);
+	return xmodem_send_wait(block, len, size, false);
+}
+
+/**
+ * Sends up to XMODEM_BLOCK_SIZE_1K bytes, padding the last block.
+ * 1K blocks are only used if the receiver asked for CRC mode.
+ */
+uint8_t xmodem_send_block(const uint8_t __far* block, uint16_t len) {
+	if (xmodem_crc && len > XMODEM_BLOCK_SIZE) {
+		return xmodem_send_block_sized(block, len, XMODEM_BLOCK_SIZE_1K);
+	}
+	while (true) {
+		uint16_t block_len = len > XMODEM_BLOCK_SIZE ? XMODEM_BLOCK_SIZE : len;
+		uint8_t result = xmodem_send_block_sized(block, block_len, XMODEM_BLOCK_SIZE);
+		if (result != XMODEM_OK || len <= XMODEM_BLOCK_SIZE) {
+			return result;
+		}
+		block += XMODEM_BLOCK_SIZE;
+		len -= XMODEM_BLOCK_SIZE;
+	}
+}
+
+static const uint8_t __far* xmodem_tx_block;
+static uint16_t xmodem_tx_len;
+static uint16_t xmodem_tx_size;
+
+/**
+ * Queues one block of up to XMODEM_BLOCK_SIZE_1K bytes on the
+ * interrupt-driven TX buffer, returning once its last bytes are queued.
+ * The caller can then prepare the next block while those are being sent,
+ * before calling xmodem_send_block_end(); the block must stay valid until
+ * then, in case it has to be resent.
+ */
+void xmodem_send_block_begin(const uint8_t __far* block, uint16_t len) {
+	xmodem_tx_block = block;
+	xmodem_tx_len = len;
+	if (len > XMODEM_BLOCK_SIZE && !xmodem_crc) {
+		// checksum receivers only take 128-byte blocks; send them later
+		xmodem_tx_size = 0;
+		return;
+	}
+	xmodem_tx_size = len > XMODEM_BLOCK_SIZE ? XMODEM_BLOCK_SIZE_1K : XMODEM_BLOCK_SIZE;
+	xmodem_write_block(block, len, xmodem_tx_size, true);
+}
+
+uint8_t xmodem_send_block_end(void) {
+	if (xmodem_tx_size == 0) {
+		return xmodem_send_block(xmodem_tx_block, xmodem_tx_len);
+	}
+	return xmodem_send_wait(xmodem_tx_block, xmodem_tx_len, xmodem_tx_size, true);
+}
+
+/**
+ * YMODEM: sends the batch header for one file. Call after
+ * xmodem_send_start(), before the file's blocks.
+ */
+uint8_t xmodem_send_header(const char *name, uint32_t size) {
+	uint8_t block[XMODEM_BLOCK_SIZE];
+	char digits[10];
+	uint8_t i = 0, j = 0;
+
+	memset(block, 0, sizeof(block));
+	while (name[i] != 0 && i < 64) {
+		block[i] = name[i];
+		i++;
+	}
+	i++;
+	do {
+		digits[j++] = '0' + (size % 10);
+		size /= 10;
+	} while (size > 0);
+	while (j > 0) {
+		block[i++] = digits[--j];
+	}
+
+	xmodem_idx = 0;
+	uint8_t result = xmodem_send_block_sized(block, sizeof(block), XMODEM_BLOCK_SIZE);
+	if (result != XMODEM_OK) {
+		return result;
+	}
+	// the receiver asks for the file's data separately
+	return xmodem_send_start();
+}
+
+/**
+ * YMODEM: ends the batch after xmodem_send_finish().
+ */
+uint8_t xmodem_send_batch_end(void) {
+	uint8_t block[XMODEM_BLOCK_SIZE];
+
+	uint8_t result = xmodem_send_start();
+	if (result != XMODEM_OK) {
+		return result;
+	}
+	memset(block, 0, sizeof(block));
+	xmodem_idx = 0;
+	return xmodem_send_block_sized(block, sizeof(block), XMODEM_BLOCK_SIZE);
+}
+
 uint8_t xmodem_send_finish(void) {
 	uint8_t retries = 10;
 send_write_again:
 	if ((retries--) == 0) return XMODEM_ERROR;
 	ws_serial_putc(EOT);
+	uint16_t ticks_start = vbl_ticks;
 
 	while (!xmodem_poll_exit()) {
-		int16_t r = ws_serial_getc_nonblock();
+		int16_t r = serial_getc_buffered_nonblock();
 		if (r >= 0) {
 			if (r == CAN) {
 				return XMODEM_CANCEL;
@@ -209,9 +534,10 @@ send_write_again:
 			} else if (r == ACK) {
 				return XMODEM_OK;
 			}
+		} else if (((uint16_t) (vbl_ticks - ticks_start)) >= XMODEM_TIMEOUT_BLOCK) {
+			goto send_write_again;
 		}
 
-		ws_hwint_enable(HWINT_SERIAL_RX);
 		cpu_halt();
 	}
 	return XMODEM_SELF_CANCEL;
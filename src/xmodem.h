@@ -27,6 +27,7 @@
 #include <stdint.h>
 
 #define XMODEM_BLOCK_SIZE 128
+#define XMODEM_BLOCK_SIZE_1K 1024
 
 #define XMODEM_OK          0 /* OK */
 #define XMODEM_CANCEL      1 /* user cancellation */
@@ -34,14 +35,39 @@
 #define XMODEM_ERROR       3 /* transfer error */
 #define XMODEM_COMPLETE    4 /* no more blocks to receive */
 
+typedef struct {
+	uint16_t blocks;
+	uint16_t retries;
+} xmodem_stats_t;
+
+extern xmodem_stats_t xmodem_stats;
+
+#define XMODEM_SIZE_UNKNOWN 0xFFFFFFFF
+
+// file information from a YMODEM header
+typedef struct {
+	char name[32];
+	uint32_t size;
+} xmodem_file_t;
+
+extern xmodem_file_t xmodem_file;
+
 bool xmodem_poll_exit(void);
 
 void xmodem_open(uint8_t baudrate);
 void xmodem_close(void);
 
 uint8_t xmodem_send_start(void);
-uint8_t xmodem_send_block(const uint8_t __far* block);
+uint8_t xmodem_send_block(const uint8_t __far* block, uint16_t len);
+void xmodem_send_block_begin(const uint8_t __far* block, uint16_t len);
+uint8_t xmodem_send_block_end(void);
 uint8_t xmodem_send_finish(void);
+uint8_t xmodem_send_header(const char *name, uint32_t size);
+uint8_t xmodem_send_batch_end(void);
 
 uint8_t xmodem_recv_start(void);
-uint8_t xmodem_recv_block(uint8_t __far* block);
+uint8_t xmodem_recv_block(uint8_t __far* block, uint16_t *len);
+uint8_t xmodem_recv_header(void);
+uint8_t xmodem_recv_next_file(void);
+uint8_t xmodem_recv_finish(void);
+void xmodem_recv_cancel(void);
@@ -0,0 +1,69 @@
+#!/usr/bin/python3
+#
+# Copyright (c) 2022 Adrian Siekierka
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+# SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+# RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+# CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Sends a file to CartFriend via YMODEM (Browse -> Receive ROM, or a WW OS
+# install). If the cartridge is resuming an interrupted transfer, only the
+# data it has not committed yet is sent.
+#
+# With --compress, the file is sent ZX0-packed, for the serial uploads in
+# Tools and WW OS installs to unpack as it arrives. This does not apply to
+# Receive ROM, nor to resumed transfers. WW OS installs are written straight
+# to flash, and need --independent as well.
+#
+# usage: cf_send.py [--baud BAUD] [--compress [--independent]] port file
+#
+# Requires pyserial.
+
+import argparse, os, serial, sys
+from cfserial import *
+import zx0pack
+
+def print_progress(done, total):
+	print("\r%d/%d bytes" % (done, total), end = "", file = sys.stderr)
+
+parser = argparse.ArgumentParser(description="Send a file to CartFriend, resuming interrupted transfers.")
+parser.add_argument("port", help="serial port")
+parser.add_argument("file", help="file to send")
+parser.add_argument("--baud", type=int, default=38400, help="baud rate (9600 or 38400)")
+parser.add_argument("-z", "--compress", action="store_true", help="compress the file")
+parser.add_argument("--independent", action="store_true", help="compress each frame on its own (for WW OS installs)")
+args = parser.parse_args()
+
+with open(args.file, "rb") as fp:
+	data = fp.read()
+name = os.path.basename(args.file)[:31]
+
+try:
+	with serial.Serial(args.port, args.baud, timeout=0.1) as ser:
+		ser.reset_input_buffer()
+		# a new transfer asks for the file right away, while a resumed one
+		# waits to be asked for the offset
+		try:
+			wait_for(ser, (CRC,), 4)
+			offset = 0
+		except TransferError:
+			offset = request_resume_offset(ser)
+			print("Resuming at %d bytes" % offset, file = sys.stderr)
+		if offset > len(data):
+			raise TransferError("the file is smaller than the interrupted one")
+		if args.compress and offset == 0:
+			data = zx0pack.pack(data, args.independent)
+			print("Compressed to %d bytes" % len(data), file = sys.stderr)
+		send_file(ser, name, data, offset, print_progress)
+		send_batch_end(ser)
+		print("", file = sys.stderr)
+except TransferError as e:
+	print("\nError: %s" % e, file = sys.stderr)
+	sys.exit(1)
@@ -0,0 +1,317 @@
+#!/usr/bin/python3
+# Copyright (c) 2022 Adrian Siekierka
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+# SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+# RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+# CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+# Host client for CartFriend's binary remote control protocol (Tools ->
+# Remote control). See src/remote.h for the frame format.
+#
+# usage: cfremote.py [--baud BAUD] [--window BYTES] port command [args...]
+#
+#   info                          slot types, names and header summaries
+#   read SLOT BANK FILE [BANKS]   dump BANKS (default 1) 64 KB banks
+#   write SLOT BANK FILE          erase and program a file from BANK on
+#   erase SLOT BANK               erase the 128 KB sector holding BANK
+#   save-get FILE [SIZE]          read cartridge SRAM (default 32 KB)
+#   save-put FILE                 write cartridge SRAM
+#   launch SLOT [BANK]            launch a slot; BANK is the ROM's last bank,
+#                                 0x8F to 0xFF ending in F (default 0xFF)
+#   bench [KB]                    measure read throughput, per window size
+#
+# SLOT and BANK accept hexadecimal values with a 0x prefix.
+#
+# Requires pyserial, unless used with cfremote_sim.py's PTY.
+
+import argparse, binascii, collections, struct, sys, time
+
+SYNC = 0xA5
+VERSION = 1
+MAX_PAYLOAD = 256
+
+CMD_HELLO = 0x00
+CMD_SLOT_INFO = 0x01
+CMD_READ_HEADER = 0x02
+CMD_READ = 0x03
+CMD_WRITE = 0x04
+CMD_ERASE = 0x05
+CMD_SRAM_READ = 0x06
+CMD_SRAM_WRITE = 0x07
+CMD_LAUNCH = 0x08
+CMD_NAK = 0x7F
+CMD_RESPONSE = 0x80
+
+OK = 0
+ERR_COMMAND = 1
+ERR_ARGUMENT = 2
+ERR_PROTECTED = 3
+ERR_VERIFY = 4
+ERR_FRAME = 5
+
+STATUS_NAMES = ["ok", "unknown command", "invalid argument", "protected slot", "verification failed", "damaged frame"]
+
+BANK_SIZE = 0x10000
+SECTOR_SIZE = 0x20000
+SLOT_TYPE_NAMES = {0: "soft", 1: "launcher", 2: "8M/512K", 3: "8M/2M", 0xFF: "unused"}
+
+class RemoteError(Exception):
+	pass
+
+def encode_frame(seq, cmd, payload):
+	body = struct.pack("<BBH", seq & 0xFF, cmd, len(payload)) + payload
+	return bytes([SYNC]) + body + struct.pack(">H", binascii.crc_hqx(body, 0))
+
+class FrameReader:
+	def __init__(self, read):
+		self.read = read
+		self.buffer = bytearray()
+
+	# Returns (seq, cmd, payload), or None on timeout.
+	def next(self, timeout):
+		end = time.monotonic() + timeout
+		while True:
+			frame = self.parse()
+			if frame is not None:
+				return frame
+			if time.monotonic() > end:
+				return None
+			self.buffer += self.read()
+
+	def parse(self):
+		while True:
+			start = self.buffer.find(bytes([SYNC]))
+			if start < 0:
+				self.buffer.clear()
+				return None
+			del self.buffer[:start]
+			if len(self.buffer) < 5:
+				return None
+			seq, cmd, length = struct.unpack_from("<BBH", self.buffer, 1)
+			if length > MAX_PAYLOAD:
+				del self.buffer[:1]
+				continue
+			if len(self.buffer) < 7 + length:
+				return None
+			body = bytes(self.buffer[1:5 + length])
+			crc = struct.unpack_from(">H", self.buffer, 5 + length)[0]
+			if binascii.crc_hqx(body, 0) != crc:
+				# not a frame; look for the next sync byte
+				del self.buffer[:1]
+				continue
+			del self.buffer[:7 + length]
+			return seq, cmd, body[4:]
+
+# Splits a transfer into (position, length) pieces which do not cross
+# a 64 KB bank boundary.
+def chunks(length, chunk):
+	pos = 0
+	while pos < length:
+		n = min(chunk, length - pos, BANK_SIZE - (pos & 0xFFFF))
+		yield pos, n
+		pos += n
+
+class Request:
+	def __init__(self, cmd, payload):
+		self.cmd = cmd
+		self.payload = payload
+		self.seq = None
+		self.status = None
+		self.data = None
+
+class Remote:
+	def __init__(self, port, window = None, timeout = 3):
+		self.port = port
+		self.reader = FrameReader(lambda: port.read(max(1, port.in_waiting)))
+		self.timeout = timeout
+		self.seq = 0
+		self.window = 0
+		info = self.call(CMD_HELLO, b"", hello = True)
+		version, self.max_payload, rx_size, self.slot_count, self.launch_slot = struct.unpack("<BHHBB", info)
+		if version != VERSION:
+			raise RemoteError("unsupported protocol version %d" % version)
+		# leave some room for the frame the device is working on
+		self.window = min(window or rx_size, rx_size) - 16
+
+	# Runs requests in order, keeping as many in flight as fit the window.
+	# Read-style requests are idempotent, so after a lost response, they
+	# can simply be sent again.
+	def run(self, requests, hello = False):
+		queue = collections.deque(requests)
+		in_flight = collections.deque()
+		in_flight_bytes = 0
+		last_nak = None
+		while len(queue) > 0 or len(in_flight) > 0:
+			while len(queue) > 0 and (len(in_flight) == 0 or in_flight_bytes + len(queue[0].payload) + 7 <= self.window):
+				req = queue.popleft()
+				req.seq = self.seq
+				self.seq = (self.seq + 1) & 0xFF
+				self.port.write(encode_frame(req.seq, req.cmd, req.payload))
+				in_flight.append(req)
+				in_flight_bytes += len(req.payload) + 7
+			frame = self.reader.next(self.timeout)
+			if frame is None or (frame[1] == (CMD_NAK | CMD_RESPONSE) and frame[2][1] != last_nak):
+				# go back: resend everything still in flight, numbered from
+				# what the device expects next
+				if frame is not None:
+					last_nak = frame[2][1]
+					self.seq = last_nak
+				elif hello:
+					raise RemoteError("no response; is Remote control running?")
+				else:
+					self.seq = in_flight[0].seq
+				queue.extendleft(reversed(in_flight))
+				in_flight.clear()
+				in_flight_bytes = 0
+				continue
+			seq, cmd, payload = frame
+			if len(in_flight) == 0 or seq != in_flight[0].seq or cmd != (in_flight[0].cmd | CMD_RESPONSE):
+				continue
+			req = in_flight.popleft()
+			in_flight_bytes -= len(req.payload) + 7
+			req.status, req.data = payload[0], payload[1:]
+			last_nak = None
+		for req in requests:
+			if req.status != OK:
+				raise RemoteError(STATUS_NAMES[req.status] if req.status < len(STATUS_NAMES) else "error %d" % req.status)
+		return requests
+
+	def call(self, cmd, payload, hello = False):
+		return self.run([Request(cmd, payload)], hello)[0].data
+
+	def slot_info(self):
+		reqs = self.run([Request(CMD_SLOT_INFO, bytes([i])) for i in range(self.slot_count)])
+		return [(r.data[0], r.data[1:]) for r in reqs]
+
+	def read_header(self, slot, bank):
+		return self.call(CMD_READ_HEADER, bytes([slot, bank]))
+
+	def read(self, slot, bank, length):
+		reqs = []
+		for pos, n in chunks(length, self.max_payload - 1):
+			reqs.append(Request(CMD_READ, struct.pack("<BBHH", slot, bank + (pos >> 16), pos & 0xFFFF, n)))
+		return b"".join(r.data for r in self.run(reqs))
+
+	def erase(self, slot, bank):
+		self.call(CMD_ERASE, bytes([slot, bank]))
+
+	def write(self, slot, bank, data):
+		reqs = []
+		for pos, n in chunks(len(data), self.max_payload - 4):
+			# skip erased data
+			if data[pos:pos + n] != b"\xFF" * n:
+				reqs.append(Request(CMD_WRITE, struct.pack("<BBH", slot, bank + (pos >> 16), pos & 0xFFFF) + data[pos:pos + n]))
+		self.run(reqs)
+
+	def sram_read(self, length):
+		reqs = []
+		for pos, n in chunks(length, self.max_payload - 1):
+			reqs.append(Request(CMD_SRAM_READ, struct.pack("<BHH", pos >> 16, pos & 0xFFFF, n)))
+		return b"".join(r.data for r in self.run(reqs))
+
+	def sram_write(self, data):
+		reqs = []
+		for pos, n in chunks(len(data), self.max_payload - 3):
+			reqs.append(Request(CMD_SRAM_WRITE, struct.pack("<BH", pos >> 16, pos & 0xFFFF) + data[pos:pos + n]))
+		self.run(reqs)
+
+	def launch(self, slot, bank):
+		self.call(CMD_LAUNCH, bytes([slot, bank]))
+
+def parse_int(s):
+	return int(s, 0)
+
+def cmd_info(remote, args):
+	for slot, (slot_type, name) in enumerate(remote.slot_info()):
+		name = name[1:].split(b"\x00")[0].decode("ascii", "replace") if name[0] == 0x20 else ""
+		line = "%2d  %-8s" % (slot, SLOT_TYPE_NAMES.get(slot_type, "?"))
+		if slot_type not in (1, 0xFF):
+			header = remote.read_header(slot, 0xFF)
+			if header[0] == 0xEA:
+				line += "  publisher %02X, game %02X, checksum %04X" % (header[6], header[8], struct.unpack_from("<H", header, 14)[0])
+			else:
+				line += "  (empty)"
+		print(line + ("  " + name if name else ""))
+
+def cmd_read(remote, args):
+	slot, bank = parse_int(args.args[0]), parse_int(args.args[1])
+	banks = parse_int(args.args[3]) if len(args.args) > 3 else 1
+	data = remote.read(slot, bank, banks * BANK_SIZE)
+	with open(args.args[2], "wb") as fp:
+		fp.write(data)
+
+def cmd_write(remote, args):
+	slot, bank = parse_int(args.args[0]), parse_int(args.args[1])
+	with open(args.args[2], "rb") as fp:
+		data = fp.read()
+	for b in range(bank & 0xFE, bank + ((len(data) + BANK_SIZE - 1) // BANK_SIZE), 2):
+		remote.erase(slot, b)
+	remote.write(slot, bank, data)
+
+def cmd_erase(remote, args):
+	remote.erase(parse_int(args.args[0]), parse_int(args.args[1]))
+
+def cmd_save_get(remote, args):
+	size = parse_int(args.args[1]) if len(args.args) > 1 else 0x8000
+	with open(args.args[0], "wb") as fp:
+		fp.write(remote.sram_read(size))
+
+def cmd_save_put(remote, args):
+	with open(args.args[0], "rb") as fp:
+		remote.sram_write(fp.read())
+
+def cmd_launch(remote, args):
+	remote.launch(parse_int(args.args[0]), parse_int(args.args[1]) if len(args.args) > 1 else 0xFF)
+
+def cmd_bench(remote, args):
+	size = (parse_int(args.args[0]) if len(args.args) > 0 else 16) * 1024
+	window = remote.window
+	for w in sorted(set([1, 64, window])):
+		remote.window = w
+		start = time.monotonic()
+		remote.read(remote.launch_slot, 0xF0, size)
+		elapsed = time.monotonic() - start
+		print("window %4d bytes: %7.0f bytes/s" % (w, size / elapsed))
+	remote.window = window
+
+COMMANDS = {
+	"info": (cmd_info, 0),
+	"read": (cmd_read, 3),
+	"write": (cmd_write, 3),
+	"erase": (cmd_erase, 2),
+	"save-get": (cmd_save_get, 1),
+	"save-put": (cmd_save_put, 1),
+	"launch": (cmd_launch, 1),
+	"bench": (cmd_bench, 0),
+}
+
+def open_port(name, baud):
+	import serial
+	return serial.Serial(name, baud, timeout = 0.05)
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Control CartFriend over serial.")
+	parser.add_argument("port", help="serial port")
+	parser.add_argument("command", choices = COMMANDS.keys())
+	parser.add_argument("args", nargs = "*")
+	parser.add_argument("--baud", type = int, default = 38400, help = "baud rate (9600 or 38400)")
+	parser.add_argument("--window", type = int, help = "maximum bytes of requests in flight")
+	args = parser.parse_args()
+
+	func, min_args = COMMANDS[args.command]
+	if len(args.args) < min_args:
+		parser.error("%s needs at least %d arguments" % (args.command, min_args))
+	try:
+		with open_port(args.port, args.baud) as port:
+			func(Remote(port, args.window), args)
+	except RemoteError as e:
+		print("Error: %s" % e, file = sys.stderr)
+		sys.exit(1)
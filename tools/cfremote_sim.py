@@ -0,0 +1,236 @@
+#!/usr/bin/python3
+# Copyright (c) 2022 Adrian Siekierka
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+# SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+# RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+# CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+# Stand-in for a cartridge running Tools -> Remote control, for testing
+# cfremote.py without hardware. It serves the protocol on a PTY, backed by
+# a flash image (created erased if missing) and an SRAM image next to it.
+#
+# usage: cfremote_sim.py [options] flash.img
+#
+# The printed PTY path can be passed to cfremote.py as its port. With
+# --baud, the serial link speed, USB adapter latency and the size of the
+# device's RX buffer are modelled, so window sizes can be compared;
+# --error-rate corrupts received data to exercise retransmission.
+
+import argparse, binascii, collections, os, random, select, struct, sys, time, tty
+from cfremote import *
+
+GAME_SLOTS = 16
+SLOT_BANKS = 128
+RX_BUFFER_SIZE = 512
+# bytes still missing from a frame after this long are given up on
+FRAME_TIMEOUT = 0.5
+SRAM_SIZE = 0x80000
+
+class Device:
+	def __init__(self, args):
+		self.args = args
+		if not os.path.exists(args.image):
+			# a fresh cartridge is fully erased
+			with open(args.image, "wb") as fp:
+				for i in range(GAME_SLOTS * SLOT_BANKS // 2):
+					fp.write(b"\xFF" * SECTOR_SIZE)
+		self.flash = open(args.image, "r+b")
+		sram_name = args.image + ".sram"
+		self.sram = open(sram_name, "r+b" if os.path.exists(sram_name) else "w+b")
+		self.sram.truncate(SRAM_SIZE)
+		self.seq_expected = 0
+		self.nak_sent = False
+		self.outbox = collections.deque()
+
+	def flash_pos(self, slot, bank, offset):
+		if slot >= GAME_SLOTS or bank < 0x80:
+			return None
+		return ((slot * SLOT_BANKS) + (bank - 0x80)) * BANK_SIZE + offset
+
+	def flash_read(self, pos, n):
+		self.flash.seek(pos)
+		return self.flash.read(n)
+
+	def handle(self, cmd, data):
+		if cmd == CMD_HELLO:
+			return OK, struct.pack("<BHHBB", VERSION, MAX_PAYLOAD, RX_BUFFER_SIZE, GAME_SLOTS, self.args.launch_slot)
+		elif cmd == CMD_SLOT_INFO:
+			if len(data) < 1 or data[0] >= GAME_SLOTS:
+				return ERR_ARGUMENT, b""
+			return OK, bytes([1 if data[0] == self.args.launch_slot else 0]) + bytes(24)
+		elif cmd == CMD_READ_HEADER or cmd == CMD_READ:
+			if cmd == CMD_READ_HEADER:
+				data = data[0:2] + struct.pack("<HH", 0xFFF0, 16) if len(data) >= 2 else b""
+			if len(data) < 6:
+				return ERR_ARGUMENT, b""
+			slot, bank, offset, n = struct.unpack("<BBHH", data[0:6])
+			pos = self.flash_pos(slot, bank, offset)
+			if pos is None or n > MAX_PAYLOAD - 1 or offset + n > BANK_SIZE:
+				return ERR_ARGUMENT, b""
+			self.op_delay()
+			return OK, self.flash_read(pos, n)
+		elif cmd == CMD_WRITE:
+			if len(data) < 4:
+				return ERR_ARGUMENT, b""
+			slot, bank, offset = struct.unpack("<BBH", data[0:4])
+			pos = self.flash_pos(slot, bank, offset)
+			if pos is None or offset + len(data) - 4 > BANK_SIZE:
+				return ERR_ARGUMENT, b""
+			if slot == self.args.launch_slot:
+				return ERR_PROTECTED, b""
+			self.op_delay(2)
+			# programming can only clear bits
+			old = self.flash_read(pos, len(data) - 4)
+			new = bytes(a & b for a, b in zip(old, data[4:]))
+			self.flash.seek(pos)
+			self.flash.write(new)
+			return (OK if new == data[4:] else ERR_VERIFY), b""
+		elif cmd == CMD_ERASE:
+			if len(data) < 2 or self.flash_pos(data[0], data[1], 0) is None:
+				return ERR_ARGUMENT, b""
+			if data[0] == self.args.launch_slot:
+				return ERR_PROTECTED, b""
+			self.op_delay()
+			self.flash.seek(self.flash_pos(data[0], data[1] & 0xFE, 0))
+			self.flash.write(b"\xFF" * SECTOR_SIZE)
+			return OK, b""
+		elif cmd == CMD_SRAM_READ or cmd == CMD_SRAM_WRITE:
+			if len(data) < 3:
+				return ERR_ARGUMENT, b""
+			bank, offset = struct.unpack("<BH", data[0:3])
+			n = struct.unpack("<H", data[3:5])[0] if cmd == CMD_SRAM_READ and len(data) >= 5 else len(data) - 3
+			if (cmd == CMD_SRAM_READ and (len(data) < 5 or n > MAX_PAYLOAD - 1)) or offset + n > BANK_SIZE:
+				return ERR_ARGUMENT, b""
+			self.sram.seek(((bank * BANK_SIZE) + offset) % SRAM_SIZE)
+			if cmd == CMD_SRAM_READ:
+				return OK, self.sram.read(n)
+			self.sram.write(data[3:])
+			return OK, b""
+		elif cmd == CMD_LAUNCH:
+			if len(data) < 2:
+				return ERR_ARGUMENT, b""
+			if data[0] == self.args.launch_slot:
+				return ERR_PROTECTED, b""
+			if (data[1] & 0x8F) != 0x8F:
+				return ERR_ARGUMENT, b""
+			print("Launching slot %d, bank %02X" % (data[0], data[1]), file = sys.stderr)
+			return OK, b""
+		return ERR_COMMAND, b""
+
+	def op_delay(self, count = 1):
+		# every driver call switches the cartridge slot twice
+		if self.args.baud:
+			time.sleep(self.args.op_delay * count)
+
+	def respond(self, fd, seq, cmd, status, data):
+		frame = encode_frame(seq, cmd | CMD_RESPONSE, bytes([status]) + data)
+		if self.args.baud:
+			# the device waits for its response to be sent; the host only
+			# sees it after the USB adapter's latency
+			time.sleep(len(frame) * 10 / self.args.baud)
+			self.outbox.append((time.monotonic() + self.args.latency, frame))
+		else:
+			os.write(fd, frame)
+
+	def flush_outbox(self, fd):
+		while len(self.outbox) > 0 and self.outbox[0][0] <= time.monotonic():
+			os.write(fd, self.outbox.popleft()[1])
+
+	def request(self, fd, seq, cmd, data):
+		if cmd == CMD_NAK or (cmd != CMD_HELLO and seq != self.seq_expected):
+			if not self.nak_sent:
+				self.respond(fd, self.seq_expected, CMD_NAK | CMD_RESPONSE, ERR_FRAME, bytes([self.seq_expected]))
+				self.nak_sent = True
+			return
+		self.seq_expected = (seq + 1) & 0xFF
+		self.nak_sent = False
+		status, response = self.handle(cmd, data)
+		self.respond(fd, seq, cmd, status, response)
+
+# Takes the next frame off the buffer like the device does: a frame which
+# is too long, damaged or incomplete is returned as a NAK, so that the
+# host is told to go back.
+def next_frame(pending, stalled):
+	start = pending.find(bytes([SYNC]))
+	if start < 0:
+		pending.clear()
+		return None
+	del pending[:start]
+	if len(pending) >= 5:
+		seq, cmd, length = struct.unpack_from("<BBH", pending, 1)
+		if length > MAX_PAYLOAD:
+			del pending[:1]
+			return 0, CMD_NAK, b""
+		if len(pending) >= 7 + length:
+			body = bytes(pending[1:5 + length])
+			crc = struct.unpack_from(">H", pending, 5 + length)[0]
+			del pending[:7 + length]
+			if binascii.crc_hqx(body, 0) != crc:
+				return 0, CMD_NAK, b""
+			return seq, cmd, body[4:]
+	if stalled:
+		del pending[:1]
+		return 0, CMD_NAK, b""
+	return None
+
+def main():
+	parser = argparse.ArgumentParser(description="Simulate CartFriend's remote control mode on a PTY.")
+	parser.add_argument("image", help="flash image file")
+	parser.add_argument("--baud", type = int, default = 0, help = "model a serial link of this speed")
+	parser.add_argument("--op-delay", type = float, default = 0.024, help = "seconds per flash access, with --baud")
+	parser.add_argument("--latency", type = float, default = 0.008, help = "seconds of USB adapter latency, with --baud")
+	parser.add_argument("--error-rate", type = float, default = 0, help = "chance of corrupting a byte in each read from the PTY")
+	parser.add_argument("--launch-slot", type = int, default = 15, help = "slot holding CartFriend")
+	args = parser.parse_args()
+
+	device = Device(args)
+	master, slave = os.openpty()
+	tty.setraw(slave)
+	print(os.ttyname(slave), flush = True)
+
+	# bytes received, but not yet processed by the device
+	pending = bytearray()
+	last_data = time.monotonic()
+	while True:
+		device.flush_outbox(master)
+		data = b""
+		timeout = 0.1 if len(device.outbox) == 0 else max(0, device.outbox[0][0] - time.monotonic())
+		ready, _, _ = select.select([master], [], [], timeout)
+		if ready:
+			try:
+				data = os.read(master, 4096)
+			except OSError:
+				continue
+			if args.baud:
+				# the RX interrupt can only buffer so much while busy
+				room = RX_BUFFER_SIZE - len(pending)
+				data = data[:max(room, 0)]
+			if args.error_rate > 0 and len(data) > 0 and random.random() < args.error_rate:
+				i = random.randrange(len(data))
+				data = data[:i] + bytes([data[i] ^ 0x55]) + data[i + 1:]
+			pending += data
+
+		if len(data) > 0:
+			last_data = time.monotonic()
+		while True:
+			frame = next_frame(pending, time.monotonic() - last_data > FRAME_TIMEOUT)
+			if frame is None:
+				break
+			device.request(master, *frame)
+			device.flush_outbox(master)
+		device.flash.flush()
+		device.sram.flush()
+
+if __name__ == "__main__":
+	try:
+		main()
+	except KeyboardInterrupt:
+		pass
@@ -0,0 +1,103 @@
+# Copyright (c) 2022 Adrian Siekierka
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+# SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+# RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+# CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Serial helpers shared by the CartFriend host tools.
+#
+# Requires pyserial.
+
+import binascii, struct, time
+
+SOH = 0x01
+STX = 0x02
+EOT = 0x04
+ACK = 0x06
+NAK = 0x15
+CAN = 0x18
+CRC = 0x43
+
+class TransferError(Exception):
+	pass
+
+def read_exact(ser, n, timeout):
+	data = bytearray()
+	end = time.monotonic() + timeout
+	while len(data) < n:
+		if time.monotonic() > end:
+			raise TransferError("timed out waiting for the cartridge")
+		data += ser.read(n - len(data))
+	return bytes(data)
+
+def wait_for(ser, chars, timeout):
+	end = time.monotonic() + timeout
+	while time.monotonic() < end:
+		c = ser.read(1)
+		if len(c) > 0 and c[0] in chars:
+			if c[0] == CAN:
+				raise TransferError("transfer cancelled by the cartridge")
+			return c[0]
+	raise TransferError("timed out waiting for the cartridge")
+
+def wait_magic(ser, magic, timeout):
+	end = time.monotonic() + timeout
+	window = b""
+	while window != magic:
+		window = (window + read_exact(ser, 1, end - time.monotonic()))[-len(magic):]
+
+def check_crc(ser, payload):
+	crc = struct.unpack(">H", read_exact(ser, 2, 5))[0]
+	if binascii.crc_hqx(payload, 0) != crc:
+		raise TransferError("corrupted reply received")
+
+# Asks the cartridge where to resume an interrupted transfer.
+def request_resume_offset(ser):
+	ser.write(b"CFRQ")
+	wait_magic(ser, b"CFRO", 5)
+	payload = read_exact(ser, 4, 5)
+	check_crc(ser, payload)
+	return struct.unpack("<I", payload)[0]
+
+def send_block(ser, idx, data):
+	packet = bytes([STX if len(data) == 1024 else SOH, idx & 0xFF, 0xFF - (idx & 0xFF)])
+	packet += data + struct.pack(">H", binascii.crc_hqx(data, 0))
+	for attempt in range(10):
+		ser.write(packet)
+		if wait_for(ser, (ACK, NAK, CAN), 10) == ACK:
+			return
+	raise TransferError("too many retries")
+
+def send_eot(ser):
+	for attempt in range(10):
+		ser.write(bytes([EOT]))
+		if wait_for(ser, (ACK, NAK, CAN), 10) == ACK:
+			return
+	raise TransferError("too many retries")
+
+# Sends one file of a YMODEM batch. With offset, the header still announces
+# the whole file, but only the data from offset on is sent.
+def send_file(ser, name, data, offset=0, progress=None):
+	wait_for(ser, (CRC, CAN), 30)
+	header = name.encode("ascii") + b"\x00" + str(len(data)).encode("ascii") + b"\x00"
+	send_block(ser, 0, header.ljust(128, b"\x00"))
+	# the cartridge may erase flash before asking for the data
+	wait_for(ser, (CRC, CAN), 30)
+	for i in range(offset, len(data), 1024):
+		block = data[i:i + 1024]
+		block = block.ljust(128 if len(block) <= 128 else 1024, b"\x1A")
+		send_block(ser, ((i - offset) // 1024) + 1, block)
+		if progress is not None:
+			progress(min(i + 1024, len(data)), len(data))
+	send_eot(ser)
+
+def send_batch_end(ser):
+	wait_for(ser, (CRC, CAN), 30)
+	send_block(ser, 0, bytes(128))
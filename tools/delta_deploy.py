@@ -0,0 +1,76 @@
+#!/usr/bin/python3
+#
+# Copyright (c) 2022 Adrian Siekierka
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+# SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+# RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+# CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Re-flashes a ROM image over serial, sending only the 128 KB flash sectors
+# which differ from the copy already in the slot. Select "Deploy changes"
+# in Browse on the cartridge side first.
+#
+# usage: delta_deploy.py [--baud BAUD] port rom.ws
+#
+# Requires pyserial.
+
+import argparse, serial, struct, sys, zlib
+from cfserial import *
+
+SECTOR_SIZE = 0x20000
+BANK_SIZE = 0x10000
+
+def split_sectors(rom):
+	# the image ends at the last bank of the slot, which ends a sector
+	first = len(rom) % SECTOR_SIZE
+	sectors = [rom[0:first]] if first > 0 else []
+	for i in range(first, len(rom), SECTOR_SIZE):
+		sectors.append(rom[i:i + SECTOR_SIZE])
+	return sectors
+
+def request_crcs(ser, size):
+	ser.reset_input_buffer()
+	ser.write(b"CFDD" + struct.pack("<I", size))
+	# the cartridge reads the whole image first, at roughly 200 KB/s
+	wait_magic(ser, b"CFDS", 10 + (size / 0x20000))
+	payload = read_exact(ser, 2, 5)
+	count = struct.unpack("<H", payload)[0]
+	payload += read_exact(ser, count * 4, 5)
+	check_crc(ser, payload)
+	return list(struct.unpack("<%dI" % count, payload[2:]))
+
+parser = argparse.ArgumentParser(description="Re-flash only the changed sectors of a ROM image.")
+parser.add_argument("port", help="serial port")
+parser.add_argument("rom", help="ROM image")
+parser.add_argument("--baud", type=int, default=38400, help="baud rate (9600 or 38400)")
+args = parser.parse_args()
+
+with open(args.rom, "rb") as fp:
+	rom = fp.read()
+if len(rom) == 0 or (len(rom) % BANK_SIZE) != 0:
+	print("Error: the ROM image size must be a multiple of 64 KB!", file = sys.stderr)
+	sys.exit(1)
+
+sectors = split_sectors(rom)
+
+try:
+	with serial.Serial(args.port, args.baud, timeout=0.1) as ser:
+		crcs = request_crcs(ser, len(rom))
+		if len(crcs) != len(sectors):
+			raise TransferError("the image does not fit in the slot")
+		changed = [i for i, s in enumerate(sectors) if (zlib.crc32(s) & 0xFFFFFFFF) != crcs[i]]
+		print("%d of %d sectors changed" % (len(changed), len(sectors)), file = sys.stderr)
+		for i in changed:
+			print("Sending sector %d (%d bytes)" % (i, len(sectors[i])), file = sys.stderr)
+			send_file(ser, str(i), sectors[i])
+		send_batch_end(ser)
+except TransferError as e:
+	print("Error: %s" % e, file = sys.stderr)
+	sys.exit(1)
@@ -0,0 +1,172 @@
+#!/usr/bin/python3
+#
+# Copyright (c) 2022 Adrian Siekierka
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+# SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+# RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+# CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Compiles DAT files (clrmamepro or Logiqx XML) into a CRC32 -> title table.
+#
+# usage: gen_titledb.py output.c output.h [input.dat...]
+#
+# Titles are shortened to fit a Browse line and compressed by replacing
+# frequent words with single-byte tokens (0x80 and above).
+
+from pathlib import Path
+import os, re, sys, unicodedata, zlib
+
+TITLE_MAX_LENGTH = 23
+TOKEN_FIRST = 0x80
+TOKEN_COUNT = 0x100 - TOKEN_FIRST
+
+re_cmp_game = re.compile(r'game\s*\(\s*name\s+"([^"]*)"(.*?)\n\)', re.S)
+re_cmp_rom = re.compile(r'^\s*rom\s*\((.*)\)\s*$', re.M)
+re_cmp_crc = re.compile(r'\bcrc\s+([0-9A-Fa-f]{8})')
+re_xml_game = re.compile(r'<(?:game|machine)\s+name="([^"]*)"[^>]*>(.*?)</(?:game|machine)>', re.S)
+re_xml_crc = re.compile(r'<rom\s[^>]*crc="([0-9A-Fa-f]{8})"')
+re_tags = re.compile(r'\s*[\(\[][^\)\]]*[\)\]]')
+
+def xml_unescape(s):
+	return s.replace("&quot;", "\"").replace("&apos;", "'").replace("&lt;", "<").replace("&gt;", ">").replace("&amp;", "&")
+
+def clean_title(s):
+	s = re_tags.sub("", s).strip()
+	s = unicodedata.normalize("NFD", s).encode("ascii", "ignore").decode("ascii")
+	s = "".join(c if (c >= " " and c <= "~") else "?" for c in s)
+	return s[:TITLE_MAX_LENGTH].rstrip()
+
+def parse_dat(fn):
+	with open(fn, encoding="utf-8", errors="replace") as fp:
+		data = fp.read()
+	if data.lstrip().startswith("<"):
+		for name, body in re_xml_game.findall(data):
+			for crc in re_xml_crc.findall(body):
+				yield int(crc, 16), xml_unescape(name)
+	else:
+		for name, body in re_cmp_game.findall(data):
+			for rom in re_cmp_rom.findall(body):
+				m = re_cmp_crc.search(rom)
+				if m:
+					yield int(m.group(1), 16), name
+
+def pick_tokens(titles):
+	counts = {}
+	for t in titles:
+		for w in set(t.split(" ")):
+			if len(w) >= 3:
+				counts[w] = counts.get(w, 0) + 1
+	# bytes saved by tokenizing a word, minus the cost of storing it once
+	savings = [(((len(w) - 1) * c) - (len(w) + 1), w) for w, c in counts.items() if c >= 2]
+	savings = [x for x in savings if x[0] > 0]
+	savings.sort(key=lambda x: (-x[0], x[1]))
+	return [w for _, w in savings[:TOKEN_COUNT]]
+
+def encode_title(t, token_map):
+	out = bytearray()
+	for i, w in enumerate(t.split(" ")):
+		if i > 0:
+			out.append(0x20)
+		if w in token_map:
+			out.append(token_map[w])
+		else:
+			out += w.encode("ascii")
+	return bytes(out)
+
+def c_bytes(b):
+	return ", ".join("0x%02X" % x for x in b)
+
+entries = {}
+for fn in sys.argv[3:]:
+	if not os.path.isfile(fn):
+		continue
+	for crc, name in parse_dat(fn):
+		title = clean_title(name)
+		if len(title) > 0 and crc not in entries:
+			entries[crc] = title
+
+crcs = sorted(entries.keys())
+titles = [entries[c] for c in crcs]
+tokens = pick_tokens(titles)
+token_map = {w: TOKEN_FIRST + i for i, w in enumerate(tokens)}
+
+# Emit deduplicated, NUL-terminated name pool
+names = bytearray()
+name_offsets = []
+name_pool = {}
+for t in titles:
+	enc = encode_title(t, token_map)
+	if enc not in name_pool:
+		name_pool[enc] = len(names)
+		names += enc + b"\x00"
+	name_offsets.append(name_pool[enc])
+
+token_data = bytearray()
+token_offsets = []
+for w in tokens:
+	token_offsets.append(len(token_data))
+	token_data += w.encode("ascii") + b"\x00"
+
+if len(names) > 0xFFFF or len(token_data) > 0xFFFF:
+	print("Error: title database too large!", file = sys.stderr)
+	sys.exit(1)
+
+# The hash is stored alongside cached lookups, invalidating them when
+# the database changes. 0x0000 and 0xFFFF are reserved.
+db_hash = zlib.crc32(bytes(str(entries), "utf-8")) & 0xFFFF
+if db_hash == 0x0000 or db_hash == 0xFFFF:
+	db_hash = 0x0001
+
+with (
+	open(sys.argv[1], "w") as fp_c,
+	open(sys.argv[2], "w") as fp_h,
+):
+	hdr_define = '__%s__' % re.sub(r'[^a-zA-Z0-9]', '_', Path(sys.argv[2]).name).upper()
+
+	print("// Auto-generated file. Please do not edit directly.\n", file = fp_c)
+	print("#include <stdint.h>\n#include \"%s\"\n" % Path(sys.argv[2]).name, file = fp_c)
+	print("// Auto-generated file. Please do not edit directly.\n", file = fp_h)
+	print(f"#ifndef {hdr_define}\n#define {hdr_define}\n", file = fp_h)
+	print("#include <stdint.h>\n", file = fp_h)
+
+	print(f"#define TITLEDB_COUNT {len(crcs)}", file = fp_h)
+	print(f"#define TITLEDB_HASH 0x{db_hash:04X}", file = fp_h)
+	print(f"#define TITLEDB_TOKEN_FIRST 0x{TOKEN_FIRST:02X}\n", file = fp_h)
+	print("extern const uint32_t __far titledb_crcs[];", file = fp_h)
+	print("extern const uint16_t __far titledb_name_offsets[];", file = fp_h)
+	print("extern const char __far titledb_names[];", file = fp_h)
+	print("extern const uint16_t __far titledb_token_offsets[];", file = fp_h)
+	print("extern const char __far titledb_tokens[];", file = fp_h)
+	print("\n#endif", file = fp_h)
+
+	print("const uint32_t __far titledb_crcs[] = {", file = fp_c)
+	for crc, t in zip(crcs, titles):
+		print(f"\t0x{crc:08X}, // {t}", file = fp_c)
+	if len(crcs) == 0:
+		print("\t0", file = fp_c)
+	print("};\n", file = fp_c)
+
+	print("const uint16_t __far titledb_name_offsets[] = {", file = fp_c)
+	print("\t" + (", ".join(str(x) for x in name_offsets) if len(name_offsets) > 0 else "0"), file = fp_c)
+	print("};\n", file = fp_c)
+
+	print("const char __far titledb_names[] = {", file = fp_c)
+	print("\t" + (c_bytes(names) if len(names) > 0 else "0"), file = fp_c)
+	print("};\n", file = fp_c)
+
+	print("const uint16_t __far titledb_token_offsets[] = {", file = fp_c)
+	print("\t" + (", ".join(str(x) for x in token_offsets) if len(token_offsets) > 0 else "0"), file = fp_c)
+	print("};\n", file = fp_c)
+
+	print("const char __far titledb_tokens[] = {", file = fp_c)
+	print("\t" + (c_bytes(token_data) if len(token_data) > 0 else "0"), file = fp_c)
+	print("};", file = fp_c)
+
+print("%d titles, %d bytes of names, %d tokens" % (len(crcs), len(names) + len(token_data), len(tokens)), file = sys.stderr)
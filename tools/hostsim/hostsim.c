@@ -0,0 +1,272 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Runs scenario scripts against CartFriend's save and settings code.
+//
+// Usage: hostsim [--image <file>] [--keep] <scenario>...
+//
+// Each scenario starts from an erased image (hostsim.img by default), and
+// its totals are reported at the end. With --keep, the image and totals
+// carry over between scenarios and runs instead, so that wear can be
+// followed over many of them. Each scenario line is a command:
+//
+//   boot                      power on: load the settings, as main() does
+//   launch <slot> <block>     launch a game slot with a save block (or "none")
+//   switch <block>            switch the active save block (or "none")
+//   unload                    back up and unload the active save block
+//   game-write <bank> <offset> <len> <byte>
+//                             the running game writes to SRAM
+//   settings-save [count]     change and save the settings count times
+//   settings-erase            erase the settings copies, as when they wrap
+//   settings-theme <value>    set the color theme and save the settings
+//   settings-corrupt          clear the CRC of the newest settings copy, as
+//                             if it had failed to program
+//   expect-theme <value>      fail unless the loaded color theme is value
+//   flags1 <value>            set settings flags1 (see SETT_FLAGS1_*)
+//   erase-all-saves           erase all save blocks, as on first boot
+//   cost <name> <us>          change a modelled duration (see hostsim.h)
+//   report                    print the totals so far
+//
+// Everything after '#' is a comment.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver.h"
+#include "hostsim.h"
+#include "settings.h"
+#include "sram.h"
+
+typedef struct {
+    const char *name;
+    uint32_t *value;
+} cost_entry_t;
+
+static const cost_entry_t cost_entries[] = {
+    {"slot_switch", &hostsim_costs.slot_switch},
+    {"avr_toggle", &hostsim_costs.avr_toggle},
+    {"sector_erase", &hostsim_costs.sector_erase},
+    {"buffer_program", &hostsim_costs.buffer_program},
+    {"byte_program", &hostsim_costs.byte_program},
+    {"read_kb", &hostsim_costs.read_kb},
+    {"sram_copy_kb", &hostsim_costs.sram_copy_kb},
+    {NULL, NULL}
+};
+
+extern uint8_t settings_slot; // settings.c
+
+static uint32_t *erases_at_start;
+static bool expect_failed;
+
+static bool parse_block(const char *s, uint8_t *block) {
+    if (!strcmp(s, "none")) {
+        *block = SRAM_SLOT_NONE;
+        return true;
+    }
+    char *end;
+    long v = strtol(s, &end, 0);
+    if (*end || v < 0 || v >= SRAM_SLOTS) return false;
+    *block = v;
+    return true;
+}
+
+static void print_report(void) {
+    uint32_t max_erases = 0, max_sector = 0;
+    for (uint32_t i = 0; i < HOSTSIM_SECTORS; i++) {
+        uint32_t erases = hostsim_sector_erases[i] - erases_at_start[i];
+        if (erases > max_erases) {
+            max_erases = erases;
+            max_sector = i;
+        }
+    }
+
+    printf("simulated time:   %llu.%03llu s\n",
+        (unsigned long long) (hostsim_stats.time_us / 1000000),
+        (unsigned long long) (hostsim_stats.time_us / 1000 % 1000));
+    printf("launches:         %u\n", hostsim_stats.launches);
+    printf("slot switches:    %u\n", hostsim_stats.slot_switches);
+    printf("AVR wakeups:      %u\n", hostsim_stats.avr_wakes);
+    printf("sector erases:    %u\n", hostsim_stats.erases);
+    if (max_erases > 0) {
+        uint32_t sectors_per_slot = HOSTSIM_SLOT_SIZE / HOSTSIM_SECTOR_SIZE;
+        printf("most erased:      slot %u, bank %02X (%u erases)\n",
+            max_sector / sectors_per_slot, (max_sector % sectors_per_slot) * 2, max_erases);
+    }
+    printf("buffered writes:  %u\n", hostsim_stats.buffer_programs);
+    printf("byte programs:    %u\n", hostsim_stats.byte_programs);
+    printf("bytes programmed: %llu\n", (unsigned long long) hostsim_stats.bytes_programmed);
+    printf("bytes read:       %llu\n", (unsigned long long) hostsim_stats.bytes_read);
+    printf("program faults:   %u\n", hostsim_stats.program_faults);
+}
+
+static void cmd_launch(uint8_t slot, uint8_t block) {
+    // as ui_browse_launch()
+    if (block != SRAM_SLOT_NONE) {
+        sram_switch_to_slot(block, SRAM_OFFSET_SIZE_DEFAULT);
+    } else if (settings_local.active_sram_slot == SRAM_SLOT_FIRST_BOOT) {
+        settings_local.active_sram_slot = SRAM_SLOT_NONE;
+        settings_local.active_sram_offset_size = SRAM_OFFSET_SIZE_DEFAULT;
+        settings_mark_changed();
+    }
+    launch_slot(slot, 0xFF);
+}
+
+static bool run_command(int argc, char **argv) {
+    uint8_t block;
+
+    if (!strcmp(argv[0], "boot") && argc == 1) {
+        driver_init();
+        settings_load();
+    } else if (!strcmp(argv[0], "launch") && argc == 3 && parse_block(argv[2], &block)) {
+        cmd_launch(strtol(argv[1], NULL, 0) & 0xF, block);
+    } else if (!strcmp(argv[0], "switch") && argc == 2 && parse_block(argv[1], &block)) {
+        sram_switch_to_slot(block, SRAM_OFFSET_SIZE_DEFAULT);
+    } else if (!strcmp(argv[0], "unload") && argc == 1) {
+        sram_unload();
+    } else if (!strcmp(argv[0], "game-write") && argc == 5) {
+        uint32_t addr = (strtoul(argv[1], NULL, 0) << 16) + strtoul(argv[2], NULL, 0);
+        uint32_t len = strtoul(argv[3], NULL, 0);
+        for (uint32_t i = 0; i < len; i++) {
+            *hostsim_sram(addr + i) = strtoul(argv[4], NULL, 0);
+        }
+    } else if (!strcmp(argv[0], "settings-save") && argc <= 2) {
+        long count = argc == 2 ? strtol(argv[1], NULL, 0) : 1;
+        for (long i = 0; i < count; i++) {
+            settings_local.color_theme ^= 1;
+            settings_mark_changed();
+            settings_save();
+        }
+    } else if (!strcmp(argv[0], "settings-erase") && argc == 1) {
+        settings_erase_slots();
+    } else if (!strcmp(argv[0], "settings-theme") && argc == 2) {
+        settings_local.color_theme = strtoul(argv[1], NULL, 0);
+        settings_mark_changed();
+        settings_save();
+    } else if (!strcmp(argv[0], "settings-corrupt") && argc == 1) {
+        uint32_t addr = ((uint32_t) (SETTINGS_BANK + (settings_slot >> 6)) << 16) + (settings_slot << 10) + 1022;
+        hostsim_flash_program(driver_get_launch_slot(), addr, 0x00);
+        hostsim_flash_program(driver_get_launch_slot(), addr + 1, 0x00);
+    } else if (!strcmp(argv[0], "expect-theme") && argc == 2) {
+        uint8_t expected = strtoul(argv[1], NULL, 0);
+        if (settings_local.color_theme != expected) {
+            fprintf(stderr, "expected color theme %u, loaded %u\n", expected, settings_local.color_theme);
+            expect_failed = true;
+        }
+    } else if (!strcmp(argv[0], "flags1") && argc == 2) {
+        settings_local.flags1 = strtoul(argv[1], NULL, 0);
+        settings_mark_changed();
+    } else if (!strcmp(argv[0], "erase-all-saves") && argc == 1) {
+        sram_erase(SRAM_SLOT_ALL, SRAM_OFFSET_SIZE_DEFAULT);
+    } else if (!strcmp(argv[0], "cost") && argc == 3) {
+        for (const cost_entry_t *entry = cost_entries; entry->name; entry++) {
+            if (!strcmp(entry->name, argv[1])) {
+                *entry->value = strtoul(argv[2], NULL, 0);
+                return true;
+            }
+        }
+        return false;
+    } else if (!strcmp(argv[0], "report") && argc == 1) {
+        print_report();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool run_scenario(const char *filename) {
+    char line[256];
+    char *argv[8];
+    int line_no = 0;
+
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        perror(filename);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = 0;
+
+        int argc = 0;
+        for (char *tok = strtok(line, " \t\r\n"); tok && argc < 8; tok = strtok(NULL, " \t\r\n")) {
+            argv[argc++] = tok;
+        }
+        if (argc == 0) continue;
+
+        uint64_t time_us = hostsim_stats.time_us;
+        uint32_t erases = hostsim_stats.erases;
+        if (!run_command(argc, argv)) {
+            fprintf(stderr, "%s:%d: invalid command\n", filename, line_no);
+            fclose(file);
+            return false;
+        }
+        if (expect_failed) {
+            fprintf(stderr, "%s:%d: check failed\n", filename, line_no);
+            fclose(file);
+            return false;
+        }
+        printf("%s:%d: %-16s %9llu ms, %u erases\n", filename, line_no, argv[0],
+            (unsigned long long) ((hostsim_stats.time_us - time_us) / 1000),
+            hostsim_stats.erases - erases);
+    }
+
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *image_filename = "hostsim.img";
+    bool keep = false;
+    int i = 1;
+
+    while (i < argc && !strncmp(argv[i], "--", 2)) {
+        if (!strcmp(argv[i], "--image") && i + 1 < argc) {
+            image_filename = argv[i + 1];
+            i += 2;
+        } else if (!strcmp(argv[i], "--keep")) {
+            keep = true;
+            i++;
+        } else {
+            i = argc;
+        }
+    }
+    if (i >= argc) {
+        fprintf(stderr, "usage: %s [--image <file>] [--keep] <scenario>...\n", argv[0]);
+        return 1;
+    }
+
+    erases_at_start = malloc(HOSTSIM_SECTORS * sizeof(uint32_t));
+
+    bool result = true;
+    for (int first = i; i < argc && result; i++) {
+        if (!hostsim_open(image_filename, !keep)) {
+            perror(image_filename);
+            result = false;
+            break;
+        }
+        if (!keep || i == first) {
+            memcpy(erases_at_start, hostsim_sector_erases, HOSTSIM_SECTORS * sizeof(uint32_t));
+        }
+        result = run_scenario(argv[i]);
+        printf("\n");
+        print_report();
+        hostsim_close();
+    }
+
+    free(erases_at_start);
+    return result ? 0 : 1;
+}
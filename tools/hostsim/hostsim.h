@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HOSTSIM_SLOTS 16
+#define HOSTSIM_SLOT_SIZE (256UL << 16)
+#define HOSTSIM_SECTOR_SIZE 0x20000
+#define HOSTSIM_SECTORS (HOSTSIM_SLOTS * (HOSTSIM_SLOT_SIZE / HOSTSIM_SECTOR_SIZE))
+#define HOSTSIM_SRAM_SIZE 0x80000
+
+// Modelled durations, in microseconds. The defaults are typical datasheet
+// values for the cartridge's NOR flash and rough measurements; all can be
+// changed with "cost" scenario commands.
+typedef struct {
+    uint32_t slot_switch; // to another slot, or back to the launch slot
+    uint32_t avr_toggle; // driver_unlock()/driver_lock() waking/sleeping the AVR
+    uint32_t sector_erase; // 0x30
+    uint32_t buffer_program; // 0x25/0x29, per buffer of up to 256 bytes
+    uint32_t byte_program; // 0xA0 within unlock bypass, per byte
+    uint32_t read_kb; // CPU copy or CRC of 1 KB of flash
+    uint32_t sram_copy_kb; // CPU copy of 1 KB between SRAM and flash/RAM
+} hostsim_costs_t;
+
+typedef struct {
+    uint64_t time_us;
+    uint32_t slot_switches;
+    uint32_t avr_wakes;
+    uint32_t erases;
+    uint32_t buffer_programs;
+    uint32_t byte_programs;
+    uint32_t program_faults; // attempts to program a 0 bit back to 1
+    uint64_t bytes_read;
+    uint64_t bytes_programmed;
+    uint32_t launches;
+} hostsim_stats_t;
+
+extern hostsim_costs_t hostsim_costs;
+extern hostsim_stats_t hostsim_stats;
+
+// Erases per 128 KB sector since the image was created.
+extern uint32_t *hostsim_sector_erases;
+
+// hostsim_hw.c
+// Maps the image at path and resets the costs; if fresh, the image is
+// erased first and the statistics are reset.
+bool hostsim_open(const char *path, bool fresh);
+void hostsim_close(void);
+void hostsim_charge(uint64_t us);
+uint8_t hostsim_flash_read(uint8_t slot, uint32_t addr);
+void hostsim_flash_program(uint8_t slot, uint32_t addr, uint8_t value);
+void hostsim_flash_erase(uint8_t slot, uint32_t addr);
+uint8_t *hostsim_sram(uint32_t addr);
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Model of the Flash Masta driver (src/flash_masta), following what it
+// does on the cartridge:
+// - the slot is switched to and back (~12 ms each) unless it is the launch
+//   slot, which stays mapped;
+// - writes enter unlock bypass (0x20); writes of up to 256 bytes within one
+//   512-byte block use a buffered program (0x25/0x29) unless buffered writes
+//   are disabled in the settings, the rest are programmed a byte at a time;
+// - programming can only clear bits; erases (0x30) set a 128 KB sector to
+//   0xFF and are no-ops for odd banks.
+// driver_stats is kept as the driver keeps it, but without busy polls.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ws.h>
+#include "driver.h"
+#include "error.h"
+#include "hostsim.h"
+#include "settings.h"
+
+uint8_t driver_irq_passthrough;
+driver_stats_t driver_stats;
+static uint8_t unlock_refcount;
+
+static void driver_switch(uint16_t slot) {
+    if ((slot & 0xF) != driver_get_launch_slot()) {
+        hostsim_stats.slot_switches += 2;
+        driver_stats.slot_switches += 2;
+        hostsim_charge(hostsim_costs.slot_switch * 2);
+    }
+}
+
+static uint32_t driver_addr(uint16_t bank, uint16_t offset) {
+    return ((uint32_t) (bank & 0xFF) << 16) | offset;
+}
+
+static void driver_charge_read(uint32_t len) {
+    hostsim_stats.bytes_read += len;
+    hostsim_charge((uint64_t) len * hostsim_costs.read_kb / 1024);
+}
+
+void driver_init(void) {
+    unlock_refcount = 0;
+}
+
+// As on the cartridge, the AVR is only woken up by the first unlock.
+void driver_unlock(void) {
+    if (unlock_refcount == 0) {
+        unlock_refcount = 1;
+        hostsim_stats.avr_wakes++;
+        driver_stats.avr_wakes++;
+        hostsim_charge(hostsim_costs.avr_toggle);
+    }
+}
+
+void driver_lock(void) {
+    if (unlock_refcount == 0) {
+        error_critical(ERROR_CODE_LOCK_UNDERFLOW, 0);
+    }
+    if (--unlock_refcount == 0) {
+        driver_stats.avr_sleeps++;
+        hostsim_charge(hostsim_costs.avr_toggle);
+    }
+}
+
+uint8_t driver_get_launch_slot(void) {
+    return 0;
+}
+
+bool driver_read_slot(void *ptr, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) __far {
+    driver_switch(slot);
+    for (uint16_t i = 0; i < len; i++) {
+        ((uint8_t*) ptr)[i] = hostsim_flash_read(slot, driver_addr(bank, offset + i));
+    }
+    driver_charge_read(len);
+    driver_stats.bytes_read += len;
+    return true;
+}
+
+static uint32_t driver_crc32_bank(uint32_t crc, uint16_t slot, uint16_t bank, const uint32_t *table, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        crc = table[(crc ^ hostsim_flash_read(slot, driver_addr(bank, i))) & 0xFF] ^ (crc >> 8);
+    }
+    driver_charge_read(len);
+    driver_stats.bytes_read += len;
+    return crc;
+}
+
+bool driver_crc32_slot(uint32_t *crc, uint16_t slot, uint16_t bank, const uint32_t *table, uint16_t len) __far {
+    driver_switch(slot);
+    *crc = driver_crc32_bank(*crc, slot, bank, table, len ? len : 0x10000);
+    return true;
+}
+
+bool driver_crc32_sectors(uint32_t *crcs, uint16_t slot, uint16_t bank, const uint32_t *table, uint16_t count) __far {
+    driver_switch(slot);
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t sector = ((bank + i) >> 1) - (bank >> 1);
+        crcs[sector] = driver_crc32_bank(crcs[sector], slot, bank + i, table, 0x10000);
+    }
+    return true;
+}
+
+static bool driver_write(const void *data, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len, bool verify) {
+    const uint8_t *src = data;
+    driver_switch(slot);
+
+    if (len <= 256 && !(((offset + len - 1) ^ offset) & 0xFE00)
+        && !(settings_local.flags1 & SETT_FLAGS1_DISABLE_BUFFERED_WRITES)) {
+        hostsim_stats.buffer_programs++;
+        driver_stats.buffered_writes++;
+        hostsim_charge(hostsim_costs.buffer_program);
+    } else {
+        hostsim_stats.byte_programs += len;
+        driver_stats.byte_writes++;
+        hostsim_charge((uint64_t) len * hostsim_costs.byte_program);
+    }
+    hostsim_stats.bytes_programmed += len;
+    driver_stats.bytes_programmed += len;
+
+    bool result = true;
+    for (uint16_t i = 0; i < len; i++) {
+        uint32_t addr = driver_addr(bank, offset + i);
+        hostsim_flash_program(slot, addr, src[i]);
+        if (verify && hostsim_flash_read(slot, addr) != src[i]) result = false;
+    }
+    if (verify) driver_charge_read(len);
+    return result;
+}
+
+bool driver_write_slot(const void *data, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) __far {
+    driver_write(data, slot, bank, offset, len, false);
+    return true;
+}
+
+bool driver_write_slot_verify(const void *data, uint16_t slot, uint16_t bank, uint16_t offset, uint16_t len) __far {
+    return driver_write(data, slot, bank, offset, len, true);
+}
+
+bool driver_erase_sector(uint16_t unused, uint16_t slot, uint16_t bank) __far {
+    if (bank & 1) return true;
+    driver_switch(slot);
+    hostsim_flash_erase(slot, driver_addr(bank, 0));
+    hostsim_stats.erases++;
+    driver_stats.erases++;
+    hostsim_charge(hostsim_costs.sector_erase);
+    return true;
+}
+
+// The game takes over; the driver is locked again on the way out.
+void driver_launch_slot(uint16_t unused, uint16_t slot, uint16_t bank) __far {
+    unlock_refcount = 0;
+    hostsim_stats.launches++;
+    hostsim_stats.slot_switches++;
+    hostsim_charge(hostsim_costs.slot_switch);
+}
+
+void launch_ram_asm(const void __far *ptr) {
+    hostsim_stats.launches++;
+}
+
+// sram_asm.s
+
+bool sram_copy_to_buffer_check_flash(void* restrict s1, uint16_t offset) {
+    const uint8_t *src = MK_FP(0x1000, offset);
+    memcpy(s1, src, 256);
+    hostsim_charge(hostsim_costs.sram_copy_kb / 4);
+    for (uint16_t i = 0; i < 256; i++) {
+        if (src[i] != 0xFF) return true;
+    }
+    return false;
+}
+
+bool sram_copy_from_bank1(uint16_t offset, uint16_t words) {
+    uint8_t *dest = MK_FP(0x1000, offset);
+    uint32_t bank = inportb(IO_BANK_ROM1);
+    for (uint32_t i = 0; i < (uint32_t) words * 2; i++) {
+        dest[i] = hostsim_flash_read(driver_get_launch_slot(), (bank << 16) | (uint16_t) (offset + i));
+    }
+    hostsim_charge((uint64_t) words * hostsim_costs.sram_copy_kb / 512);
+    return true;
+}
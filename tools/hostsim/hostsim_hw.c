@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Simulated console and cartridge memory.
+//
+// The image file holds, in order: 16 slots of 16 MB flash, 512 KB of SRAM
+// and the per-sector erase counters. Flash is stored inverted, so that a
+// new (sparse, zero-filled) image reads back as erased.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <ws.h>
+#include "driver.h"
+#include "hostsim.h"
+
+#define IMAGE_FLASH_SIZE ((uint64_t) HOSTSIM_SLOTS * HOSTSIM_SLOT_SIZE)
+#define IMAGE_SIZE (IMAGE_FLASH_SIZE + HOSTSIM_SRAM_SIZE + HOSTSIM_SECTORS * sizeof(uint32_t))
+
+// 75.47 Hz
+#define FRAME_US 13250
+
+static const hostsim_costs_t default_costs = {
+    .slot_switch = 12000,
+    .avr_toggle = 12000,
+    .sector_erase = 500000,
+    .buffer_program = 340,
+    .byte_program = 60,
+    .read_kb = 700,
+    .sram_copy_kb = 1400
+};
+hostsim_costs_t hostsim_costs;
+hostsim_stats_t hostsim_stats;
+uint32_t *hostsim_sector_erases;
+
+uint8_t hostsim_iram[0x10000];
+volatile uint16_t vbl_ticks;
+
+static uint8_t *image;
+static uint8_t ports[0x100];
+static uint8_t rom_shadow[0x10000];
+
+bool hostsim_open(const char *path, bool fresh) {
+    int fd = open(path, O_RDWR | O_CREAT | (fresh ? O_TRUNC : 0), 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, IMAGE_SIZE) < 0) {
+        close(fd);
+        return false;
+    }
+    image = mmap(NULL, IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return false;
+
+    hostsim_sector_erases = (uint32_t*) (image + IMAGE_FLASH_SIZE + HOSTSIM_SRAM_SIZE);
+    ports[IO_SYSTEM_CTRL1] = SYSTEM_CTRL1_IPL_LOCKED;
+    hostsim_costs = default_costs;
+    if (fresh) {
+        memset(&hostsim_stats, 0, sizeof(hostsim_stats));
+        vbl_ticks = 0;
+    }
+    return true;
+}
+
+void hostsim_close(void) {
+    munmap(image, IMAGE_SIZE);
+}
+
+void hostsim_charge(uint64_t us) {
+    hostsim_stats.time_us += us;
+    vbl_ticks = hostsim_stats.time_us / FRAME_US;
+}
+
+static uint8_t *flash_ptr(uint8_t slot, uint32_t addr) {
+    return image + ((uint64_t) (slot & 0xF) * HOSTSIM_SLOT_SIZE) + (addr & (HOSTSIM_SLOT_SIZE - 1));
+}
+
+uint8_t hostsim_flash_read(uint8_t slot, uint32_t addr) {
+    return ~(*flash_ptr(slot, addr));
+}
+
+// Programming can only clear bits.
+void hostsim_flash_program(uint8_t slot, uint32_t addr, uint8_t value) {
+    uint8_t *ptr = flash_ptr(slot, addr);
+    uint8_t prev = ~(*ptr);
+    if (value & ~prev) hostsim_stats.program_faults++;
+    *ptr = ~(prev & value);
+}
+
+void hostsim_flash_erase(uint8_t slot, uint32_t addr) {
+    addr &= ~(HOSTSIM_SECTOR_SIZE - 1);
+    memset(flash_ptr(slot, addr), 0, HOSTSIM_SECTOR_SIZE);
+    hostsim_sector_erases[((slot & 0xF) * HOSTSIM_SLOT_SIZE + addr) / HOSTSIM_SECTOR_SIZE]++;
+}
+
+uint8_t *hostsim_sram(uint32_t addr) {
+    return image + IMAGE_FLASH_SIZE + (addr & (HOSTSIM_SRAM_SIZE - 1));
+}
+
+// Far pointers. The cartridge is mapped to the launch slot while CartFriend
+// runs; ROM windows are copied out of flash whenever a pointer into them is
+// made, so that they are never out of date.
+void *hostsim_ptr(uint16_t segment, uint16_t offset) {
+    if (segment < 0x1000) {
+        return hostsim_iram + ((((uint32_t) segment << 4) + offset) & 0xFFFF);
+    } else if (segment == 0x1000) {
+        return hostsim_sram(((uint32_t) ports[IO_BANK_RAM] << 16) | offset);
+    } else if (segment == 0x2000 || segment == 0x3000) {
+        uint32_t bank = ports[segment == 0x2000 ? IO_BANK_ROM0 : IO_BANK_ROM1];
+        for (uint32_t i = 0; i < 0x10000; i++) {
+            rom_shadow[i] = hostsim_flash_read(driver_get_launch_slot(), (bank << 16) | i);
+        }
+        return rom_shadow + offset;
+    }
+    fprintf(stderr, "hostsim: unsupported far pointer %04X:%04X\n", segment, offset);
+    exit(1);
+}
+
+void outportb(uint16_t port, uint8_t value) {
+    ports[port & 0xFF] = value;
+}
+
+void outportw(uint16_t port, uint16_t value) {
+    ports[port & 0xFF] = value;
+    ports[(port + 1) & 0xFF] = value >> 8;
+}
+
+uint8_t inportb(uint16_t port) {
+    return inportw(port);
+}
+
+uint16_t inportw(uint16_t port) {
+    if (port == IO_HBLANK_COUNTER) {
+        // a free-running line counter at 12 kHz, counting down
+        return 0xFFFF - (uint16_t) (hostsim_stats.time_us * 12 / 1000);
+    }
+    return ports[port & 0xFF] | (ports[(port + 1) & 0xFF] << 8);
+}
+
+// Waits for the next VBlank.
+void cpu_halt(void) {
+    hostsim_charge(FRAME_US - (hostsim_stats.time_us % FRAME_US));
+}
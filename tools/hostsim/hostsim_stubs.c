@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// The UI, input, serial and deployment modules are not simulated: the
+// scenarios drive the firmware directly, with no screen and no keypresses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ws.h>
+#include "deploy.h"
+#include "error.h"
+#include "hostsim.h"
+#include "input.h"
+#include "progress.h"
+#include "ui.h"
+#include "xmodem.h"
+
+static const char __far* const hostsim_lang_keys[LK_TOTAL];
+const char __far* const __far* lang_keys = hostsim_lang_keys;
+uint8_t ui_current_tab;
+
+void ui_show(void) {}
+void ui_reset_main_screen(void) {}
+void ui_puts_centered(bool alt_screen, uint8_t y, uint8_t color, const char __far* buf) {}
+void ui_update_theme(uint8_t current_theme) {}
+void ui_set_current_tab(uint8_t tab) {}
+void ui_update_indicators(void) {}
+void ui_step_work_indicator(void) {}
+void ui_clear_work_indicator(void) {}
+void ui_tool_xmodem_ui_message(uint16_t lk_msg) {}
+
+// Dialogs take the first option (OK/resume).
+uint8_t ui_dialog_run(uint16_t flags, uint8_t initial_option, uint16_t lk_question, uint16_t lk_options) {
+    return 0;
+}
+
+volatile uint32_t progress_done;
+void progress_start(uint8_t y, uint32_t total) {}
+void progress_finish(void) {}
+
+uint16_t input_pressed, input_held;
+void input_update(void) {}
+
+void xmodem_open(uint8_t baudrate) {}
+void xmodem_close(void) {}
+bool xmodem_poll_exit(void) { return true; }
+uint8_t xmodem_send_start(void) { return XMODEM_ERROR; }
+uint8_t xmodem_send_block(const uint8_t __far* block, uint16_t len) { return XMODEM_ERROR; }
+uint8_t xmodem_send_finish(void) { return XMODEM_ERROR; }
+uint8_t xmodem_recv_start(void) { return XMODEM_ERROR; }
+uint8_t xmodem_recv_block(uint8_t __far* block, uint16_t *len) { return XMODEM_ERROR; }
+uint8_t xmodem_recv_finish(void) { return XMODEM_ERROR; }
+void xmodem_recv_cancel(void) {}
+
+bool deploy_write_chunk(const uint8_t *data, uint8_t slot, uint32_t pos, uint16_t len) {
+    return false;
+}
+
+void error_critical(uint16_t code, uint16_t extra) __far {
+    fprintf(stderr, "hostsim: critical error %04X:%04X\n", code, extra);
+    exit(1);
+}
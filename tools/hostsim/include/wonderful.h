@@ -0,0 +1,52 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Host stand-in for the parts of Wonderful's wonderful.h used by the
+// firmware modules built into hostsim, and by the assembly kernels built
+// into v30sim.
+
+#pragma once
+
+#ifdef __ASSEMBLER__
+
+// medium memory model: functions are far
+#define IA16_RET retf
+#define ASM_PLATFORM_RET retf
+
+#else
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define __far
+#define __wf_rom
+
+// Far pointers into the cartridge windows are resolved against the
+// simulated SRAM and flash; see hostsim_ptr().
+void *hostsim_ptr(uint16_t segment, uint16_t offset);
+#define MK_FP(s, o) hostsim_ptr((s), (o))
+#define FP_SEG(p) ((uint16_t) 0)
+#define FP_OFF(p) ((uint16_t) (uintptr_t) (p))
+
+// CartFriend runs from cartridge ROM.
+#define _CS ((uint16_t) 0x4000)
+
+#define _nmemset memset
+#define _nmemcpy memcpy
+#define _fmemset memset
+#define _fmemcpy memcpy
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Host stand-in for the parts of Wonderful's ws.h used by the firmware
+// modules built into hostsim, and by the assembly kernels built into v30sim.
+// I/O ports are backed by hostsim_hw.c.
+
+#pragma once
+
+#include <wonderful.h>
+#include "ws/hardware.h"
+#include "ws/system.h"
+
+#define IEEP_PROTECT 0x80
+
+#ifndef __ASSEMBLER__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void outportb(uint16_t port, uint8_t value);
+void outportw(uint16_t port, uint16_t value);
+uint8_t inportb(uint16_t port);
+uint16_t inportw(uint16_t port);
+
+void cpu_halt(void);
+static inline void cpu_irq_disable(void) {}
+static inline void cpu_irq_enable(void) {}
+
+static inline void ws_bank_ram_set(uint8_t bank) {
+    outportb(IO_BANK_RAM, bank);
+}
+
+static inline void ws_hwint_enable(uint8_t mask) {}
+static inline void ws_hwint_disable(uint8_t mask) {}
+static inline void ws_hwint_ack(uint8_t mask) {}
+
+void ws_serial_open(uint8_t baudrate);
+void ws_serial_close(void);
+void ws_serial_putc(uint8_t value);
+
+static inline bool ws_system_color_active(void) {
+    return false;
+}
+
+#define KEY_Y4 0x0800
+#define KEY_Y3 0x0400
+#define KEY_Y2 0x0200
+#define KEY_Y1 0x0100
+#define KEY_X4 0x0080
+#define KEY_X3 0x0040
+#define KEY_X2 0x0020
+#define KEY_X1 0x0010
+#define KEY_B 0x0008
+#define KEY_A 0x0004
+#define KEY_START 0x0002
+
+#define HWINT_SERIAL_TX 0x01
+#define HWINT_SERIAL_RX 0x08
+#define HWINT_VBLANK 0x40
+
+#define SERIAL_BAUD_9600 0x00
+#define SERIAL_BAUD_38400 0x40
+
+#define LCD_SEG_ORIENT_H 0x20
+
+extern uint8_t hostsim_iram[0x10000];
+#define MEM_COLOR_PALETTE(x) ((uint16_t*) (hostsim_iram + 0xFE00 + ((x) << 5)))
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#define IO_DISPLAY_CTRL 0x00
+#define IO_LCD_LINE 0x02
+#define IO_SPR_BASE 0x04
+#define IO_SPR_FIRST 0x05
+#define IO_SPR_COUNT 0x06
+#define IO_SCR_BASE 0x07
+#define IO_SCR1_SCRL_X 0x10
+#define IO_SCR1_SCRL_Y 0x11
+#define IO_SCR2_SCRL_X 0x12
+#define IO_SCR2_SCRL_Y 0x13
+#define IO_LCD_SEG 0x15
+#define IO_SYSTEM_CTRL2 0x60
+#define IO_SYSTEM_CTRL1 0xA0
+#define IO_TIMER_CTRL 0xA2
+#define IO_HBLANK_TIMER 0xA4
+#define IO_HBLANK_COUNTER 0xA8
+#define IO_HWINT_VECTOR 0xB0
+#define IO_SERIAL_DATA 0xB1
+#define IO_HWINT_ENABLE 0xB2
+#define IO_SERIAL_STATUS 0xB3
+#define IO_KEY_SCAN 0xB5
+#define IO_HWINT_ACK 0xB6
+#define IO_INT_NMI_CTRL 0xB7
+#define IO_IEEP_CTRL 0xBE
+#define IO_BANK_ROM_LINEAR 0xC0
+#define IO_BANK_RAM 0xC1
+#define IO_BANK_ROM0 0xC2
+#define IO_BANK_ROM1 0xC3
+#define IO_CART_RTC_CTRL 0xCA
+#define IO_CART_RTC_DATA 0xCB
+#define IO_CART_GPO_CTRL 0xCC
+#define IO_CART_GPO_DATA 0xCD
+#define IO_CART_FLASH 0xCE
+
+#define DISPLAY_SCR1_ENABLE 0x01
+#define DISPLAY_SCR2_ENABLE 0x02
+
+#define CART_RTC_READY 0x80
+#define CART_RTC_ACTIVE 0x10
+
+#define SYSTEM_CTRL1_IPL_LOCKED 0x01
+#define SYSTEM_CTRL1_COLOR 0x02
+#define SYSTEM_CTRL2_SRAM_WAIT 0x08
+#define SYSTEM_CTRL2_CART_IO_WAIT 0x04
@@ -0,0 +1,932 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Cycle counts are the V30MZ's, as listed in WonderSwan emulators, and agree
+// with the counts given in the kernels' comments (lodsw 3, stosw 3, a taken
+// branch 4, loop 5, ...). Not modelled: the prefetch queue, waits other than
+// the bus width (see v30mz_bus_t.word_wait) and interrupts. BCD adjustments,
+// BOUND, ENTER, INS/OUTS and the V30's own extensions are not implemented
+// and stop the run, as does a divide error.
+
+#include <stddef.h>
+#include "v30mz.h"
+
+#define CF V30MZ_FLAG_CF
+#define PF V30MZ_FLAG_PF
+#define AF V30MZ_FLAG_AF
+#define ZF V30MZ_FLAG_ZF
+#define SF V30MZ_FLAG_SF
+#define IF V30MZ_FLAG_IF
+#define DF V30MZ_FLAG_DF
+#define OF V30MZ_FLAG_OF
+
+#define AX (cpu->r[V30MZ_AX])
+#define CX (cpu->r[V30MZ_CX])
+#define DX (cpu->r[V30MZ_DX])
+#define SP (cpu->r[V30MZ_SP])
+#define SI (cpu->r[V30MZ_SI])
+#define DI (cpu->r[V30MZ_DI])
+
+#define CLK(n) (cpu->cycles += (n))
+
+typedef struct {
+    uint8_t mod, reg, rm;
+    uint8_t seg;
+    uint16_t offset;
+} modrm_t;
+
+// per-instruction state
+static int8_t seg_override;
+static uint8_t rep_prefix;
+static uint8_t stop_reason;
+
+static bool parity(uint8_t value) {
+    value ^= value >> 4;
+    value ^= value >> 2;
+    value ^= value >> 1;
+    return !(value & 1);
+}
+
+static void set_flag(v30mz_t *cpu, uint16_t flag, bool set) {
+    if (set) cpu->flags |= flag;
+    else cpu->flags &= ~flag;
+}
+
+static void set_szp(v30mz_t *cpu, bool word, uint16_t value) {
+    if (!word) value &= 0xFF;
+    set_flag(cpu, ZF, value == 0);
+    set_flag(cpu, SF, value & (word ? 0x8000 : 0x80));
+    set_flag(cpu, PF, parity(value));
+}
+
+/* Memory and I/O */
+
+static uint32_t linear(v30mz_t *cpu, uint8_t seg, uint16_t offset) {
+    return (((uint32_t) cpu->sreg[seg] << 4) + offset) & 0xFFFFF;
+}
+
+static uint8_t read8(v30mz_t *cpu, uint8_t seg, uint16_t offset) {
+    return cpu->bus.read(cpu->bus.userdata, linear(cpu, seg, offset));
+}
+
+static void write8(v30mz_t *cpu, uint8_t seg, uint16_t offset, uint8_t value) {
+    cpu->bus.write(cpu->bus.userdata, linear(cpu, seg, offset), value);
+}
+
+static void word_wait(v30mz_t *cpu, uint8_t seg, uint16_t offset) {
+    uint32_t addr = linear(cpu, seg, offset);
+    if (cpu->bus.word_wait) CLK(cpu->bus.word_wait(cpu->bus.userdata, addr));
+    else CLK(addr & 1);
+}
+
+static uint16_t read16(v30mz_t *cpu, uint8_t seg, uint16_t offset) {
+    word_wait(cpu, seg, offset);
+    return read8(cpu, seg, offset) | (read8(cpu, seg, offset + 1) << 8);
+}
+
+static void write16(v30mz_t *cpu, uint8_t seg, uint16_t offset, uint16_t value) {
+    word_wait(cpu, seg, offset);
+    write8(cpu, seg, offset, value);
+    write8(cpu, seg, offset + 1, value >> 8);
+}
+
+static uint8_t fetch8(v30mz_t *cpu) {
+    return read8(cpu, V30MZ_CS, cpu->ip++);
+}
+
+static uint16_t fetch16(v30mz_t *cpu) {
+    uint16_t value = fetch8(cpu);
+    return value | (fetch8(cpu) << 8);
+}
+
+void v30mz_push(v30mz_t *cpu, uint16_t value) {
+    SP -= 2;
+    write16(cpu, V30MZ_SS, SP, value);
+}
+
+static uint16_t pop(v30mz_t *cpu) {
+    uint16_t value = read16(cpu, V30MZ_SS, SP);
+    SP += 2;
+    return value;
+}
+
+static uint16_t port_in(v30mz_t *cpu, uint8_t port, bool word) {
+    uint16_t value = cpu->bus.in(cpu->bus.userdata, port);
+    if (word) value |= cpu->bus.in(cpu->bus.userdata, port + 1) << 8;
+    return value;
+}
+
+static void port_out(v30mz_t *cpu, uint8_t port, bool word, uint16_t value) {
+    cpu->bus.out(cpu->bus.userdata, port, value);
+    if (word) cpu->bus.out(cpu->bus.userdata, port + 1, value >> 8);
+}
+
+/* Registers and ModR/M operands */
+
+uint8_t v30mz_get8(v30mz_t *cpu, uint8_t reg) {
+    return reg & 4 ? cpu->r[reg & 3] >> 8 : cpu->r[reg & 3];
+}
+
+static void set8(v30mz_t *cpu, uint8_t reg, uint8_t value) {
+    if (reg & 4) cpu->r[reg & 3] = (cpu->r[reg & 3] & 0x00FF) | (value << 8);
+    else cpu->r[reg & 3] = (cpu->r[reg & 3] & 0xFF00) | value;
+}
+
+static uint16_t get_reg(v30mz_t *cpu, bool word, uint8_t reg) {
+    return word ? cpu->r[reg] : v30mz_get8(cpu, reg);
+}
+
+static void set_reg(v30mz_t *cpu, bool word, uint8_t reg, uint16_t value) {
+    if (word) cpu->r[reg] = value;
+    else set8(cpu, reg, value);
+}
+
+static uint8_t default_seg(uint8_t seg) {
+    return seg_override >= 0 ? seg_override : seg;
+}
+
+static void decode_modrm(v30mz_t *cpu, modrm_t *m) {
+    uint8_t value = fetch8(cpu);
+    m->mod = value >> 6;
+    m->reg = (value >> 3) & 7;
+    m->rm = value & 7;
+    if (m->mod == 3) return;
+
+    uint16_t bx = cpu->r[V30MZ_BX], bp = cpu->r[V30MZ_BP];
+    m->seg = V30MZ_DS;
+    switch (m->rm) {
+    case 0: m->offset = bx + SI; break;
+    case 1: m->offset = bx + DI; break;
+    case 2: m->offset = bp + SI; m->seg = V30MZ_SS; break;
+    case 3: m->offset = bp + DI; m->seg = V30MZ_SS; break;
+    case 4: m->offset = SI; break;
+    case 5: m->offset = DI; break;
+    case 6:
+        if (m->mod == 0) {
+            m->offset = fetch16(cpu);
+        } else {
+            m->offset = bp;
+            m->seg = V30MZ_SS;
+        }
+        break;
+    case 7: m->offset = bx; break;
+    }
+    if (m->mod == 1) m->offset += (int8_t) fetch8(cpu);
+    else if (m->mod == 2) m->offset += fetch16(cpu);
+    m->seg = default_seg(m->seg);
+}
+
+static uint16_t get_rm(v30mz_t *cpu, const modrm_t *m, bool word) {
+    if (m->mod == 3) return get_reg(cpu, word, m->rm);
+    return word ? read16(cpu, m->seg, m->offset) : read8(cpu, m->seg, m->offset);
+}
+
+static void set_rm(v30mz_t *cpu, const modrm_t *m, bool word, uint16_t value) {
+    if (m->mod == 3) set_reg(cpu, word, m->rm, value);
+    else if (word) write16(cpu, m->seg, m->offset, value);
+    else write8(cpu, m->seg, m->offset, value);
+}
+
+/* Arithmetic */
+
+// op: 0 ADD, 1 OR, 2 ADC, 3 SBB, 4 AND, 5 SUB, 6 XOR, 7 CMP
+static uint16_t alu(v30mz_t *cpu, uint8_t op, bool word, uint16_t a, uint16_t b) {
+    uint32_t mask = word ? 0xFFFF : 0xFF;
+    uint32_t sign = word ? 0x8000 : 0x80;
+    uint32_t carry = (op == 2 || op == 3) && (cpu->flags & CF) ? 1 : 0;
+    uint32_t result;
+
+    switch (op) {
+    case 0: case 2:
+        result = (uint32_t) a + b + carry;
+        set_flag(cpu, CF, result > mask);
+        set_flag(cpu, OF, (result ^ a) & (result ^ b) & sign);
+        set_flag(cpu, AF, (a ^ b ^ result) & 0x10);
+        break;
+    case 3: case 5: case 7:
+        result = (uint32_t) a - b - carry;
+        set_flag(cpu, CF, (uint32_t) b + carry > a);
+        set_flag(cpu, OF, (a ^ b) & (a ^ result) & sign);
+        set_flag(cpu, AF, (a ^ b ^ result) & 0x10);
+        break;
+    default:
+        result = op == 1 ? (a | b) : op == 4 ? (a & b) : (a ^ b);
+        cpu->flags &= ~(CF | OF | AF);
+        break;
+    }
+    set_szp(cpu, word, result);
+    return result & mask;
+}
+
+static uint16_t inc_dec(v30mz_t *cpu, bool word, uint16_t value, bool dec) {
+    uint16_t flags = cpu->flags & CF;
+    uint16_t result = alu(cpu, dec ? 5 : 0, word, value, 1);
+    cpu->flags = (cpu->flags & ~CF) | flags;
+    return result;
+}
+
+// op: 0 ROL, 1 ROR, 2 RCL, 3 RCR, 4 SHL, 5 SHR, 6 SHL, 7 SAR
+static uint16_t shift(v30mz_t *cpu, uint8_t op, bool word, uint16_t value, uint8_t count) {
+    uint16_t sign = word ? 0x8000 : 0x80;
+    uint16_t mask = word ? 0xFFFF : 0xFF;
+
+    count &= 0x1F;
+    if (count == 0) return value;
+    for (uint8_t i = 0; i < count; i++) {
+        bool cf = cpu->flags & CF;
+        switch (op) {
+        case 0:
+            cf = value & sign;
+            value = (value << 1) | cf;
+            break;
+        case 1:
+            cf = value & 1;
+            value = (value >> 1) | (cf ? sign : 0);
+            break;
+        case 2: {
+            bool out = value & sign;
+            value = (value << 1) | cf;
+            cf = out;
+        } break;
+        case 3: {
+            bool out = value & 1;
+            value = (value >> 1) | (cf ? sign : 0);
+            cf = out;
+        } break;
+        case 4: case 6:
+            cf = value & sign;
+            value <<= 1;
+            break;
+        case 5:
+            cf = value & 1;
+            value >>= 1;
+            break;
+        case 7:
+            cf = value & 1;
+            value = (value >> 1) | (value & sign);
+            break;
+        }
+        value &= mask;
+        set_flag(cpu, CF, cf);
+    }
+
+    bool msb = value & sign;
+    switch (op) {
+    case 0: case 2:
+        set_flag(cpu, OF, msb != !!(cpu->flags & CF));
+        break;
+    case 1: case 3:
+        set_flag(cpu, OF, msb != !!(value & (sign >> 1)));
+        break;
+    default:
+        set_flag(cpu, OF, op == 5 ? count == 1 && (value & (sign >> 1)) : op == 7 ? false : msb != !!(cpu->flags & CF));
+        set_szp(cpu, word, value);
+        break;
+    }
+    return value;
+}
+
+// F6/F7 /4../7; returns false on a divide error
+static bool mul_div(v30mz_t *cpu, uint8_t op, bool word, uint16_t value) {
+    if (!word) {
+        switch (op) {
+        case 4:
+            AX = (AX & 0xFF) * value;
+            set_flag(cpu, CF | OF, AX >> 8);
+            CLK(3);
+            return true;
+        case 5:
+            AX = (int8_t) AX * (int8_t) value;
+            set_flag(cpu, CF | OF, (int16_t) AX != (int8_t) AX);
+            CLK(3);
+            return true;
+        case 6: {
+            if (value == 0 || AX / value > 0xFF) return false;
+            uint16_t q = AX / value, r = AX % value;
+            AX = (r << 8) | q;
+            CLK(15);
+            return true;
+        }
+        default: {
+            if ((int8_t) value == 0) return false;
+            int16_t q = (int16_t) AX / (int8_t) value, r = (int16_t) AX % (int8_t) value;
+            if (q > 127 || q < -128) return false;
+            AX = ((r & 0xFF) << 8) | (q & 0xFF);
+            CLK(17);
+            return true;
+        }
+        }
+    }
+
+    switch (op) {
+    case 4: {
+        uint32_t result = (uint32_t) AX * value;
+        AX = result;
+        DX = result >> 16;
+        set_flag(cpu, CF | OF, DX != 0);
+        CLK(4);
+        return true;
+    }
+    case 5: {
+        int32_t result = (int32_t) (int16_t) AX * (int16_t) value;
+        AX = result;
+        DX = result >> 16;
+        set_flag(cpu, CF | OF, result != (int16_t) result);
+        CLK(4);
+        return true;
+    }
+    case 6: {
+        uint32_t dividend = ((uint32_t) DX << 16) | AX;
+        if (value == 0 || dividend / value > 0xFFFF) return false;
+        AX = dividend / value;
+        DX = dividend % value;
+        CLK(23);
+        return true;
+    }
+    default: {
+        int32_t dividend = (int32_t) (((uint32_t) DX << 16) | AX);
+        if ((int16_t) value == 0) return false;
+        int32_t q = dividend / (int16_t) value, r = dividend % (int16_t) value;
+        if (q > 32767 || q < -32768) return false;
+        AX = q;
+        DX = r;
+        CLK(24);
+        return true;
+    }
+    }
+}
+
+static bool condition(v30mz_t *cpu, uint8_t cc) {
+    uint16_t f = cpu->flags;
+    bool result;
+    switch (cc >> 1) {
+    case 0: result = f & OF; break;
+    case 1: result = f & CF; break;
+    case 2: result = f & ZF; break;
+    case 3: result = (f & CF) || (f & ZF); break;
+    case 4: result = f & SF; break;
+    case 5: result = f & PF; break;
+    case 6: result = !(f & SF) != !(f & OF); break;
+    default: result = (f & ZF) || (!(f & SF) != !(f & OF)); break;
+    }
+    return (cc & 1) ? !result : result;
+}
+
+static void jump_short(v30mz_t *cpu, bool taken, uint8_t taken_cycles, uint8_t not_taken_cycles) {
+    int8_t disp = fetch8(cpu);
+    if (taken) {
+        cpu->ip += disp;
+        CLK(taken_cycles);
+    } else {
+        CLK(not_taken_cycles);
+    }
+}
+
+/* String instructions */
+
+// A4..AF; one iteration
+static void string_step(v30mz_t *cpu, uint8_t op) {
+    bool word = op & 1;
+    int16_t delta = (cpu->flags & DF ? -1 : 1) * (word ? 2 : 1);
+    uint8_t src_seg = default_seg(V30MZ_DS);
+
+    switch (op & ~1) {
+    case 0xA4: // MOVS
+        if (word) write16(cpu, V30MZ_ES, DI, read16(cpu, src_seg, SI));
+        else write8(cpu, V30MZ_ES, DI, read8(cpu, src_seg, SI));
+        SI += delta;
+        DI += delta;
+        CLK(5);
+        break;
+    case 0xA6: // CMPS
+        if (word) alu(cpu, 7, true, read16(cpu, src_seg, SI), read16(cpu, V30MZ_ES, DI));
+        else alu(cpu, 7, false, read8(cpu, src_seg, SI), read8(cpu, V30MZ_ES, DI));
+        SI += delta;
+        DI += delta;
+        CLK(6);
+        break;
+    case 0xAA: // STOS
+        if (word) write16(cpu, V30MZ_ES, DI, AX);
+        else write8(cpu, V30MZ_ES, DI, AX);
+        DI += delta;
+        CLK(3);
+        break;
+    case 0xAC: // LODS
+        if (word) AX = read16(cpu, src_seg, SI);
+        else set8(cpu, 0, read8(cpu, src_seg, SI));
+        SI += delta;
+        CLK(3);
+        break;
+    case 0xAE: // SCAS
+        if (word) alu(cpu, 7, true, AX, read16(cpu, V30MZ_ES, DI));
+        else alu(cpu, 7, false, AX & 0xFF, read8(cpu, V30MZ_ES, DI));
+        DI += delta;
+        CLK(4);
+        break;
+    }
+}
+
+static void string_op(v30mz_t *cpu, uint8_t op) {
+    if (!rep_prefix) {
+        string_step(cpu, op);
+        return;
+    }
+
+    bool compares = (op & ~1) == 0xA6 || (op & ~1) == 0xAE;
+    CLK(2);
+    while (CX != 0) {
+        string_step(cpu, op);
+        CX--;
+        if (compares && !(cpu->flags & ZF) == (rep_prefix == 0xF3)) break;
+    }
+}
+
+/* Execution */
+
+static void far_jump(v30mz_t *cpu, uint16_t segment, uint16_t offset) {
+    cpu->sreg[V30MZ_CS] = segment;
+    cpu->ip = offset;
+}
+
+static bool group_ff(v30mz_t *cpu, bool word) {
+    modrm_t m;
+    decode_modrm(cpu, &m);
+    bool mem = m.mod != 3;
+
+    if (!word || m.reg < 2) {
+        if (m.reg >= 2) return false;
+        set_rm(cpu, &m, word, inc_dec(cpu, word, get_rm(cpu, &m, word), m.reg == 1));
+        CLK(mem ? 3 : 1);
+        return true;
+    }
+
+    uint16_t value = m.reg == 3 || m.reg == 5 ? 0 : get_rm(cpu, &m, true);
+    switch (m.reg) {
+    case 2: // CALL r/m16
+        v30mz_push(cpu, cpu->ip);
+        cpu->ip = value;
+        CLK(mem ? 6 : 5);
+        return true;
+    case 3: // CALL m16:16
+        if (!mem) return false;
+        v30mz_push(cpu, cpu->sreg[V30MZ_CS]);
+        v30mz_push(cpu, cpu->ip);
+        far_jump(cpu, read16(cpu, m.seg, m.offset + 2), read16(cpu, m.seg, m.offset));
+        CLK(12);
+        return true;
+    case 4: // JMP r/m16
+        cpu->ip = value;
+        CLK(mem ? 5 : 4);
+        return true;
+    case 5: // JMP m16:16
+        if (!mem) return false;
+        far_jump(cpu, read16(cpu, m.seg, m.offset + 2), read16(cpu, m.seg, m.offset));
+        CLK(9);
+        return true;
+    case 6: // PUSH r/m16
+        v30mz_push(cpu, value);
+        CLK(mem ? 3 : 1);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// returns false for an unsupported opcode or a divide error
+static bool step(v30mz_t *cpu) {
+    modrm_t m;
+    uint8_t op;
+
+    seg_override = -1;
+    rep_prefix = 0;
+    cpu->op_cs = cpu->sreg[V30MZ_CS];
+    cpu->op_ip = cpu->ip;
+
+    while (true) {
+        op = fetch8(cpu);
+        if (op == 0x26 || op == 0x2E || op == 0x36 || op == 0x3E) {
+            seg_override = (op >> 3) & 3;
+            CLK(1);
+        } else if (op == 0xF2 || op == 0xF3) {
+            rep_prefix = op;
+        } else if (op == 0xF0) {
+            CLK(1);
+        } else {
+            break;
+        }
+    }
+    cpu->op = op;
+    cpu->instructions++;
+
+    bool word = op & 1;
+
+    // ALU r/m, reg / reg, r/m / acc, imm
+    if (op < 0x40 && (op & 7) < 6) {
+        uint8_t alu_op = op >> 3;
+        switch (op & 7) {
+        case 0: case 1:
+            decode_modrm(cpu, &m);
+            if (alu_op == 7) {
+                alu(cpu, 7, word, get_rm(cpu, &m, word), get_reg(cpu, word, m.reg));
+                CLK(m.mod == 3 ? 1 : 2);
+            } else {
+                set_rm(cpu, &m, word, alu(cpu, alu_op, word, get_rm(cpu, &m, word), get_reg(cpu, word, m.reg)));
+                CLK(m.mod == 3 ? 1 : 3);
+            }
+            return true;
+        case 2: case 3: {
+            decode_modrm(cpu, &m);
+            uint16_t result = alu(cpu, alu_op, word, get_reg(cpu, word, m.reg), get_rm(cpu, &m, word));
+            if (alu_op != 7) set_reg(cpu, word, m.reg, result);
+            CLK(m.mod == 3 ? 1 : 2);
+            return true;
+        }
+        default: {
+            uint16_t imm = word ? fetch16(cpu) : fetch8(cpu);
+            uint16_t result = alu(cpu, alu_op, word, get_reg(cpu, word, 0), imm);
+            if (alu_op != 7) set_reg(cpu, word, 0, result);
+            CLK(1);
+            return true;
+        }
+        }
+    }
+
+    switch (op) {
+    case 0x06: case 0x0E: case 0x16: case 0x1E:
+        v30mz_push(cpu, cpu->sreg[op >> 3]);
+        CLK(2);
+        return true;
+    case 0x07: case 0x17: case 0x1F:
+        cpu->sreg[op >> 3] = pop(cpu);
+        CLK(3);
+        return true;
+
+    case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: case 0x46: case 0x47:
+    case 0x48: case 0x49: case 0x4A: case 0x4B: case 0x4C: case 0x4D: case 0x4E: case 0x4F:
+        cpu->r[op & 7] = inc_dec(cpu, true, cpu->r[op & 7], op & 8);
+        CLK(1);
+        return true;
+    case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57:
+        v30mz_push(cpu, cpu->r[op & 7]);
+        CLK(1);
+        return true;
+    case 0x58: case 0x59: case 0x5A: case 0x5B: case 0x5C: case 0x5D: case 0x5E: case 0x5F:
+        cpu->r[op & 7] = pop(cpu);
+        CLK(1);
+        return true;
+
+    case 0x60: { // PUSHA
+        uint16_t sp = SP;
+        for (uint8_t i = 0; i < 8; i++) v30mz_push(cpu, i == V30MZ_SP ? sp : cpu->r[i]);
+        CLK(9);
+        return true;
+    }
+    case 0x61: // POPA
+        for (int8_t i = 7; i >= 0; i--) {
+            uint16_t value = pop(cpu);
+            if (i != V30MZ_SP) cpu->r[i] = value;
+        }
+        CLK(8);
+        return true;
+    case 0x68:
+        v30mz_push(cpu, fetch16(cpu));
+        CLK(1);
+        return true;
+    case 0x6A:
+        v30mz_push(cpu, (int8_t) fetch8(cpu));
+        CLK(1);
+        return true;
+    case 0x69: case 0x6B: { // IMUL reg, r/m, imm
+        decode_modrm(cpu, &m);
+        int16_t a = get_rm(cpu, &m, true);
+        int16_t b = op == 0x69 ? (int16_t) fetch16(cpu) : (int8_t) fetch8(cpu);
+        int32_t result = (int32_t) a * b;
+        cpu->r[m.reg] = result;
+        set_flag(cpu, CF | OF, result != (int16_t) result);
+        CLK(4);
+        return true;
+    }
+
+    case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: case 0x77:
+    case 0x78: case 0x79: case 0x7A: case 0x7B: case 0x7C: case 0x7D: case 0x7E: case 0x7F:
+        jump_short(cpu, condition(cpu, op & 0xF), 4, 1);
+        return true;
+
+    case 0x80: case 0x81: case 0x82: case 0x83: {
+        decode_modrm(cpu, &m);
+        uint16_t a = get_rm(cpu, &m, word);
+        uint16_t imm = op == 0x81 ? fetch16(cpu) : op == 0x83 ? (uint16_t) (int8_t) fetch8(cpu) : fetch8(cpu);
+        uint16_t result = alu(cpu, m.reg, word, a, imm);
+        if (m.reg != 7) set_rm(cpu, &m, word, result);
+        CLK(m.mod == 3 ? 1 : m.reg == 7 ? 2 : 3);
+        return true;
+    }
+    case 0x84: case 0x85:
+        decode_modrm(cpu, &m);
+        alu(cpu, 4, word, get_rm(cpu, &m, word), get_reg(cpu, word, m.reg));
+        CLK(m.mod == 3 ? 1 : 2);
+        return true;
+    case 0x86: case 0x87: {
+        decode_modrm(cpu, &m);
+        uint16_t value = get_rm(cpu, &m, word);
+        set_rm(cpu, &m, word, get_reg(cpu, word, m.reg));
+        set_reg(cpu, word, m.reg, value);
+        CLK(m.mod == 3 ? 3 : 5);
+        return true;
+    }
+    case 0x88: case 0x89:
+        decode_modrm(cpu, &m);
+        set_rm(cpu, &m, word, get_reg(cpu, word, m.reg));
+        CLK(1);
+        return true;
+    case 0x8A: case 0x8B:
+        decode_modrm(cpu, &m);
+        set_reg(cpu, word, m.reg, get_rm(cpu, &m, word));
+        CLK(1);
+        return true;
+    case 0x8C:
+        decode_modrm(cpu, &m);
+        set_rm(cpu, &m, true, cpu->sreg[m.reg & 3]);
+        CLK(m.mod == 3 ? 1 : 3);
+        return true;
+    case 0x8D:
+        decode_modrm(cpu, &m);
+        if (m.mod == 3) return false;
+        cpu->r[m.reg] = m.offset;
+        CLK(1);
+        return true;
+    case 0x8E:
+        decode_modrm(cpu, &m);
+        cpu->sreg[m.reg & 3] = get_rm(cpu, &m, true);
+        CLK(m.mod == 3 ? 2 : 3);
+        return true;
+    case 0x8F: {
+        uint16_t value = pop(cpu);
+        decode_modrm(cpu, &m);
+        set_rm(cpu, &m, true, value);
+        CLK(m.mod == 3 ? 1 : 3);
+        return true;
+    }
+
+    case 0x90:
+        CLK(1);
+        return true;
+    case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97: {
+        uint16_t value = cpu->r[op & 7];
+        cpu->r[op & 7] = AX;
+        AX = value;
+        CLK(3);
+        return true;
+    }
+    case 0x98:
+        AX = (int8_t) AX;
+        CLK(1);
+        return true;
+    case 0x99:
+        DX = (AX & 0x8000) ? 0xFFFF : 0;
+        CLK(1);
+        return true;
+    case 0x9A: {
+        uint16_t offset = fetch16(cpu);
+        uint16_t segment = fetch16(cpu);
+        v30mz_push(cpu, cpu->sreg[V30MZ_CS]);
+        v30mz_push(cpu, cpu->ip);
+        far_jump(cpu, segment, offset);
+        CLK(10);
+        return true;
+    }
+    case 0x9B:
+        CLK(1);
+        return true;
+    case 0x9C:
+        v30mz_push(cpu, cpu->flags | 0xF002);
+        CLK(2);
+        return true;
+    case 0x9D:
+        cpu->flags = pop(cpu) & 0x0FD5;
+        CLK(3);
+        return true;
+    case 0x9E:
+        cpu->flags = (cpu->flags & 0xFF00) | ((AX >> 8) & 0xD5);
+        CLK(4);
+        return true;
+    case 0x9F:
+        set8(cpu, 4, (cpu->flags & 0xD5) | 0x02);
+        CLK(2);
+        return true;
+
+    case 0xA0: case 0xA1: {
+        uint16_t offset = fetch16(cpu);
+        uint8_t seg = default_seg(V30MZ_DS);
+        set_reg(cpu, word, 0, word ? read16(cpu, seg, offset) : read8(cpu, seg, offset));
+        CLK(1);
+        return true;
+    }
+    case 0xA2: case 0xA3: {
+        uint16_t offset = fetch16(cpu);
+        uint8_t seg = default_seg(V30MZ_DS);
+        if (word) write16(cpu, seg, offset, AX);
+        else write8(cpu, seg, offset, AX);
+        CLK(1);
+        return true;
+    }
+    case 0xA4: case 0xA5: case 0xA6: case 0xA7:
+    case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+        string_op(cpu, op);
+        return true;
+    case 0xA8: case 0xA9:
+        alu(cpu, 4, word, get_reg(cpu, word, 0), word ? fetch16(cpu) : fetch8(cpu));
+        CLK(1);
+        return true;
+
+    case 0xB0: case 0xB1: case 0xB2: case 0xB3: case 0xB4: case 0xB5: case 0xB6: case 0xB7:
+        set8(cpu, op & 7, fetch8(cpu));
+        CLK(1);
+        return true;
+    case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBE: case 0xBF:
+        cpu->r[op & 7] = fetch16(cpu);
+        CLK(1);
+        return true;
+
+    case 0xC0: case 0xC1: case 0xD0: case 0xD1: case 0xD2: case 0xD3: {
+        decode_modrm(cpu, &m);
+        uint8_t count = op >= 0xD2 ? CX : op >= 0xD0 ? 1 : fetch8(cpu);
+        set_rm(cpu, &m, word, shift(cpu, m.reg, word, get_rm(cpu, &m, word), count));
+        if (op >= 0xD0 && op < 0xD2) CLK(m.mod == 3 ? 1 : 3);
+        else CLK(m.mod == 3 ? 3 : 5);
+        return true;
+    }
+    case 0xC2: {
+        uint16_t bytes = fetch16(cpu);
+        cpu->ip = pop(cpu);
+        SP += bytes;
+        CLK(6);
+        return true;
+    }
+    case 0xC3:
+        cpu->ip = pop(cpu);
+        CLK(6);
+        return true;
+    case 0xC4: case 0xC5:
+        decode_modrm(cpu, &m);
+        if (m.mod == 3) return false;
+        cpu->r[m.reg] = read16(cpu, m.seg, m.offset);
+        cpu->sreg[op == 0xC4 ? V30MZ_ES : V30MZ_DS] = read16(cpu, m.seg, m.offset + 2);
+        CLK(6);
+        return true;
+    case 0xC6: case 0xC7:
+        decode_modrm(cpu, &m);
+        set_rm(cpu, &m, word, word ? fetch16(cpu) : fetch8(cpu));
+        CLK(1);
+        return true;
+    case 0xC9: // LEAVE
+        SP = cpu->r[V30MZ_BP];
+        cpu->r[V30MZ_BP] = pop(cpu);
+        CLK(2);
+        return true;
+    case 0xCA: case 0xCB: {
+        uint16_t bytes = op == 0xCA ? fetch16(cpu) : 0;
+        uint16_t offset = pop(cpu);
+        far_jump(cpu, pop(cpu), offset);
+        SP += bytes;
+        CLK(op == 0xCA ? 9 : 8);
+        return true;
+    }
+
+    case 0xD7:
+        set8(cpu, 0, read8(cpu, default_seg(V30MZ_DS), cpu->r[V30MZ_BX] + (AX & 0xFF)));
+        CLK(5);
+        return true;
+
+    case 0xE0: case 0xE1: case 0xE2: {
+        CX--;
+        bool taken = CX != 0;
+        if (op == 0xE0) taken = taken && !(cpu->flags & ZF);
+        else if (op == 0xE1) taken = taken && (cpu->flags & ZF);
+        jump_short(cpu, taken, op == 0xE2 ? 5 : 6, op == 0xE2 ? 2 : 3);
+        return true;
+    }
+    case 0xE3:
+        jump_short(cpu, CX == 0, 4, 1);
+        return true;
+    case 0xE4: case 0xE5:
+        set_reg(cpu, word, 0, port_in(cpu, fetch8(cpu), word));
+        CLK(6);
+        return true;
+    case 0xE6: case 0xE7:
+        port_out(cpu, fetch8(cpu), word, AX);
+        CLK(6);
+        return true;
+    case 0xEC: case 0xED:
+        set_reg(cpu, word, 0, port_in(cpu, DX, word));
+        CLK(6);
+        return true;
+    case 0xEE: case 0xEF:
+        port_out(cpu, DX, word, AX);
+        CLK(6);
+        return true;
+    case 0xE8: {
+        uint16_t disp = fetch16(cpu);
+        v30mz_push(cpu, cpu->ip);
+        cpu->ip += disp;
+        CLK(5);
+        return true;
+    }
+    case 0xE9: {
+        uint16_t disp = fetch16(cpu);
+        cpu->ip += disp;
+        CLK(4);
+        return true;
+    }
+    case 0xEA: {
+        uint16_t offset = fetch16(cpu);
+        far_jump(cpu, fetch16(cpu), offset);
+        CLK(7);
+        return true;
+    }
+    case 0xEB:
+        jump_short(cpu, true, 4, 4);
+        return true;
+
+    case 0xF4:
+        stop_reason = V30MZ_STOP_HALTED;
+        CLK(9);
+        return true;
+    case 0xF5:
+        cpu->flags ^= CF;
+        CLK(4);
+        return true;
+    case 0xF6: case 0xF7: {
+        decode_modrm(cpu, &m);
+        uint16_t value = get_rm(cpu, &m, word);
+        switch (m.reg) {
+        case 0: case 1:
+            alu(cpu, 4, word, value, word ? fetch16(cpu) : fetch8(cpu));
+            CLK(m.mod == 3 ? 1 : 2);
+            return true;
+        case 2:
+            set_rm(cpu, &m, word, ~value);
+            CLK(m.mod == 3 ? 1 : 3);
+            return true;
+        case 3:
+            set_rm(cpu, &m, word, alu(cpu, 5, word, 0, value));
+            CLK(m.mod == 3 ? 1 : 3);
+            return true;
+        default:
+            if (m.mod != 3) CLK(1);
+            return mul_div(cpu, m.reg, word, value);
+        }
+    }
+    case 0xF8: case 0xF9:
+        set_flag(cpu, CF, op & 1);
+        CLK(4);
+        return true;
+    case 0xFA: case 0xFB:
+        set_flag(cpu, IF, op & 1);
+        CLK(4);
+        return true;
+    case 0xFC: case 0xFD:
+        set_flag(cpu, DF, op & 1);
+        CLK(4);
+        return true;
+    case 0xFE: case 0xFF:
+        return group_ff(cpu, word);
+    }
+
+    return false;
+}
+
+void v30mz_init(v30mz_t *cpu, const v30mz_bus_t *bus) {
+    for (uint8_t i = 0; i < 8; i++) cpu->r[i] = 0;
+    for (uint8_t i = 0; i < 4; i++) cpu->sreg[i] = 0;
+    cpu->sreg[V30MZ_CS] = 0xFFFF;
+    cpu->ip = 0;
+    cpu->flags = 0;
+    cpu->cycles = 0;
+    cpu->instructions = 0;
+    cpu->bus = *bus;
+}
+
+uint8_t v30mz_run(v30mz_t *cpu, uint16_t stop_cs, uint16_t stop_ip, uint64_t max_cycles) {
+    uint64_t end = cpu->cycles + max_cycles;
+
+    stop_reason = V30MZ_STOP_RETURNED;
+    while (cpu->sreg[V30MZ_CS] != stop_cs || cpu->ip != stop_ip) {
+        if (cpu->cycles >= end) return V30MZ_STOP_CYCLE_LIMIT;
+        if (!step(cpu)) return V30MZ_STOP_BAD_OPCODE;
+        if (stop_reason != V30MZ_STOP_RETURNED) return stop_reason;
+    }
+    return V30MZ_STOP_RETURNED;
+}
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// A cycle-approximate interpreter for the WonderSwan's V30MZ, covering the
+// 80186 instructions the hand-written kernels use. There is no prefetch
+// queue and there are no interrupts; see v30mz.c for the cycle counts.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define V30MZ_AX 0
+#define V30MZ_CX 1
+#define V30MZ_DX 2
+#define V30MZ_BX 3
+#define V30MZ_SP 4
+#define V30MZ_BP 5
+#define V30MZ_SI 6
+#define V30MZ_DI 7
+
+#define V30MZ_ES 0
+#define V30MZ_CS 1
+#define V30MZ_SS 2
+#define V30MZ_DS 3
+
+#define V30MZ_FLAG_CF 0x0001
+#define V30MZ_FLAG_PF 0x0004
+#define V30MZ_FLAG_AF 0x0010
+#define V30MZ_FLAG_ZF 0x0040
+#define V30MZ_FLAG_SF 0x0080
+#define V30MZ_FLAG_TF 0x0100
+#define V30MZ_FLAG_IF 0x0200
+#define V30MZ_FLAG_DF 0x0400
+#define V30MZ_FLAG_OF 0x0800
+
+// Why v30mz_run() stopped.
+#define V30MZ_STOP_RETURNED 0
+#define V30MZ_STOP_CYCLE_LIMIT 1
+#define V30MZ_STOP_HALTED 2
+#define V30MZ_STOP_BAD_OPCODE 3
+
+typedef struct {
+    uint8_t (*read)(void *userdata, uint32_t addr);
+    void (*write)(void *userdata, uint32_t addr, uint8_t value);
+    uint8_t (*in)(void *userdata, uint8_t port);
+    void (*out)(void *userdata, uint8_t port, uint8_t value);
+    // extra cycles for a word access, e.g. on an 8-bit bus (may be NULL)
+    uint8_t (*word_wait)(void *userdata, uint32_t addr);
+    void *userdata;
+} v30mz_bus_t;
+
+typedef struct {
+    uint16_t r[8];
+    uint16_t sreg[4];
+    uint16_t ip;
+    uint16_t flags;
+    uint64_t cycles;
+    uint64_t instructions;
+    v30mz_bus_t bus;
+
+    // the instruction being executed, for error reports
+    uint16_t op_cs, op_ip;
+    uint8_t op;
+} v30mz_t;
+
+void v30mz_init(v30mz_t *cpu, const v30mz_bus_t *bus);
+uint8_t v30mz_get8(v30mz_t *cpu, uint8_t reg);
+void v30mz_push(v30mz_t *cpu, uint16_t value);
+// Runs until CS:IP is stop_cs:stop_ip, or for at most max_cycles.
+uint8_t v30mz_run(v30mz_t *cpu, uint16_t stop_cs, uint16_t stop_ip, uint64_t max_cycles);
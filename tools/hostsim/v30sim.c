@@ -0,0 +1,699 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Runs the hand-written assembly kernels (sram_asm.s, fm_driver_io_ram.s)
+// on the V30MZ interpreter, checks their results and reports their cost.
+//
+// Usage: v30sim [options] [benchmark...]
+//
+//   --kernels <path>     kernel image, without the .bin/.sym extension
+//                        (build/kernels by default; see the Makefile)
+//   --switch             make the driver switch slots, as for a slot other
+//                        than the launch slot (adds ~24 ms per call)
+//   --byte-program <us>  modelled flash timings, as in hostsim.h
+//   --buffer-program <us>
+//   --sector-erase <us>
+//
+// Benchmarks are selected by name prefix; all are run by default. The exit
+// status is 1 if any kernel returns a wrong result.
+//
+// The kernels are linked to run from IRAM, at 0000:8000, with DS = SS = ES
+// = 0 as on entry from C. The cartridge is a Flash Masta with one slot: the
+// ROM windows and, with IO_CART_FLASH set, the SRAM window map its flash,
+// which follows the command sequences the driver uses, with program and
+// erase times counted in CPU cycles. The driver's own counters
+// (driver_stats) are checked against what each call did.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ws.h>
+#include "driver.h"
+#include "settings.h"
+#include "v30mz.h"
+
+#define CPU_HZ 3072000
+
+#define FLASH_SIZE (256UL << 16)
+#define SRAM_SIZE 0x80000
+
+#define KERNEL_BASE 0x8000
+// a far return here ends the call
+#define RETURN_CS 0x0000
+#define RETURN_IP 0xFFF0
+#define STACK_TOP 0xE000
+#define MAX_CYCLES (CPU_HZ * 60ULL)
+
+// IRAM layout for the benchmarks
+#define IRAM_BUFFER 0x1000 // up to 16 KB
+#define IRAM_CRC_TABLE 0x5000
+#define IRAM_CRC 0x5400
+#define IRAM_SETTINGS 0x6000
+
+#define BENCH_SLOT 3
+#define BENCH_BANK 0x20
+
+typedef enum {
+    FLASH_READ,
+    FLASH_UNLOCK1,
+    FLASH_UNLOCK2,
+    FLASH_BYPASS,
+    FLASH_BYPASS_EXIT,
+    FLASH_PROGRAM,
+    FLASH_ERASE_UNLOCK0,
+    FLASH_ERASE_UNLOCK1,
+    FLASH_ERASE_UNLOCK2,
+    FLASH_BUFFER_COUNT,
+    FLASH_BUFFER_DATA
+} flash_state_t;
+
+typedef struct {
+    flash_state_t state;
+    bool bypass;
+    uint64_t busy_until;
+    bool toggle;
+    uint16_t buffer_left;
+    uint16_t buffer_len;
+    uint32_t buffer_addr[256];
+    uint8_t buffer_data[256];
+} flash_t;
+
+typedef struct {
+    uint64_t polls; // status reads while busy
+    uint32_t programs;
+    uint32_t erases;
+    uint32_t faults; // bad command sequences, or programming 0 bits to 1
+} flash_stats_t;
+
+typedef struct {
+    const char *name;
+    uint32_t bytes;
+    // returns NULL on success, or what went wrong
+    const char *(*run)(uint32_t bytes);
+} benchmark_t;
+
+typedef struct {
+    char name[64];
+    uint16_t addr;
+} symbol_t;
+
+static v30mz_t cpu;
+static uint8_t iram[0x10000];
+static uint8_t sram[SRAM_SIZE];
+static uint8_t *flash;
+static uint8_t ports[0x100];
+static flash_t flash_chip;
+static flash_stats_t flash_stats;
+
+static uint32_t byte_program_us = 60;
+static uint32_t buffer_program_us = 340;
+static uint32_t sector_erase_us = 500000;
+static bool switch_slots;
+
+static symbol_t *symbols;
+static int symbol_count;
+
+static uint32_t random_state = 1;
+
+static uint8_t random_byte(void) {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 16;
+}
+
+/* Flash */
+
+static uint64_t us_to_cycles(uint32_t us) {
+    return (uint64_t) us * (CPU_HZ / 1000) / 1000;
+}
+
+static bool flash_busy(void) {
+    return cpu.cycles < flash_chip.busy_until;
+}
+
+static uint8_t flash_read(uint32_t addr) {
+    if (flash_busy()) {
+        // DQ7 = inverted data, DQ6 toggles
+        flash_stats.polls++;
+        flash_chip.toggle = !flash_chip.toggle;
+        return (flash_chip.toggle ? 0x40 : 0x00) | (~flash[addr] & 0x80);
+    }
+    return flash[addr];
+}
+
+static void flash_program(uint32_t addr, uint8_t value) {
+    if ((flash[addr] & value) != value) flash_stats.faults++;
+    flash[addr] &= value;
+}
+
+static void flash_write(uint32_t addr, uint8_t value) {
+    uint16_t cmd_addr = addr & 0xFFF;
+    flash_t *f = &flash_chip;
+
+    if (flash_busy()) {
+        flash_stats.faults++;
+        return;
+    }
+
+    flash_state_t idle = f->bypass ? FLASH_BYPASS : FLASH_READ;
+    switch (f->state) {
+    case FLASH_READ:
+        if (value == 0xAA && cmd_addr == 0xAAA) f->state = FLASH_UNLOCK1;
+        else if (value != 0xF0) flash_stats.faults++;
+        return;
+    case FLASH_UNLOCK1:
+        f->state = FLASH_READ;
+        if (value == 0x55 && cmd_addr == 0x555) f->state = FLASH_UNLOCK2;
+        else flash_stats.faults++;
+        return;
+    case FLASH_UNLOCK2:
+        f->state = FLASH_READ;
+        if (value == 0xF0) {
+            return;
+        } else if (value == 0x25) {
+            f->state = FLASH_BUFFER_COUNT;
+            return;
+        } else if (cmd_addr != 0xAAA) {
+            break;
+        } else if (value == 0x20) {
+            f->bypass = true;
+            f->state = FLASH_BYPASS;
+            return;
+        } else if (value == 0xA0) {
+            f->state = FLASH_PROGRAM;
+            return;
+        } else if (value == 0x80) {
+            f->state = FLASH_ERASE_UNLOCK0;
+            return;
+        }
+        break;
+    case FLASH_BYPASS:
+        if (value == 0xA0) f->state = FLASH_PROGRAM;
+        else if (value == 0x25) f->state = FLASH_BUFFER_COUNT;
+        else if (value == 0x90) f->state = FLASH_BYPASS_EXIT;
+        else break;
+        return;
+    case FLASH_BYPASS_EXIT:
+        if (value != 0x00) break;
+        f->bypass = false;
+        f->state = FLASH_READ;
+        return;
+    case FLASH_PROGRAM:
+        flash_program(addr, value);
+        flash_stats.programs++;
+        f->busy_until = cpu.cycles + us_to_cycles(byte_program_us);
+        f->state = idle;
+        return;
+    case FLASH_ERASE_UNLOCK0:
+    case FLASH_ERASE_UNLOCK1:
+        if (value != (f->state == FLASH_ERASE_UNLOCK0 ? 0xAA : 0x55)
+            || cmd_addr != (f->state == FLASH_ERASE_UNLOCK0 ? 0xAAA : 0x555)) break;
+        f->state++;
+        return;
+    case FLASH_ERASE_UNLOCK2:
+        if (value != 0x30) break;
+        // 128 KB sectors
+        memset(flash + (addr & ~0x1FFFFUL), 0xFF, 0x20000);
+        flash_stats.erases++;
+        f->busy_until = cpu.cycles + us_to_cycles(sector_erase_us);
+        f->state = FLASH_READ;
+        return;
+    case FLASH_BUFFER_COUNT:
+        f->buffer_left = value + 1;
+        f->buffer_len = 0;
+        f->state = FLASH_BUFFER_DATA;
+        return;
+    case FLASH_BUFFER_DATA:
+        if (f->buffer_left > 0) {
+            f->buffer_addr[f->buffer_len] = addr;
+            f->buffer_data[f->buffer_len++] = value;
+            f->buffer_left--;
+            return;
+        }
+        if (value != 0x29) break;
+        for (uint16_t i = 0; i < f->buffer_len; i++) {
+            // the write buffer covers one 512-byte block
+            if ((f->buffer_addr[i] ^ f->buffer_addr[0]) & ~0x1FFUL) flash_stats.faults++;
+            flash_program(f->buffer_addr[i], f->buffer_data[i]);
+        }
+        flash_stats.programs++;
+        f->busy_until = cpu.cycles + us_to_cycles(buffer_program_us);
+        f->state = idle;
+        return;
+    }
+
+    // unexpected write: the chip goes back to reading
+    flash_stats.faults++;
+    f->state = idle;
+}
+
+/* Console */
+
+static uint32_t rom_addr(uint32_t addr) {
+    uint8_t window = addr >> 16;
+    uint8_t bank;
+    if (window == 2) bank = ports[IO_BANK_ROM0];
+    else if (window == 3) bank = ports[IO_BANK_ROM1];
+    else bank = (ports[IO_BANK_ROM_LINEAR] << 4) | window;
+    return ((uint32_t) bank << 16) | (addr & 0xFFFF);
+}
+
+static uint32_t sram_window_addr(uint32_t addr) {
+    return ((uint32_t) ports[IO_BANK_RAM] << 16) | (addr & 0xFFFF);
+}
+
+static uint8_t bus_read(void *userdata, uint32_t addr) {
+    switch (addr >> 16) {
+    case 0:
+        return iram[addr];
+    case 1:
+        if (ports[IO_CART_FLASH] & 1) return flash_read(sram_window_addr(addr));
+        return sram[sram_window_addr(addr) & (SRAM_SIZE - 1)];
+    default:
+        return flash_read(rom_addr(addr));
+    }
+}
+
+static void bus_write(void *userdata, uint32_t addr, uint8_t value) {
+    switch (addr >> 16) {
+    case 0:
+        iram[addr] = value;
+        break;
+    case 1:
+        if (ports[IO_CART_FLASH] & 1) flash_write(sram_window_addr(addr), value);
+        else sram[sram_window_addr(addr) & (SRAM_SIZE - 1)] = value;
+        break;
+    default:
+        // the ROM is read-only
+        flash_stats.faults++;
+        break;
+    }
+}
+
+// cartridge SRAM is on an 8-bit bus
+static uint8_t bus_word_wait(void *userdata, uint32_t addr) {
+    return (addr >> 16) == 1 ? 1 : (addr & 1);
+}
+
+static uint8_t bus_in(void *userdata, uint8_t port) {
+    // the slot switch always completes
+    if (port == IO_CART_RTC_CTRL) return CART_RTC_READY;
+    return ports[port];
+}
+
+static void bus_out(void *userdata, uint8_t port, uint8_t value) {
+    if (port != IO_CART_RTC_CTRL) ports[port] = value;
+}
+
+static const v30mz_bus_t bus = {
+    .read = bus_read,
+    .write = bus_write,
+    .in = bus_in,
+    .out = bus_out,
+    .word_wait = bus_word_wait
+};
+
+/* Kernels */
+
+static bool load_kernels(const char *path) {
+    char filename[1024];
+    char line[256];
+
+    snprintf(filename, sizeof(filename), "%s.bin", path);
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        perror(filename);
+        return false;
+    }
+    size_t len = fread(iram + KERNEL_BASE, 1, sizeof(iram) - KERNEL_BASE, file);
+    fclose(file);
+    if (len == 0) {
+        fprintf(stderr, "%s: empty\n", filename);
+        return false;
+    }
+
+    // nm output: "address type name"
+    snprintf(filename, sizeof(filename), "%s.sym", path);
+    file = fopen(filename, "r");
+    if (!file) {
+        perror(filename);
+        return false;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long addr;
+        char type;
+        char name[64];
+        if (sscanf(line, "%lx %c %63s", &addr, &type, name) != 3) continue;
+        symbols = realloc(symbols, (symbol_count + 1) * sizeof(symbol_t));
+        strcpy(symbols[symbol_count].name, name);
+        symbols[symbol_count++].addr = addr;
+    }
+    fclose(file);
+    return true;
+}
+
+static uint16_t symbol(const char *name) {
+    for (int i = 0; i < symbol_count; i++) {
+        if (!strcmp(symbols[i].name, name)) return symbols[i].addr;
+    }
+    fprintf(stderr, "v30sim: symbol %s not found\n", name);
+    exit(1);
+}
+
+// Far-calls a kernel with the given register and stack arguments, as the
+// C code does; returns AL, or -1 (with *error set) if it did not return.
+static int call_kernel(const char *name, uint16_t ax, uint16_t dx, uint16_t cx,
+    int stack_args, uint16_t arg0, uint16_t arg1, const char **error) {
+
+    cpu.r[V30MZ_AX] = ax;
+    cpu.r[V30MZ_DX] = dx;
+    cpu.r[V30MZ_CX] = cx;
+    cpu.r[V30MZ_SP] = STACK_TOP;
+    cpu.sreg[V30MZ_DS] = cpu.sreg[V30MZ_ES] = cpu.sreg[V30MZ_SS] = 0;
+    cpu.flags = V30MZ_FLAG_IF;
+    if (stack_args >= 2) v30mz_push(&cpu, arg1);
+    if (stack_args >= 1) v30mz_push(&cpu, arg0);
+    v30mz_push(&cpu, RETURN_CS);
+    v30mz_push(&cpu, RETURN_IP);
+    cpu.sreg[V30MZ_CS] = 0;
+    cpu.ip = symbol(name);
+
+    uint16_t sp = cpu.r[V30MZ_SP];
+    switch (v30mz_run(&cpu, RETURN_CS, RETURN_IP, MAX_CYCLES)) {
+    case V30MZ_STOP_RETURNED:
+        if (cpu.r[V30MZ_SP] != sp + 4 + stack_args * 2) {
+            *error = "stack not balanced";
+            return -1;
+        }
+        return cpu.r[V30MZ_AX] & 0xFF;
+    case V30MZ_STOP_CYCLE_LIMIT:
+        *error = "did not return";
+        return -1;
+    case V30MZ_STOP_HALTED:
+        *error = "halted (driver_write_error?)";
+        return -1;
+    default:
+        fprintf(stderr, "v30sim: unsupported opcode %02X at %04X:%04X\n",
+            cpu.op, cpu.op_cs, cpu.op_ip);
+        *error = "unsupported opcode";
+        return -1;
+    }
+}
+
+static void setup(void) {
+    memset(ports, 0, sizeof(ports));
+    ports[IO_SYSTEM_CTRL1] = SYSTEM_CTRL1_IPL_LOCKED;
+    ports[IO_BANK_ROM_LINEAR] = 0xF;
+    memset(&flash_chip, 0, sizeof(flash_chip));
+    memset(&flash_stats, 0, sizeof(flash_stats));
+
+    // the driver's remount check reads the ROM footer at FFFF:0005
+    uint8_t *footer = flash + 0xFFFFF5;
+    footer[0] = 0x00; footer[1] = 0xAA; footer[2] = 0x01; footer[3] = 0x55;
+
+    iram[symbol("fm_initial_slot")] = BENCH_SLOT;
+    iram[symbol("_driver_current_slot")] = BENCH_SLOT;
+    iram[symbol("driver_irq_passthrough")] = 0;
+    iram[IRAM_SETTINGS + offsetof(settings_t, flags1)] = 0;
+    memset(iram + symbol("driver_stats"), 0, sizeof(driver_stats_t));
+    cpu.cycles = 0;
+    cpu.instructions = 0;
+}
+
+static uint8_t bench_slot(void) {
+    return switch_slots ? BENCH_SLOT + 1 : BENCH_SLOT;
+}
+
+static void fill_random(uint8_t *dest, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) dest[i] = random_byte();
+}
+
+static uint8_t *flash_bank(uint8_t bank) {
+    return flash + ((uint32_t) bank << 16);
+}
+
+#define DRIVER_STAT16(field) get16(iram + symbol("driver_stats") + offsetof(driver_stats_t, field))
+#define DRIVER_STAT32(field) get32(iram + symbol("driver_stats") + offsetof(driver_stats_t, field))
+
+static uint16_t get16(const uint8_t *src) {
+    return src[0] | (src[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *src) {
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+// checks driver_stats after one driver call
+static const char *check_stats(uint32_t read, uint32_t programmed, uint16_t erases) {
+    if (DRIVER_STAT16(slot_switches) != (switch_slots ? 2 : 0)) return "wrong slot_switches count";
+    if (DRIVER_STAT32(bytes_read) != read) return "wrong bytes_read count";
+    if (DRIVER_STAT32(bytes_programmed) != programmed) return "wrong bytes_programmed count";
+    if (DRIVER_STAT16(erases) != erases) return "wrong erases count";
+    // each busy loop iteration reads the status twice
+    if (DRIVER_STAT32(busy_polls) * 2 < flash_stats.polls) return "busy polls not counted";
+    return NULL;
+}
+
+/* Benchmarks */
+
+// the kernels return bool: only AL == 0 is false
+static const char *check_ret(int ret, bool expected, const char *error) {
+    if (ret < 0) return error;
+    if ((ret != 0) != expected) return "wrong return value";
+    return NULL;
+}
+
+static const char *bench_copy_check_erased(uint32_t bytes) {
+    const char *error;
+    memset(sram, 0xFF, 0x10000);
+    memset(iram + IRAM_BUFFER, 0, bytes);
+    int ret = call_kernel("sram_copy_to_buffer_check_flash", IRAM_BUFFER, 0x4000, 0, 0, 0, 0, &error);
+    if ((error = check_ret(ret, 0, error))) return error;
+    for (uint32_t i = 0; i < bytes; i++) {
+        if (iram[IRAM_BUFFER + i] != 0xFF) return "buffer not copied";
+    }
+    return NULL;
+}
+
+static const char *bench_copy_check_data(uint32_t bytes) {
+    const char *error;
+    fill_random(sram + 0x4000, bytes);
+    memset(iram + IRAM_BUFFER, 0, bytes);
+    int ret = call_kernel("sram_copy_to_buffer_check_flash", IRAM_BUFFER, 0x4000, 0, 0, 0, 0, &error);
+    if ((error = check_ret(ret, 1, error))) return error;
+    if (memcmp(iram + IRAM_BUFFER, sram + 0x4000, bytes)) return "buffer not copied";
+    return NULL;
+}
+
+static const char *bench_copy_check_late_data(uint32_t bytes) {
+    const char *error;
+    memset(sram + 0x4000, 0xFF, bytes);
+    sram[0x4000 + bytes - 1] = 0x00;
+    memset(iram + IRAM_BUFFER, 0, bytes);
+    int ret = call_kernel("sram_copy_to_buffer_check_flash", IRAM_BUFFER, 0x4000, 0, 0, 0, 0, &error);
+    if ((error = check_ret(ret, 1, error))) return error;
+    if (memcmp(iram + IRAM_BUFFER, sram + 0x4000, bytes)) return "buffer not copied";
+    return NULL;
+}
+
+static const char *bench_copy_from_bank1(uint32_t bytes) {
+    const char *error;
+    ports[IO_BANK_ROM1] = BENCH_BANK;
+    fill_random(flash_bank(BENCH_BANK), bytes);
+    memset(sram, 0, bytes);
+    if (call_kernel("sram_copy_from_bank1", 0, bytes >> 1, 0, 0, 0, 0, &error) < 0) return error;
+    if (memcmp(sram, flash_bank(BENCH_BANK), bytes)) return "SRAM not written";
+    return NULL;
+}
+
+static const char *bench_read_slot(uint32_t bytes) {
+    const char *error;
+    fill_random(flash_bank(BENCH_BANK) + 0x100, bytes);
+    memset(iram + IRAM_BUFFER, 0, bytes);
+    int ret = call_kernel("driver_read_slot", IRAM_BUFFER, bench_slot(), BENCH_BANK, 2, 0x100, bytes, &error);
+    if ((error = check_ret(ret, 1, error))) return error;
+    if (memcmp(iram + IRAM_BUFFER, flash_bank(BENCH_BANK) + 0x100, bytes)) return "data not read";
+    return check_stats(bytes, 0, 0);
+}
+
+static void crc32_table(uint32_t *table) {
+    // as crc32_with_table()
+    for (uint16_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320) : (crc >> 1);
+        }
+        table[i] = crc;
+    }
+}
+
+static uint32_t crc32_update(const uint32_t *table, uint32_t crc, const uint8_t *data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void put32(uint8_t *dest, uint32_t value) {
+    dest[0] = value; dest[1] = value >> 8; dest[2] = value >> 16; dest[3] = value >> 24;
+}
+
+static const char *bench_crc32_slot(uint32_t bytes) {
+    const char *error;
+    uint32_t table[256];
+    crc32_table(table);
+    for (int i = 0; i < 256; i++) put32(iram + IRAM_CRC_TABLE + i * 4, table[i]);
+    put32(iram + IRAM_CRC, 0xFFFFFFFF);
+    fill_random(flash_bank(BENCH_BANK), bytes);
+
+    int ret = call_kernel("driver_crc32_slot", IRAM_CRC, bench_slot(), BENCH_BANK, 2, IRAM_CRC_TABLE, bytes & 0xFFFF, &error);
+    if ((error = check_ret(ret, 1, error))) return error;
+    if (get32(iram + IRAM_CRC) != crc32_update(table, 0xFFFFFFFF, flash_bank(BENCH_BANK), bytes)) return "wrong CRC";
+    return check_stats(bytes, 0, 0);
+}
+
+static const char *bench_crc32_sectors(uint32_t bytes) {
+    const char *error;
+    uint32_t table[256];
+    uint16_t sectors = bytes >> 17;
+    crc32_table(table);
+    for (int i = 0; i < 256; i++) put32(iram + IRAM_CRC_TABLE + i * 4, table[i]);
+    for (uint16_t i = 0; i < sectors; i++) put32(iram + IRAM_CRC + i * 4, 0xFFFFFFFF);
+    fill_random(flash_bank(BENCH_BANK), bytes);
+
+    int ret = call_kernel("driver_crc32_sectors", IRAM_CRC, bench_slot(), BENCH_BANK, 2, IRAM_CRC_TABLE, sectors * 2, &error);
+    if ((error = check_ret(ret, 1, error))) return error;
+    for (uint16_t i = 0; i < sectors; i++) {
+        uint32_t expected = crc32_update(table, 0xFFFFFFFF, flash_bank(BENCH_BANK + i * 2), 0x20000);
+        if (get32(iram + IRAM_CRC + i * 4) != expected) return "wrong CRC";
+    }
+    return check_stats(bytes, 0, 0);
+}
+
+static const char *write_slot(const char *kernel, uint32_t bytes, uint16_t offset, uint8_t flags1) {
+    bool buffered = !(flags1 & SETT_FLAGS1_DISABLE_BUFFERED_WRITES);
+    const char *error;
+    uint8_t *dest = flash_bank(BENCH_BANK) + offset;
+    memset(dest, 0xFF, bytes);
+    fill_random(iram + IRAM_BUFFER, bytes);
+    iram[IRAM_SETTINGS + offsetof(settings_t, flags1)] = flags1;
+
+    int ret = call_kernel(kernel, IRAM_BUFFER, bench_slot(), BENCH_BANK, 2, offset, bytes, &error);
+    if ((error = check_ret(ret, 1, error))) return error;
+    if (memcmp(dest, iram + IRAM_BUFFER, bytes)) return "data not programmed";
+    if (flash_stats.faults) return "flash command error";
+    if (flash_chip.state != FLASH_READ) return "flash left in command mode";
+    if (DRIVER_STAT16(buffered_writes) != buffered || DRIVER_STAT16(byte_writes) != !buffered) return "wrong write kind counted";
+    return check_stats(0, bytes, 0);
+}
+
+static const char *bench_write_buffered(uint32_t bytes) {
+    return write_slot("driver_write_slot", bytes, 0x200, 0);
+}
+
+static const char *bench_write_bytes(uint32_t bytes) {
+    return write_slot("driver_write_slot", bytes, 0x200, SETT_FLAGS1_DISABLE_BUFFERED_WRITES);
+}
+
+static const char *bench_write_verify(uint32_t bytes) {
+    return write_slot("driver_write_slot_verify", bytes, 0x200, 0);
+}
+
+static const char *bench_erase_sector(uint32_t bytes) {
+    const char *error;
+    fill_random(flash_bank(BENCH_BANK), bytes);
+    int ret = call_kernel("driver_erase_sector", 0, bench_slot(), BENCH_BANK, 0, 0, 0, &error);
+    if ((error = check_ret(ret, 1, error))) return error;
+    for (uint32_t i = 0; i < bytes; i++) {
+        if (flash_bank(BENCH_BANK)[i] != 0xFF) return "sector not erased";
+    }
+    if (flash_stats.faults) return "flash command error";
+    return check_stats(0, 0, 1);
+}
+
+static const benchmark_t benchmarks[] = {
+    {"sram_copy_to_buffer_check_flash/erased", 256, bench_copy_check_erased},
+    {"sram_copy_to_buffer_check_flash/data", 256, bench_copy_check_data},
+    {"sram_copy_to_buffer_check_flash/late", 256, bench_copy_check_late_data},
+    {"sram_copy_from_bank1", 2048, bench_copy_from_bank1},
+    {"driver_read_slot", 4096, bench_read_slot},
+    {"driver_crc32_slot", 4096, bench_crc32_slot},
+    {"driver_crc32_sectors", 0x20000, bench_crc32_sectors},
+    {"driver_write_slot/buffered", 256, bench_write_buffered},
+    {"driver_write_slot/bytes", 256, bench_write_bytes},
+    {"driver_write_slot_verify", 256, bench_write_verify},
+    {"driver_erase_sector", 0x20000, bench_erase_sector},
+    {NULL, 0, NULL}
+};
+
+static bool selected(const char *name, int argc, char **argv) {
+    if (argc == 0) return true;
+    for (int i = 0; i < argc; i++) {
+        if (!strncmp(name, argv[i], strlen(argv[i]))) return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    const char *kernels = "build/kernels";
+    int i = 1;
+
+    for (; i < argc && !strncmp(argv[i], "--", 2); i++) {
+        if (!strcmp(argv[i], "--switch")) {
+            switch_slots = true;
+        } else if (i + 1 < argc && !strcmp(argv[i], "--kernels")) {
+            kernels = argv[++i];
+        } else if (i + 1 < argc && !strcmp(argv[i], "--byte-program")) {
+            byte_program_us = strtoul(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--buffer-program")) {
+            buffer_program_us = strtoul(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && !strcmp(argv[i], "--sector-erase")) {
+            sector_erase_us = strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [--kernels <path>] [--switch] [--byte-program <us>]\n"
+                "\t[--buffer-program <us>] [--sector-erase <us>] [benchmark...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    flash = malloc(FLASH_SIZE);
+    memset(flash, 0xFF, FLASH_SIZE);
+    v30mz_init(&cpu, &bus);
+    if (!load_kernels(kernels)) return 1;
+    if (symbol("settings_local") != IRAM_SETTINGS) {
+        fprintf(stderr, "v30sim: settings_local must be at %04X\n", IRAM_SETTINGS);
+        return 1;
+    }
+
+    bool result = true;
+    printf("%-40s %7s %10s %9s %10s %8s\n", "kernel", "bytes", "cycles", "cyc/byte", "time (us)", "polls");
+    for (const benchmark_t *b = benchmarks; b->name; b++) {
+        if (!selected(b->name, argc - i, argv + i)) continue;
+        setup();
+        const char *error = b->run(b->bytes);
+        if (error) {
+            printf("%-40s FAILED: %s\n", b->name, error);
+            result = false;
+            continue;
+        }
+        printf("%-40s %7u %10llu %9.2f %10llu %8llu\n", b->name, b->bytes,
+            (unsigned long long) cpu.cycles, (double) cpu.cycles / b->bytes,
+            (unsigned long long) (cpu.cycles * 1000000 / CPU_HZ),
+            (unsigned long long) flash_stats.polls);
+    }
+
+    free(flash);
+    free(symbols);
+    return result ? 0 : 1;
+}
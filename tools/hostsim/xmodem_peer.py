@@ -0,0 +1,149 @@
+#!/usr/bin/python3
+# Copyright (c) 2024 Adrian Siekierka
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+# SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+# RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+# CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# The host side of an xmodemsim transfer, on a PTY. Files are sent as a
+# YMODEM batch, as cf_send.py does, and received with plain XMODEM-CRC, as
+# lrzsz's "rx -c" would do it. Unlike cf_send.py, a block is also sent
+# again if the reply to it is lost, so that lossy lines can be tested.
+#
+# usage: xmodem_peer.py send|recv port file
+
+import binascii, os, select, struct, sys, termios, time, tty
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from cfserial import *
+
+# longer than a 1K block takes at 9600 bps
+REPLY_TIMEOUT = 2
+
+class PtyPort:
+	def __init__(self, path):
+		self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+		# without flushing, so that a 'C' sent before we started is kept
+		tty.setraw(self.fd, termios.TCSANOW)
+
+	def read(self, n):
+		if not select.select([self.fd], [], [], 0.1)[0]:
+			return b""
+		return os.read(self.fd, n)
+
+	def write(self, data):
+		while len(data) > 0:
+			data = data[os.write(self.fd, data):]
+
+	def reset_input_buffer(self):
+		while len(self.read(4096)) > 0:
+			pass
+
+# returns one of chars, or None on timeout
+def wait_byte(ser, chars, timeout):
+	end = time.monotonic() + timeout
+	while time.monotonic() < end:
+		c = ser.read(1)
+		if len(c) > 0 and c[0] in chars + (CAN,):
+			if c[0] == CAN:
+				raise TransferError("transfer cancelled by the cartridge")
+			return c[0]
+	return None
+
+# sends a block (or EOT, for data = None) until it is acknowledged;
+# returns the number of retries
+def send_packet(ser, idx, data):
+	if data is None:
+		packet = bytes([EOT])
+	else:
+		packet = bytes([STX if len(data) == 1024 else SOH, idx & 0xFF, 0xFF - (idx & 0xFF)])
+		packet += data + struct.pack(">H", binascii.crc_hqx(data, 0))
+	for attempt in range(10):
+		ser.write(packet)
+		if wait_byte(ser, (ACK, NAK), REPLY_TIMEOUT) == ACK:
+			return attempt
+	raise TransferError("too many retries")
+
+def send_file(ser, name, data):
+	wait_for(ser, (CRC, CAN), 30)
+	header = name.encode("ascii") + b"\x00" + str(len(data)).encode("ascii") + b"\x00"
+	retries = send_packet(ser, 0, header.ljust(128, b"\x00"))
+	wait_for(ser, (CRC, CAN), 30)
+	for i in range(0, len(data), 1024):
+		block = data[i:i + 1024]
+		block = block.ljust(128 if len(block) <= 128 else 1024, b"\x1A")
+		retries += send_packet(ser, (i // 1024) + 1, block)
+	retries += send_packet(ser, 0, None)
+	# end of batch
+	wait_for(ser, (CRC, CAN), 30)
+	retries += send_packet(ser, 0, bytes(128))
+	return retries
+
+# returns the block's data, None for a bad block, or EOT
+def recv_block(ser, expected_idx):
+	c = wait_byte(ser, (SOH, STX, EOT), REPLY_TIMEOUT)
+	if c is None or c == EOT:
+		return c
+	size = 1024 if c == STX else 128
+	try:
+		packet = read_exact(ser, size + 4, REPLY_TIMEOUT)
+	except TransferError:
+		return None
+	idx, idx_inv = packet[0], packet[1]
+	data, crc = packet[2:-2], struct.unpack(">H", packet[-2:])[0]
+	if idx ^ 0xFF != idx_inv or binascii.crc_hqx(data, 0) != crc:
+		return None
+	if idx == (expected_idx - 1) & 0xFF:
+		# our ACK was lost
+		return b""
+	if idx != expected_idx & 0xFF:
+		raise TransferError("block out of sequence")
+	return data
+
+def recv_file(ser):
+	data = bytearray()
+	retries = 0
+	idx = 1
+	ser.write(bytes([CRC]))
+	while True:
+		block = recv_block(ser, idx)
+		if block == EOT:
+			ser.write(bytes([ACK]))
+			return data, retries
+		elif block is None:
+			retries += 1
+			if retries > 100:
+				raise TransferError("too many retries")
+			ser.reset_input_buffer()
+			ser.write(bytes([CRC if idx == 1 else NAK]))
+		else:
+			if len(block) > 0:
+				data += block
+				idx += 1
+			ser.write(bytes([ACK]))
+
+if len(sys.argv) != 4 or sys.argv[1] not in ("send", "recv"):
+	print("usage: xmodem_peer.py send|recv port file", file = sys.stderr)
+	sys.exit(1)
+
+ser = PtyPort(sys.argv[2])
+try:
+	if sys.argv[1] == "send":
+		with open(sys.argv[3], "rb") as fp:
+			data = fp.read()
+		retries = send_file(ser, os.path.basename(sys.argv[3]), data)
+	else:
+		data, retries = recv_file(ser)
+		with open(sys.argv[3], "wb") as fp:
+			fp.write(data)
+	print("peer: %d retries" % retries, file = sys.stderr)
+except TransferError as e:
+	print("peer: %s" % e, file = sys.stderr)
+	sys.exit(1)
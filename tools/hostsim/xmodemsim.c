@@ -0,0 +1,330 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Runs CartFriend's XMODEM code (src/xmodem.c) against a peer on the host,
+// over a modelled serial line on a PTY (see xmodemsim_serial.c).
+//
+// Usage: xmodemsim [options] recv|send
+//
+//   recv                  the cartridge receives, as Browse -> Receive ROM
+//                         does; YMODEM batches are accepted
+//   send                  the cartridge sends with XMODEM-1K, as sending a
+//                         ROM from Browse does
+//
+//   --baud <bps>          9600 or 38400 (default)
+//   --latency <ms>        added to every byte, each way
+//   --drop <rate>         chance of a byte being lost, each way
+//   --corrupt <rate>      chance of a bit in a byte being flipped, each way
+//   --seed <n>            for the test data and the line errors
+//   --size <bytes>        test data size (default 65536)
+//   --unbuffered          send: write blocks with xmodem_send_block(), as
+//                         save exports do
+//   --timeout <s>         give up after this long (default 300)
+//   --peer <command>      run with /bin/sh, {port} being replaced with the
+//                         PTY and {file} with the data file; the bundled
+//                         xmodem_peer.py is used by default
+//
+// For example, with lrzsz: --peer 'sx -k {file} <{port} >{port}' recv
+//
+// The exit status is 0 if the data arrived intact.
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include <ws.h>
+#include "input.h"
+#include "settings.h"
+#include "serial.h"
+#include "xmodem.h"
+#include "xmodemsim.h"
+
+#define SUB 26
+
+#define PEER_EXIT_GRACE_US 2000000
+#define PEER_EXIT_WAIT_US 5000000
+
+// for util.c
+settings_t settings_local;
+// B is never pressed
+uint16_t input_pressed, input_held;
+void input_update(void) {}
+
+static uint8_t *data;
+static uint32_t data_size = 65536;
+static uint8_t *received;
+static uint32_t received_size;
+
+static char *command_expand(const char *command, const char *port, const char *file) {
+    size_t len = strlen(command) + 1;
+    for (const char *s = command; (s = strchr(s, '{')); s++) len += strlen(port) + strlen(file);
+    char *result = malloc(len);
+    char *out = result;
+    while (*command) {
+        if (!strncmp(command, "{port}", 6)) {
+            out = stpcpy(out, port);
+            command += 6;
+        } else if (!strncmp(command, "{file}", 6)) {
+            out = stpcpy(out, file);
+            command += 6;
+        } else {
+            *(out++) = *(command++);
+        }
+    }
+    *out = 0;
+    return result;
+}
+
+static int pty_open(char **slave_name, int *slave_fd) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) return -1;
+    *slave_name = strdup(ptsname(fd));
+
+    // keep the slave open, so that the master never reports a hangup
+    // while the peer (re)opens it
+    struct termios tio;
+    *slave_fd = open(*slave_name, O_RDWR | O_NOCTTY);
+    if (*slave_fd < 0 || tcgetattr(*slave_fd, &tio) < 0) return -1;
+    cfmakeraw(&tio);
+    tcsetattr(*slave_fd, TCSANOW, &tio);
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static uint8_t device_recv(void) {
+    uint8_t buffer[XMODEM_BLOCK_SIZE_1K];
+    uint8_t result;
+
+    received = malloc(data_size + XMODEM_BLOCK_SIZE_1K);
+    xmodem_recv_start();
+    while (true) {
+        uint16_t len = sizeof(buffer);
+        result = xmodem_recv_block(buffer, &len);
+        if (result == XMODEM_COMPLETE) {
+            result = xmodem_recv_finish();
+            return result == XMODEM_COMPLETE ? XMODEM_OK : result;
+        } else if (result != XMODEM_OK) {
+            return result;
+        }
+        if (received_size + len > data_size + XMODEM_BLOCK_SIZE_1K) {
+            // more data than was sent
+            xmodem_recv_cancel();
+            return XMODEM_ERROR;
+        }
+        memcpy(received + received_size, buffer, len);
+        received_size += len;
+    }
+}
+
+static uint8_t device_send(bool unbuffered) {
+    uint8_t result = xmodem_send_start();
+    for (uint32_t pos = 0; pos < data_size && result == XMODEM_OK; pos += XMODEM_BLOCK_SIZE_1K) {
+        uint16_t len = data_size - pos > XMODEM_BLOCK_SIZE_1K ? XMODEM_BLOCK_SIZE_1K : data_size - pos;
+        if (unbuffered) {
+            result = xmodem_send_block(data + pos, len);
+        } else {
+            xmodem_send_block_begin(data + pos, len);
+            result = xmodem_send_block_end();
+        }
+    }
+    if (result == XMODEM_OK) {
+        result = xmodem_send_finish();
+    }
+    return result;
+}
+
+static bool load_file(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return false;
+    received = malloc(data_size + XMODEM_BLOCK_SIZE_1K + 1);
+    received_size = fread(received, 1, data_size + XMODEM_BLOCK_SIZE_1K + 1, file);
+    fclose(file);
+    return true;
+}
+
+// XMODEM pads the last block, unless YMODEM gave the size
+static bool verify(void) {
+    if (received_size < data_size || memcmp(received, data, data_size)) return false;
+    for (uint32_t i = data_size; i < received_size; i++) {
+        if (received[i] != SUB) return false;
+    }
+    return true;
+}
+
+static const char *result_name(uint8_t result) {
+    switch (result) {
+    case XMODEM_OK: return "OK";
+    case XMODEM_CANCEL: return "cancelled by peer";
+    case XMODEM_SELF_CANCEL: return "cancelled";
+    case XMODEM_ERROR: return "error";
+    default: return "unknown";
+    }
+}
+
+static bool device_sends;
+static bool device_done;
+static char filename[] = "/tmp/xmodemsim-XXXXXX";
+static uint32_t timeout_s = 300;
+static pid_t peer_pid;
+static int peer_status = -1;
+static uint64_t peer_exit_us;
+
+// Reports on the transfer, once the cartridge side is done with it.
+static void finish(bool ok, const char *result) {
+    uint64_t end_us = xmodemsim_now();
+    device_done = true;
+    xmodem_close();
+
+    // let the peer see the last acknowledgement and finish
+    uint64_t peer_deadline = xmodemsim_now() + PEER_EXIT_WAIT_US;
+    while (!peer_exit_us) {
+        if (xmodemsim_now() > peer_deadline) {
+            kill(peer_pid, SIGTERM);
+            waitpid(peer_pid, &peer_status, 0);
+            break;
+        }
+        xmodemsim_line_drain(xmodemsim_now() + 10000);
+    }
+
+    if (device_sends && !load_file(filename)) {
+        perror(filename);
+    }
+    bool intact = ok && verify();
+    unlink(filename);
+
+    // from the peer's first byte, leaving out its startup time
+    double seconds = (end_us - xmodemsim_line_stats.first_byte_us) / 1000000.0;
+    uint32_t line_rate = xmodemsim_line.baud / 10;
+    printf("result:     %s\n", result);
+    printf("data:       %s\n", intact ? "intact" : "MISMATCH");
+    if (intact) {
+        printf("throughput: %u bytes in %.2f s, %.0f bytes/s (%.1f%% of %u bytes/s)\n",
+            data_size, seconds, data_size / seconds, data_size * 100.0 / seconds / line_rate, line_rate);
+    }
+    printf("xmodem:     %u blocks, %u retries\n", xmodem_stats.blocks, xmodem_stats.retries);
+    printf("line:       %llu bytes to cartridge, %llu to host, %u dropped, %u corrupted, %u RX overruns\n",
+        (unsigned long long) xmodemsim_line_stats.bytes_to_device,
+        (unsigned long long) xmodemsim_line_stats.bytes_to_host,
+        xmodemsim_line_stats.dropped, xmodemsim_line_stats.corrupted, serial_rx_overruns);
+    if (WIFEXITED(peer_status)) {
+        printf("peer:       exit status %d\n", WEXITSTATUS(peer_status));
+    } else {
+        printf("peer:       killed\n");
+    }
+    exit(intact ? 0 : 1);
+}
+
+void xmodemsim_check(uint64_t now) {
+    if (!peer_exit_us && waitpid(peer_pid, &peer_status, WNOHANG) == peer_pid) {
+        peer_exit_us = now;
+    }
+    if (device_done) return;
+    if (now > (uint64_t) timeout_s * 1000000) {
+        finish(false, "timed out");
+    }
+    // bytes the peer sent before exiting may still be on the line
+    if (peer_exit_us && now > peer_exit_us + PEER_EXIT_GRACE_US) {
+        finish(false, "peer exited");
+    }
+}
+
+int main(int argc, char **argv) {
+    static const struct option options[] = {
+        {"baud", required_argument, NULL, 'b'},
+        {"latency", required_argument, NULL, 'l'},
+        {"drop", required_argument, NULL, 'd'},
+        {"corrupt", required_argument, NULL, 'c'},
+        {"seed", required_argument, NULL, 's'},
+        {"size", required_argument, NULL, 'n'},
+        {"unbuffered", no_argument, NULL, 'u'},
+        {"timeout", required_argument, NULL, 't'},
+        {"peer", required_argument, NULL, 'p'},
+        {NULL, 0, NULL, 0}
+    };
+    const char *peer = NULL;
+    unsigned int seed = 1;
+    bool unbuffered = false;
+    int opt;
+
+    xmodemsim_line.baud = 38400;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 'b': xmodemsim_line.baud = strtoul(optarg, NULL, 0); break;
+        case 'l': xmodemsim_line.latency_us = strtod(optarg, NULL) * 1000; break;
+        case 'd': xmodemsim_line.drop_rate = strtod(optarg, NULL); break;
+        case 'c': xmodemsim_line.corrupt_rate = strtod(optarg, NULL); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        case 'n': data_size = strtoul(optarg, NULL, 0); break;
+        case 'u': unbuffered = true; break;
+        case 't': timeout_s = strtoul(optarg, NULL, 0); break;
+        case 'p': peer = optarg; break;
+        default: return 1;
+        }
+    }
+    device_sends = optind < argc && !strcmp(argv[optind], "send");
+    if (optind + 1 != argc || (!device_sends && strcmp(argv[optind], "recv"))
+        || (xmodemsim_line.baud != 9600 && xmodemsim_line.baud != 38400) || data_size == 0) {
+        fprintf(stderr, "usage: %s [options] recv|send\n", argv[0]);
+        return 1;
+    }
+
+    srandom(seed);
+    data = malloc(data_size);
+    for (uint32_t i = 0; i < data_size; i++) {
+        data[i] = random();
+    }
+
+    int file_fd = mkstemp(filename);
+    if (file_fd < 0 || (!device_sends && write(file_fd, data, data_size) != (ssize_t) data_size)) {
+        perror(filename);
+        return 1;
+    }
+    close(file_fd);
+
+    char *port;
+    int slave_fd;
+    xmodemsim_fd = pty_open(&port, &slave_fd);
+    if (xmodemsim_fd < 0) {
+        perror("pty");
+        return 1;
+    }
+
+    char default_peer[4096];
+    if (peer == NULL) {
+        snprintf(default_peer, sizeof(default_peer), "python3 %s/xmodem_peer.py %s {port} {file}",
+            dirname(strdup(argv[0])), device_sends ? "recv" : "send");
+        peer = default_peer;
+    }
+    char *command = command_expand(peer, port, filename);
+
+    xmodemsim_line_init();
+    peer_pid = fork();
+    if (peer_pid == 0) {
+        close(xmodemsim_fd);
+        execl("/bin/sh", "sh", "-c", command, (char*) NULL);
+        _exit(127);
+    }
+
+    xmodem_open(xmodemsim_line.baud == 9600 ? SERIAL_BAUD_9600 : SERIAL_BAUD_38400);
+    uint8_t result = device_sends ? device_send(unbuffered) : device_recv();
+    finish(result == XMODEM_OK, result_name(result));
+}
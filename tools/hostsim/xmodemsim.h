@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t baud;
+    uint32_t latency_us; // each way
+    double drop_rate; // per byte, each way
+    double corrupt_rate; // per byte, each way
+} xmodemsim_line_t;
+
+typedef struct {
+    uint64_t bytes_to_device;
+    uint64_t bytes_to_host;
+    uint64_t first_byte_us; // the peer's first byte reaching the cartridge
+    uint32_t dropped;
+    uint32_t corrupted;
+} xmodemsim_line_stats_t;
+
+extern xmodemsim_line_t xmodemsim_line;
+extern xmodemsim_line_stats_t xmodemsim_line_stats;
+// PTY master; the peer is on the other end
+extern int xmodemsim_fd;
+
+// xmodemsim.c; called once per frame, may end the run
+void xmodemsim_check(uint64_t now);
+
+// xmodemsim_serial.c
+void xmodemsim_line_init(void);
+uint64_t xmodemsim_now(void); // in microseconds
+// keeps the line running, e.g. for final acknowledgements to arrive
+void xmodemsim_line_drain(uint64_t until_us);
@@ -0,0 +1,289 @@
+/**
+ * Copyright (c) 2024 Adrian Siekierka
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// The console's serial port (serial.c, serial_asm.s and libws's
+// ws_serial_*), connected to the host through a modelled line.
+//
+// The line runs in real time, as the peer on the other end of the PTY does.
+// Every byte spends 10 bit times on the wire in each direction, plus the
+// configured latency (as added by USB serial adapters); bytes may then be
+// dropped or corrupted. Received bytes go into a 512-byte ring buffer, as
+// the RX interrupt handler would put them, and are lost if it is full.
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <ws.h>
+#include "config.h"
+#include "serial.h"
+#include "xmodemsim.h"
+
+#define FRAME_US 13250
+
+#define QUEUE_SIZE 8192
+
+typedef struct {
+    uint8_t value[QUEUE_SIZE];
+    uint64_t due_us[QUEUE_SIZE];
+    uint16_t head, tail;
+} line_queue_t;
+
+xmodemsim_line_t xmodemsim_line;
+xmodemsim_line_stats_t xmodemsim_line_stats;
+int xmodemsim_fd = -1;
+
+volatile uint16_t vbl_ticks;
+volatile uint16_t serial_rx_overruns;
+
+static struct timespec time_start;
+static uint64_t byte_us;
+static uint64_t rx_last_due_us;
+static uint64_t tx_line_free_us;
+
+static line_queue_t to_device, to_host;
+static uint8_t serial_rxbuf[SERIAL_RXBUF_SIZE];
+static uint16_t serial_rxbuf_head, serial_rxbuf_tail;
+// serial_putc_buffered() data, waiting for the TX interrupt
+static line_queue_t txbuf;
+
+static uint8_t ports[0x100];
+
+uint64_t xmodemsim_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) (ts.tv_sec - time_start.tv_sec) * 1000000
+        + (ts.tv_nsec - time_start.tv_nsec) / 1000;
+}
+
+static uint16_t queue_count(const line_queue_t *q) {
+    return (q->head - q->tail) & (QUEUE_SIZE - 1);
+}
+
+static bool queue_push(line_queue_t *q, uint8_t value, uint64_t due_us) {
+    uint16_t next = (q->head + 1) & (QUEUE_SIZE - 1);
+    if (next == q->tail) return false;
+    q->value[q->head] = value;
+    q->due_us[q->head] = due_us;
+    q->head = next;
+    return true;
+}
+
+static bool queue_pop_due(line_queue_t *q, uint64_t now, uint8_t *value) {
+    if (q->head == q->tail || q->due_us[q->tail] > now) return false;
+    *value = q->value[q->tail];
+    q->tail = (q->tail + 1) & (QUEUE_SIZE - 1);
+    return true;
+}
+
+static double random_unit(void) {
+    return (double) random() / ((double) RAND_MAX + 1.0);
+}
+
+// returns false if the byte is dropped
+static bool line_damage(uint8_t *value) {
+    if (xmodemsim_line.drop_rate > 0 && random_unit() < xmodemsim_line.drop_rate) {
+        xmodemsim_line_stats.dropped++;
+        return false;
+    }
+    if (xmodemsim_line.corrupt_rate > 0 && random_unit() < xmodemsim_line.corrupt_rate) {
+        *value ^= 1 << (random() & 7);
+        xmodemsim_line_stats.corrupted++;
+    }
+    return true;
+}
+
+void xmodemsim_line_init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &time_start);
+    byte_us = 10000000 / xmodemsim_line.baud;
+}
+
+// Moves due bytes along the line; returns true if a byte was received.
+static bool line_service(void) {
+    uint64_t now = xmodemsim_now();
+    uint8_t buffer[256], value;
+    bool received = false;
+
+    if (vbl_ticks != (uint16_t) (now / FRAME_US)) {
+        vbl_ticks = now / FRAME_US;
+        xmodemsim_check(now);
+    }
+
+    // host -> line; the host's UART sends back to back
+    if (queue_count(&to_device) < QUEUE_SIZE - sizeof(buffer)) {
+        ssize_t len = read(xmodemsim_fd, buffer, sizeof(buffer));
+        for (ssize_t i = 0; i < len; i++) {
+            uint64_t due = now + xmodemsim_line.latency_us + byte_us;
+            if (due < rx_last_due_us + byte_us) due = rx_last_due_us + byte_us;
+            rx_last_due_us = due;
+            queue_push(&to_device, buffer[i], due);
+        }
+    }
+
+    // line -> RX interrupt
+    while (queue_pop_due(&to_device, now, &value)) {
+        if (xmodemsim_line_stats.bytes_to_device++ == 0) {
+            xmodemsim_line_stats.first_byte_us = now;
+        }
+        if (!line_damage(&value)) continue;
+        uint16_t next = (serial_rxbuf_head + 1) & (SERIAL_RXBUF_SIZE - 1);
+        if (next == serial_rxbuf_tail) {
+            serial_rx_overruns++;
+            continue;
+        }
+        serial_rxbuf[serial_rxbuf_head] = value;
+        serial_rxbuf_head = next;
+        received = true;
+    }
+
+    // TX interrupt -> line
+    while (txbuf.head != txbuf.tail && tx_line_free_us <= now) {
+        uint64_t start = txbuf.due_us[txbuf.tail];
+        if (start < tx_line_free_us) start = tx_line_free_us;
+        tx_line_free_us = start + byte_us;
+        queue_push(&to_host, txbuf.value[txbuf.tail], tx_line_free_us + xmodemsim_line.latency_us);
+        txbuf.tail = (txbuf.tail + 1) & (QUEUE_SIZE - 1);
+    }
+
+    // line -> host
+    while (queue_pop_due(&to_host, now, &value)) {
+        xmodemsim_line_stats.bytes_to_host++;
+        if (!line_damage(&value)) continue;
+        while (write(xmodemsim_fd, &value, 1) < 0 && errno == EAGAIN) {
+            usleep(100);
+        }
+    }
+
+    return received;
+}
+
+static uint64_t line_next_event(void) {
+    uint64_t next = ((uint64_t) vbl_ticks + 1) * FRAME_US;
+    if (to_device.head != to_device.tail && to_device.due_us[to_device.tail] < next)
+        next = to_device.due_us[to_device.tail];
+    if (to_host.head != to_host.tail && to_host.due_us[to_host.tail] < next)
+        next = to_host.due_us[to_host.tail];
+    if (txbuf.head != txbuf.tail && tx_line_free_us < next)
+        next = tx_line_free_us;
+    return next;
+}
+
+// Waits for the next interrupt: VBlank or received data.
+void cpu_halt(void) {
+    uint16_t ticks = vbl_ticks;
+    while (!line_service() && vbl_ticks == ticks) {
+        uint64_t now = xmodemsim_now();
+        uint64_t next = line_next_event();
+        struct pollfd pfd = { .fd = xmodemsim_fd, .events = POLLIN };
+        struct timespec timeout = { 0, next > now ? (next - now) * 1000 : 0 };
+        ppoll(&pfd, 1, &timeout, NULL);
+    }
+}
+
+void xmodemsim_line_drain(uint64_t until_us) {
+    while (xmodemsim_now() < until_us) {
+        cpu_halt();
+    }
+}
+
+void ws_serial_open(uint8_t baudrate) {
+    ports[IO_SERIAL_STATUS] = 0x80 | baudrate;
+}
+
+void ws_serial_close(void) {
+    ports[IO_SERIAL_STATUS] = 0;
+}
+
+// Waits for the UART to be free, then sends the byte.
+void ws_serial_putc(uint8_t value) {
+    while (txbuf.head != txbuf.tail || xmodemsim_now() < tx_line_free_us) {
+        line_service();
+        usleep(50);
+    }
+    tx_line_free_us = xmodemsim_now() + byte_us;
+    queue_push(&to_host, value, tx_line_free_us + xmodemsim_line.latency_us);
+}
+
+void serial_init_buffered(void) {
+    txbuf.head = txbuf.tail = 0;
+}
+
+void serial_flush_buffered(void) {
+    while (txbuf.head != txbuf.tail) {
+        cpu_halt();
+    }
+}
+
+void serial_putc_buffered(uint8_t value) {
+    while (queue_count(&txbuf) >= SERIAL_TXBUF_SIZE - 1) {
+        cpu_halt();
+    }
+    queue_push(&txbuf, value, xmodemsim_now());
+}
+
+void serial_init_rx_buffered(void) {
+    serial_rxbuf_head = 0;
+    serial_rxbuf_tail = 0;
+    serial_rx_overruns = 0;
+}
+
+void serial_close_rx_buffered(void) {}
+
+uint16_t serial_rx_buffered_count(void) {
+    return (serial_rxbuf_head - serial_rxbuf_tail) & (SERIAL_RXBUF_SIZE - 1);
+}
+
+int16_t serial_getc_buffered_nonblock(void) {
+    line_service();
+    uint16_t tail = serial_rxbuf_tail;
+    if (tail == serial_rxbuf_head) {
+        return -1;
+    }
+    uint8_t value = serial_rxbuf[tail];
+    serial_rxbuf_tail = (tail + 1) & (SERIAL_RXBUF_SIZE - 1);
+    return value;
+}
+
+int16_t serial_getc_buffered_timeout(uint16_t ticks) {
+    uint16_t ticks_start = vbl_ticks;
+    while (1) {
+        int16_t r = serial_getc_buffered_nonblock();
+        if (r >= 0) {
+            return r;
+        }
+        if (((uint16_t) (vbl_ticks - ticks_start)) >= ticks) {
+            return -1;
+        }
+        cpu_halt();
+    }
+}
+
+void outportb(uint16_t port, uint8_t value) {
+    ports[port & 0xFF] = value;
+}
+
+void outportw(uint16_t port, uint16_t value) {
+    ports[port & 0xFF] = value;
+    ports[(port + 1) & 0xFF] = value >> 8;
+}
+
+uint8_t inportb(uint16_t port) {
+    return ports[port & 0xFF];
+}
+
+uint16_t inportw(uint16_t port) {
+    return ports[port & 0xFF] | (ports[(port + 1) & 0xFF] << 8);
+}
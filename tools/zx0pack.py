@@ -0,0 +1,189 @@
+# Copyright (c) 2022 Adrian Siekierka
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+# SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+# RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+# CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+import argparse, struct
+
+# ZX0 compressor and the framing used by CartFriend's compressed uploads.
+#
+# The stream starts with "CFZ0", followed by frames of:
+#   u16 packed length (0 = end of stream), u16 unpacked length, data
+# A frame is stored as-is if its packed and unpacked lengths are equal,
+# otherwise it is a complete ZX0 (v2) stream. Frames are unpacked to
+# consecutive addresses, so matches may reach back into earlier frames.
+#
+# "CFZ1" streams are framed the same way, but each frame is packed on its
+# own, so that it can be unpacked into a small buffer (WW OS installs, and
+# the bundled AthenaBIOS, which are both written straight to flash).
+#
+# usage: zx0pack.py [--independent] input output
+
+FRAME_SIZE = 512
+MAGIC = b"CFZ0"
+MAGIC_INDEPENDENT = b"CFZ1"
+
+MAX_OFFSET = 32640
+MAX_CHAIN = 64
+MIN_MATCH = 2
+
+class BitWriter:
+	def __init__(self):
+		self.data = bytearray()
+		self.bit_index = 0
+		self.bit_mask = 0
+		self.backtrack = False
+
+	def write_byte(self, value):
+		self.data.append(value & 0xFF)
+
+	def write_bit(self, value):
+		if self.backtrack:
+			if value:
+				self.data[-1] |= 1
+			self.backtrack = False
+		else:
+			if self.bit_mask == 0:
+				self.bit_mask = 128
+				self.bit_index = len(self.data)
+				self.data.append(0)
+			if value:
+				self.data[self.bit_index] |= self.bit_mask
+			self.bit_mask >>= 1
+
+	def write_elias(self, value, invert = False):
+		i = 1
+		while (i << 1) <= value:
+			i <<= 1
+		i >>= 1
+		while i > 0:
+			self.write_bit(0)
+			bit = (value & i) != 0
+			self.write_bit((not bit) if invert else bit)
+			i >>= 1
+		self.write_bit(1)
+
+def elias_bits(value):
+	return 2 * value.bit_length() - 1
+
+def match_length(data, a, b, end):
+	n = 0
+	while b + n < end and data[a + n] == data[b + n]:
+		n += 1
+	return n
+
+# Compresses data[start:end], allowing matches to reach back to data[0].
+def compress(data, start, end, chains = None):
+	if chains is None:
+		chains = {}
+	# (kind, value, length): kind 0 = literals, 1 = last offset, 2 = new offset
+	blocks = []
+	literals = 0
+	last_offset = 1
+	pos = start
+
+	def insert(p):
+		if p + 2 < len(data):
+			chains.setdefault(data[p:p + 3], []).append(p)
+
+	# the first block of a ZX0 stream is always a literal
+	insert(pos)
+	literals = 1
+	pos += 1
+	while pos < end:
+		best_len, best_offset, best_gain = 0, 0, 0
+		# repeating the last offset is only possible right after literals
+		if literals > 0 and pos - last_offset >= 0:
+			n = match_length(data, pos - last_offset, pos, end)
+			if n >= 1:
+				best_len, best_offset = n, last_offset
+				best_gain = (n * 9) - (1 + elias_bits(n))
+		for p in reversed(chains.get(data[pos:pos + 3], [])[-MAX_CHAIN:]):
+			offset = pos - p
+			if offset > MAX_OFFSET:
+				break
+			n = match_length(data, p, pos, end)
+			if n >= MIN_MATCH:
+				gain = (n * 9) - (1 + elias_bits(((offset - 1) >> 7) + 1) + 8 + elias_bits(n - 1))
+				if gain > best_gain:
+					best_len, best_offset, best_gain = n, offset, gain
+		if best_gain > 0:
+			if literals > 0:
+				blocks.append((0, literals))
+				literals = 0
+			blocks.append((1 if (best_offset == last_offset and len(blocks) > 0 and blocks[-1][0] == 0) else 2, best_offset, best_len))
+			last_offset = best_offset
+			for i in range(best_len):
+				insert(pos + i)
+			pos += best_len
+		else:
+			insert(pos)
+			literals += 1
+			pos += 1
+	if literals > 0:
+		blocks.append((0, literals))
+
+	out = BitWriter()
+	pos = start
+	first = True
+	for block in blocks:
+		if block[0] == 0:
+			if not first:
+				out.write_bit(0)
+			first = False
+			out.write_elias(block[1])
+			for i in range(block[1]):
+				out.write_byte(data[pos + i])
+			pos += block[1]
+		elif block[0] == 1:
+			out.write_bit(0)
+			out.write_elias(block[2])
+			pos += block[2]
+		else:
+			offset, length = block[1], block[2]
+			out.write_bit(1)
+			out.write_elias(((offset - 1) >> 7) + 1, True)
+			out.write_byte((127 - ((offset - 1) & 127)) << 1)
+			out.backtrack = True
+			out.write_elias(length - 1)
+			pos += length
+	# end marker
+	out.write_bit(1)
+	out.write_elias(256, True)
+	return bytes(out.data)
+
+def pack(data, independent = False):
+	out = bytearray(MAGIC_INDEPENDENT if independent else MAGIC)
+	chains = {}
+	for start in range(0, len(data), FRAME_SIZE):
+		end = min(start + FRAME_SIZE, len(data))
+		if independent:
+			packed = compress(data[start:end], 0, end - start)
+		else:
+			packed = compress(data, start, end, chains)
+		if len(packed) >= end - start:
+			packed = data[start:end]
+		out += struct.pack("<HH", len(packed), end - start) + packed
+	out += struct.pack("<HH", 0, 0)
+	return bytes(out)
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Compress a file for CartFriend.")
+	parser.add_argument("input", help="input file")
+	parser.add_argument("output", help="output file")
+	parser.add_argument("--independent", action="store_true", help="pack each frame on its own")
+	args = parser.parse_args()
+
+	with open(args.input, "rb") as fp:
+		data = fp.read()
+	with open(args.output, "wb") as fp:
+		fp.write(pack(data, args.independent))